@@ -0,0 +1,190 @@
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Microsoft::WRL;
+using namespace Lumia::Imaging;
+using namespace Lumia::Imaging::Artistic;
+using namespace Lumia::Imaging::Transforms;
+using namespace Platform;
+using namespace Platform::Collections;
+using namespace VideoEffects;
+using namespace Windows::Foundation::Collections;
+
+namespace AWM = ABI::Windows::Media;
+namespace AWFC = ABI::Windows::Foundation::Collections;
+
+TEST_CLASS(CompositeEffectTests)
+{
+public:
+
+    TEST_METHOD(CX_W_CE_TwoStages)
+    {
+        auto stages = ref new Vector<IVideoEffectDefinition^>();
+        stages->Append(_CreateAntiqueDefinition());
+        stages->Append(_CreateFlipDefinition());
+        ComPtr<IMFTransform> mft = _CreateMFT(ref new CompositeEffectDefinition(stages));
+
+        // The stages only share RGB32
+        ComPtr<IMFMediaType> type;
+        Assert::AreEqual(S_OK, mft->GetInputAvailableType(0, 0, &type));
+        GUID subtype;
+        Assert::AreEqual(S_OK, type->GetGUID(MF_MT_SUBTYPE, &subtype));
+        Assert::IsTrue(subtype == MFVideoFormat_RGB32);
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        for (long long n = 0; n < 3; n++)
+        {
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(n).Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+
+            long long time = 0;
+            Assert::AreEqual(S_OK, output.pSample->GetSampleTime(&time));
+            Assert::AreEqual(n * 333333, time);
+
+            output.pSample->Release();
+            output.pSample = nullptr;
+        }
+
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+    }
+
+    TEST_METHOD(CX_W_CE_ResolutionChangeRejected)
+    {
+        // Stages run in the media type of the composite: a stage resizing frames fails negotiation
+        auto resize = _CreateFlipDefinition();
+        resize->OutputWidth = 320;
+        resize->OutputHeight = 240;
+        auto stages = ref new Vector<IVideoEffectDefinition^>();
+        stages->Append(_CreateAntiqueDefinition());
+        stages->Append(resize);
+        ComPtr<IMFTransform> mft = _CreateMFT(ref new CompositeEffectDefinition(stages));
+
+        Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetInputType(0, _CreateMediaType().Get(), MFT_SET_TYPE_TEST_ONLY));
+        Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetOutputType(0, _CreateMediaType().Get(), MFT_SET_TYPE_TEST_ONLY));
+    }
+
+    // Benchmark: two Lumia effects chained as two MFTs, then fused in a composite effect
+    TEST_METHOD(CX_W_CE_Benchmark)
+    {
+        const unsigned int frameCount = 100;
+
+        std::vector<ComPtr<IMFTransform>> chain;
+        chain.push_back(_CreateMFT(_CreateAntiqueDefinition()));
+        chain.push_back(_CreateMFT(_CreateFlipDefinition()));
+        double chainedTime = _Run(chain, frameCount);
+
+        auto stages = ref new Vector<IVideoEffectDefinition^>();
+        stages->Append(_CreateAntiqueDefinition());
+        stages->Append(_CreateFlipDefinition());
+        std::vector<ComPtr<IMFTransform>> composite;
+        composite.push_back(_CreateMFT(ref new CompositeEffectDefinition(stages)));
+        double fusedTime = _Run(composite, frameCount);
+
+        wchar_t message[128];
+        swprintf_s(message, L"Chained: %.2f ms/frame, fused: %.2f ms/frame\n", 1000. * chainedTime / frameCount, 1000. * fusedTime / frameCount);
+        Logger::WriteMessage(message);
+    }
+
+private:
+
+    // Pushes frames through the MFTs in order, returns the elapsed time in seconds
+    double _Run(_In_ const std::vector<ComPtr<IMFTransform>>& mfts, unsigned int frameCount)
+    {
+        for (auto& mft : mfts)
+        {
+            Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+            Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+        }
+
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER start;
+        LARGE_INTEGER stop;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        for (unsigned int n = 0; n < frameCount; n++)
+        {
+            ComPtr<IMFSample> sample = _CreateSample(n);
+            for (auto& mft : mfts)
+            {
+                DWORD status = 0;
+                MFT_OUTPUT_DATA_BUFFER output = {};
+                Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+                Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+                sample.Attach(output.pSample);
+            }
+        }
+
+        QueryPerformanceCounter(&stop);
+
+        for (auto& mft : mfts)
+        {
+            Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+        }
+
+        return (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart;
+    }
+
+    LumiaEffectDefinition^ _CreateAntiqueDefinition()
+    {
+        return ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
+        {
+            auto filters = ref new Vector<IFilter^>();
+            filters->Append(ref new AntiqueFilter());
+            return filters;
+        }));
+    }
+
+    LumiaEffectDefinition^ _CreateFlipDefinition()
+    {
+        return ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
+        {
+            auto filters = ref new Vector<IFilter^>();
+            filters->Append(ref new FlipFilter(FlipMode::Horizontal));
+            return filters;
+        }));
+    }
+
+    ComPtr<IMFTransform> _CreateMFT(_In_ IVideoEffectDefinition^ definition)
+    {
+        ComPtr<AWM::IMediaExtension> mediaExtension;
+        Assert::AreEqual(S_OK, ActivateInstance(StringReference(definition->ActivatableClassId->Data()).GetHSTRING(), &mediaExtension));
+
+        Assert::AreEqual(S_OK, mediaExtension->SetProperties(reinterpret_cast<AWFC::IPropertySet*>(definition->Properties)));
+
+        ComPtr<IMFTransform> mft;
+        Assert::AreEqual(S_OK, mediaExtension.As(&mft));
+
+        return mft;
+    }
+
+    ComPtr<IMFMediaType> _CreateMediaType() const
+    {
+        ComPtr<IMFMediaType> mt;
+        Assert::AreEqual(S_OK, MFCreateMediaType(&mt));
+        Assert::AreEqual(S_OK, mt->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video));
+        Assert::AreEqual(S_OK, mt->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32));
+        Assert::AreEqual(S_OK, mt->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
+        Assert::AreEqual(S_OK, MFSetAttributeSize(mt.Get(), MF_MT_FRAME_SIZE, 640, 480));
+        Assert::AreEqual(S_OK, MFSetAttributeRatio(mt.Get(), MF_MT_FRAME_RATE, 1, 30));
+        return mt;
+    }
+
+    ComPtr<IMFSample> _CreateSample(long long n) const
+    {
+        ComPtr<IMFMediaBuffer> buffer;
+        Assert::AreEqual(S_OK, MFCreate2DMediaBuffer(640, 480, MFVideoFormat_RGB32.Data1, false, &buffer));
+
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(n * 333333));
+        Assert::AreEqual(S_OK, sample->SetSampleDuration(333333));
+        return sample;
+    }
+};
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\Deinterlace.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(DeinterlaceTests)
+{
+public:
+
+    TEST_METHOD_CLEANUP(Cleanup)
+    {
+        (void)Deinterlace::SetKernel(Deinterlace::GetBestKernel());
+        (void)ImageCopy::SetKernel(ImageCopy::GetBestKernel());
+    }
+
+    TEST_METHOD(CX_W_DI_Bob)
+    {
+        // Top field kept: even rows copied, odd rows averaged from their neighbors, last row mirrored
+        const unsigned int length = 37;
+        const unsigned int height = 5;
+        std::vector<unsigned char> src(length * height);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i / length * 40 + 10); // 10, 50, 90, 130, 170
+        }
+
+        std::vector<unsigned char> dst(length * height, 0);
+        Deinterlace::ProcessPlane(&dst[0], length, &src[0], length, nullptr, 0, length, height, false, Deinterlace::Mode::Bob, 0);
+
+        const unsigned int expected[] = { 10, 50, 90, 130, 170 };
+        for (unsigned int row = 0; row < height; row++)
+        {
+            Assert::AreEqual(expected[row], (unsigned int)dst[row * length]);
+            Assert::AreEqual(expected[row], (unsigned int)dst[row * length + length - 1]);
+        }
+
+        // Bottom field kept: row 0 mirrored from row 1
+        Deinterlace::ProcessPlane(&dst[0], length, &src[0], length, nullptr, 0, length, height, true, Deinterlace::Mode::Bob, 0);
+        Assert::AreEqual(50u, (unsigned int)dst[0]);
+        Assert::AreEqual(90u, (unsigned int)dst[2 * length]);
+        Assert::AreEqual(130u, (unsigned int)dst[3 * length]);
+        Assert::AreEqual(130u, (unsigned int)dst[4 * length]);
+    }
+
+    TEST_METHOD(CX_W_DI_Kernels)
+    {
+        const unsigned int lengths[] = { 1, 15, 16, 17, 63, 64, 65, 2 * 641 };
+        const unsigned int height = 9;
+
+        for (unsigned int length : lengths)
+        {
+            unsigned int stride = length + 3; // Unaligned rows
+            std::vector<unsigned char> src(stride * height);
+            std::vector<unsigned char> previous(stride * height);
+            for (unsigned int i = 0; i < src.size(); i++)
+            {
+                src[i] = (unsigned char)(i * 7 + 3);
+                previous[i] = (unsigned char)(i % 3 == 0 ? src[i] : src[i] + i % 29); // Static and moving pixels
+            }
+
+            for (Deinterlace::Mode mode : { Deinterlace::Mode::Bob, Deinterlace::Mode::MotionAdaptive })
+            {
+                for (bool keepOddRows : { false, true })
+                {
+                    Assert::IsTrue(Deinterlace::SetKernel(Deinterlace::Kernel::Scalar));
+                    std::vector<unsigned char> reference(stride * height, 0xCD);
+                    Deinterlace::ProcessPlane(&reference[0], stride, &src[0], stride, &previous[0], stride, length, height, keepOddRows, mode, 12);
+
+                    for (Deinterlace::Kernel kernel : _GetSupportedKernels())
+                    {
+                        Assert::IsTrue(Deinterlace::SetKernel(kernel));
+                        std::vector<unsigned char> dst(stride * height, 0xCD);
+                        Deinterlace::ProcessPlane(&dst[0], stride, &src[0], stride, &previous[0], stride, length, height, keepOddRows, mode, 12);
+                        Assert::IsTrue(reference == dst);
+                    }
+                }
+            }
+        }
+    }
+
+    // Micro-benchmark: 1080p NV12 frames (luma and chroma planes), bob and motion adaptive
+    TEST_METHOD(CX_W_DI_Benchmark)
+    {
+        const unsigned int width = 1920;
+        const unsigned int height = 1080;
+        const unsigned int iterations = 20;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        std::vector<unsigned char> src(width * height * 3 / 2);
+        std::vector<unsigned char> previous(width * height * 3 / 2);
+        std::vector<unsigned char> dst(width * height * 3 / 2);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i * 7 + 3);
+            previous[i] = (unsigned char)(i * 5 + 1);
+        }
+
+        for (Deinterlace::Mode mode : { Deinterlace::Mode::Bob, Deinterlace::Mode::MotionAdaptive })
+        {
+            for (Deinterlace::Kernel kernel : _GetSupportedKernels())
+            {
+                Assert::IsTrue(Deinterlace::SetKernel(kernel));
+
+                LARGE_INTEGER start;
+                LARGE_INTEGER stop;
+                QueryPerformanceCounter(&start);
+                for (unsigned int n = 0; n < iterations; n++)
+                {
+                    Deinterlace::ProcessPlane(&dst[0], width, &src[0], width, &previous[0], width, width, height, false, mode, 12);
+                    Deinterlace::ProcessPlane(&dst[width * height], width, &src[width * height], width, &previous[width * height], width, width, height / 2, false, mode, 12);
+                }
+                QueryPerformanceCounter(&stop);
+
+                double milliseconds = (double)(stop.QuadPart - start.QuadPart) * 1000 / frequency.QuadPart / iterations;
+
+                wchar_t message[128];
+                swprintf_s(message, L"1080p NV12 %s %s: %.2f ms/frame\n",
+                    mode == Deinterlace::Mode::Bob ? L"bob" : L"motion adaptive",
+                    _GetKernelName(kernel),
+                    milliseconds
+                    );
+                Logger::WriteMessage(message);
+            }
+        }
+    }
+
+private:
+
+    static std::vector<Deinterlace::Kernel> _GetSupportedKernels()
+    {
+        std::vector<Deinterlace::Kernel> kernels;
+        const Deinterlace::Kernel candidates[] = { Deinterlace::Kernel::Scalar, Deinterlace::Kernel::Sse2, Deinterlace::Kernel::Neon };
+        for (Deinterlace::Kernel kernel : candidates)
+        {
+            if (Deinterlace::SetKernel(kernel))
+            {
+                kernels.push_back(kernel);
+            }
+        }
+        return kernels;
+    }
+
+    static const wchar_t* _GetKernelName(Deinterlace::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case Deinterlace::Kernel::Sse2: return L"SSE2";
+        case Deinterlace::Kernel::Neon: return L"NEON";
+        default: return L"scalar";
+        }
+    }
+};
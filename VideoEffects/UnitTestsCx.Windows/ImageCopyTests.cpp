@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\ImageCopy.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ImageCopyTests)
+{
+public:
+
+    TEST_METHOD_CLEANUP(Cleanup)
+    {
+        (void)ImageCopy::SetKernel(ImageCopy::GetBestKernel());
+    }
+
+    TEST_METHOD(CX_W_IC_CopyRows)
+    {
+        for (ImageCopy::Kernel kernel : _GetSupportedKernels())
+        {
+            Assert::IsTrue(ImageCopy::SetKernel(kernel));
+
+            // Lengths around the vector sizes, with unaligned pointers
+            const unsigned int lengths[] = { 1, 15, 16, 17, 63, 64, 65, 127, 128, 129, 4 * 641 };
+            for (unsigned int length : lengths)
+            {
+                std::vector<unsigned char> src(length + 1);
+                std::vector<unsigned char> dst(length + 2, 0xCD);
+                for (unsigned int i = 0; i < src.size(); i++)
+                {
+                    src[i] = (unsigned char)(i * 7 + 3);
+                }
+
+                ImageCopy::CopyRow(&dst[1], &src[1], length);
+
+                Assert::AreEqual<unsigned int>(0xCD, dst[0]);
+                Assert::AreEqual<unsigned int>(0xCD, dst[length + 1]);
+                Assert::AreEqual(0, memcmp(&dst[1], &src[1], length));
+            }
+        }
+    }
+
+    TEST_METHOD(CX_W_IC_FlipRows)
+    {
+        const unsigned int width = 33;
+        const unsigned int height = 5;
+        const unsigned int srcStride = 4 * width;
+        const unsigned int dstStride = 4 * width + 16; // Padded, like a 2D buffer
+
+        std::vector<unsigned char> src(srcStride * height);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i / srcStride + 1); // Row index + 1
+        }
+
+        for (ImageCopy::Kernel kernel : _GetSupportedKernels())
+        {
+            Assert::IsTrue(ImageCopy::SetKernel(kernel));
+
+            // Bottom-up source: the last row in memory is the top of the image
+            std::vector<unsigned char> dst(dstStride * height, 0);
+            ImageCopy::CopyRows(&dst[0], dstStride, &src[srcStride * (height - 1)], -(long)srcStride, srcStride, height);
+
+            for (unsigned int row = 0; row < height; row++)
+            {
+                Assert::AreEqual<unsigned int>(height - row, dst[row * dstStride]);
+                Assert::AreEqual<unsigned int>(height - row, dst[row * dstStride + srcStride - 1]);
+                Assert::AreEqual<unsigned int>(0, dst[row * dstStride + srcStride]);
+            }
+        }
+    }
+
+    // Micro-benchmark: RGB32 bottom-up flips at 720p, 1080p, and 4K, compared to a plain memcpy() loop
+    TEST_METHOD(CX_W_IC_Benchmark)
+    {
+        const unsigned int sizes[][2] = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+        const unsigned int iterations = 20;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        for (auto size : sizes)
+        {
+            unsigned int stride = 4 * size[0];
+            unsigned int height = size[1];
+            std::vector<unsigned char> src(stride * height, 0x80);
+            std::vector<unsigned char> dst(stride * height);
+
+            for (ImageCopy::Kernel kernel : _GetSupportedKernels())
+            {
+                Assert::IsTrue(ImageCopy::SetKernel(kernel));
+
+                LARGE_INTEGER start;
+                LARGE_INTEGER stop;
+                QueryPerformanceCounter(&start);
+                for (unsigned int n = 0; n < iterations; n++)
+                {
+                    ImageCopy::CopyRows(&dst[0], stride, &src[stride * (height - 1)], -(long)stride, stride, height);
+                }
+                QueryPerformanceCounter(&stop);
+
+                double seconds = (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart;
+                double throughput = (double)stride * height * iterations / seconds / (1024 * 1024);
+
+                wchar_t message[128];
+                swprintf_s(message, L"%ux%u %s: %.0f MB/s\n", size[0], size[1], _GetKernelName(kernel), throughput);
+                Logger::WriteMessage(message);
+            }
+        }
+    }
+
+private:
+
+    static std::vector<ImageCopy::Kernel> _GetSupportedKernels()
+    {
+        std::vector<ImageCopy::Kernel> kernels;
+        const ImageCopy::Kernel candidates[] = { ImageCopy::Kernel::Memcpy, ImageCopy::Kernel::Sse2, ImageCopy::Kernel::Avx, ImageCopy::Kernel::Neon };
+        for (ImageCopy::Kernel kernel : candidates)
+        {
+            if (ImageCopy::SetKernel(kernel))
+            {
+                kernels.push_back(kernel);
+            }
+        }
+        return kernels;
+    }
+
+    static const wchar_t* _GetKernelName(ImageCopy::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case ImageCopy::Kernel::Sse2: return L"SSE2";
+        case ImageCopy::Kernel::Avx: return L"AVX";
+        case ImageCopy::Kernel::Neon: return L"NEON";
+        default: return L"memcpy";
+        }
+    }
+};
@@ -0,0 +1,256 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\ImageScale.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ImageScaleTests)
+{
+public:
+
+    TEST_METHOD_CLEANUP(Cleanup)
+    {
+        (void)ImageScale::SetKernel(ImageScale::GetBestKernel());
+        (void)ImageCopy::SetKernel(ImageCopy::GetBestKernel());
+    }
+
+    TEST_METHOD(CX_W_IS_Identity)
+    {
+        // Same size: all filters reduce to a copy, even with 2.14 fixed-point taps
+        const unsigned int width = 37;
+        const unsigned int height = 11;
+        std::vector<unsigned char> src(4 * width * height);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i * 7 + 3);
+        }
+
+        for (ImageScale::Filter filter : { ImageScale::Filter::Bilinear, ImageScale::Filter::Bicubic, ImageScale::Filter::Lanczos3, ImageScale::Filter::Area })
+        {
+            ImageScale::Scaler scaler;
+            scaler.Initialize(width, height, width, height, 4, filter);
+
+            std::vector<unsigned char> dst(src.size(), 0xCD);
+            scaler.Scale(&dst[0], 4 * width, &src[0], 4 * width);
+            Assert::IsTrue(src == dst);
+        }
+    }
+
+    TEST_METHOD(CX_W_IS_Flat)
+    {
+        // Flat planes stay flat (taps sum to one, edges replicated), upscaling and downscaling
+        const unsigned int sizes[][4] = { { 640, 480, 160, 90 }, { 17, 13, 40, 31 }, { 1, 1, 5, 7 }, { 1920, 1080, 7, 3 } };
+        for (auto size : sizes)
+        {
+            for (unsigned int channels : { 1u, 2u, 4u })
+            {
+                std::vector<unsigned char> src(channels * size[0] * size[1], 77);
+                std::vector<unsigned char> dst(channels * size[2] * size[3], 0);
+
+                ImageScale::Scaler scaler;
+                scaler.Initialize(size[0], size[1], size[2], size[3], channels, ImageScale::Filter::Lanczos3);
+                scaler.Scale(&dst[0], channels * size[2], &src[0], channels * size[0]);
+                for (unsigned char value : dst)
+                {
+                    Assert::AreEqual(77u, (unsigned int)value);
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(CX_W_IS_BottomUp)
+    {
+        // Negative source stride: rows are read from the last one in memory up
+        const unsigned int width = 8;
+        const unsigned int height = 8;
+        std::vector<unsigned char> src(width * height);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i / width * 30); // Row index * 30
+        }
+
+        ImageScale::Scaler scaler;
+        scaler.Initialize(width, height, width / 2, height / 2, 1, ImageScale::Filter::Bilinear);
+        std::vector<unsigned char> dst(width * height / 4);
+        scaler.Scale(&dst[0], width / 2, &src[width * (height - 1)], -(long)width);
+
+        // Upside-down ramp: inner rows land on the ramp at their center (rows 2.5 and 4.5 from the top),
+        // the filter window of edge rows is clamped to the frame
+        const unsigned int expected[] = { 191, 135, 75, 19 };
+        for (unsigned int row = 0; row < height / 2; row++)
+        {
+            Assert::AreEqual(expected[row], (unsigned int)dst[row * width / 2]);
+        }
+    }
+
+    TEST_METHOD(CX_W_IS_Area)
+    {
+        // Luma decimated by 2 (box kernel), 3 (area taps), and 4 (box kernel): each pixel is the average of the
+        // rows of its block, themselves averages of the block pixels
+        for (unsigned int factor : { 2u, 3u, 4u })
+        {
+            const unsigned int width = 24 * factor + 2 * factor; // Vectorized part plus a tail
+            const unsigned int height = 3 * factor;
+            std::vector<unsigned char> src(width * height);
+            for (unsigned int i = 0; i < src.size(); i++)
+            {
+                src[i] = (unsigned char)(i * 7 + i / 13);
+            }
+
+            ImageScale::Scaler scaler;
+            scaler.Initialize(width, height, width / factor, height / factor, 1, ImageScale::Filter::Area);
+
+            for (ImageScale::Kernel kernel : _GetSupportedKernels())
+            {
+                Assert::IsTrue(ImageScale::SetKernel(kernel));
+                std::vector<unsigned char> dst(width * height / (factor * factor));
+                scaler.Scale(&dst[0], width / factor, &src[0], width);
+
+                for (unsigned int y = 0; y < height / factor; y++)
+                {
+                    for (unsigned int x = 0; x < width / factor; x++)
+                    {
+                        unsigned int rows[4];
+                        for (unsigned int j = 0; j < factor; j++)
+                        {
+                            rows[j] = _Average(&src[(y * factor + j) * width + x * factor], factor);
+                        }
+                        Assert::AreEqual(_Average(rows, factor), (unsigned int)dst[y * width / factor + x]);
+                    }
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(CX_W_IS_Kernels)
+    {
+        const unsigned int sizes[][4] = { { 640, 480, 320, 240 }, { 1920, 1080, 160, 90 }, { 33, 9, 70, 19 }, { 100, 100, 100, 100 } };
+        for (auto size : sizes)
+        {
+            for (unsigned int channels : { 1u, 2u, 4u })
+            {
+                for (ImageScale::Filter filter : { ImageScale::Filter::Bilinear, ImageScale::Filter::Bicubic, ImageScale::Filter::Lanczos3, ImageScale::Filter::Area })
+                {
+                    unsigned int srcStride = channels * size[0] + 3; // Unaligned rows
+                    unsigned int dstStride = channels * size[2] + 5;
+                    std::vector<unsigned char> src(srcStride * size[1]);
+                    for (unsigned int i = 0; i < src.size(); i++)
+                    {
+                        src[i] = (unsigned char)(i * 7 + i / 13);
+                    }
+
+                    ImageScale::Scaler scaler;
+                    scaler.Initialize(size[0], size[1], size[2], size[3], channels, filter);
+
+                    Assert::IsTrue(ImageScale::SetKernel(ImageScale::Kernel::Scalar));
+                    std::vector<unsigned char> reference(dstStride * size[3], 0xCD);
+                    scaler.Scale(&reference[0], dstStride, &src[0], srcStride);
+
+                    for (ImageScale::Kernel kernel : _GetSupportedKernels())
+                    {
+                        Assert::IsTrue(ImageScale::SetKernel(kernel));
+                        std::vector<unsigned char> dst(dstStride * size[3], 0xCD);
+                        scaler.Scale(&dst[0], dstStride, &src[0], srcStride);
+                        Assert::IsTrue(reference == dst);
+                    }
+                }
+            }
+        }
+    }
+
+    // Micro-benchmark: 1080p RGB32 frames scaled to 720p and to a 320x180 thumbnail
+    TEST_METHOD(CX_W_IS_Benchmark)
+    {
+        const unsigned int sizes[][2] = { { 1280, 720 }, { 320, 180 } };
+        const unsigned int iterations = 10;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        std::vector<unsigned char> src(4 * 1920 * 1080);
+        for (unsigned int i = 0; i < src.size(); i++)
+        {
+            src[i] = (unsigned char)(i * 7 + 3);
+        }
+
+        for (auto size : sizes)
+        {
+            std::vector<unsigned char> dst(4 * size[0] * size[1]);
+            for (ImageScale::Filter filter : { ImageScale::Filter::Bilinear, ImageScale::Filter::Bicubic, ImageScale::Filter::Lanczos3 })
+            {
+                ImageScale::Scaler scaler;
+                scaler.Initialize(1920, 1080, size[0], size[1], 4, filter);
+
+                for (ImageScale::Kernel kernel : _GetSupportedKernels())
+                {
+                    Assert::IsTrue(ImageScale::SetKernel(kernel));
+
+                    LARGE_INTEGER start;
+                    LARGE_INTEGER stop;
+                    QueryPerformanceCounter(&start);
+                    for (unsigned int n = 0; n < iterations; n++)
+                    {
+                        scaler.Scale(&dst[0], 4 * size[0], &src[0], 4 * 1920);
+                    }
+                    QueryPerformanceCounter(&stop);
+
+                    double milliseconds = (double)(stop.QuadPart - start.QuadPart) * 1000 / frequency.QuadPart / iterations;
+
+                    wchar_t message[128];
+                    swprintf_s(message, L"1080p to %ux%u %s %s: %.2f ms/frame\n", size[0], size[1], _GetFilterName(filter), _GetKernelName(kernel), milliseconds);
+                    Logger::WriteMessage(message);
+                }
+            }
+        }
+    }
+
+private:
+
+    static std::vector<ImageScale::Kernel> _GetSupportedKernels()
+    {
+        std::vector<ImageScale::Kernel> kernels;
+        const ImageScale::Kernel candidates[] = { ImageScale::Kernel::Scalar, ImageScale::Kernel::Sse2, ImageScale::Kernel::Neon };
+        for (ImageScale::Kernel kernel : candidates)
+        {
+            if (ImageScale::SetKernel(kernel))
+            {
+                kernels.push_back(kernel);
+            }
+        }
+        return kernels;
+    }
+
+    static const wchar_t* _GetKernelName(ImageScale::Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case ImageScale::Kernel::Sse2: return L"SSE2";
+        case ImageScale::Kernel::Neon: return L"NEON";
+        default: return L"scalar";
+        }
+    }
+
+    static const wchar_t* _GetFilterName(ImageScale::Filter filter)
+    {
+        switch (filter)
+        {
+        case ImageScale::Filter::Bilinear: return L"bilinear";
+        case ImageScale::Filter::Bicubic: return L"bicubic";
+        case ImageScale::Filter::Lanczos3: return L"Lanczos-3";
+        default: return L"area";
+        }
+    }
+
+    // Fixed-point average of 'count' values with the area taps of the scaler: 1/count each, the first tap
+    // taking the rounding error (1/3 is not exact)
+    template <typename T>
+    static unsigned int _Average(const T *values, unsigned int count)
+    {
+        const int one = 1 << ImageScale::CoefficientBits;
+        int sum = (one % count) * values[0];
+        for (unsigned int k = 0; k < count; k++)
+        {
+            sum += (one / count) * values[k];
+        }
+        return (sum + one / 2) >> ImageScale::CoefficientBits;
+    }
+};
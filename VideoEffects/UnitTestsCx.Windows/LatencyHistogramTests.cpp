@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\LatencyHistogram.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(LatencyHistogramTests)
+{
+public:
+
+    TEST_METHOD(CX_W_LH_Buckets)
+    {
+        // Small values are exact, larger ones land in a bucket within 1/SubBucketCount of their value
+        for (unsigned long long value = 0; value < (1ull << 20); value += 1 + value / 64)
+        {
+            unsigned int index = LatencyHistogram::GetBucketIndex(value);
+            Assert::IsTrue(index < LatencyHistogram::BucketCount);
+
+            unsigned long long lower = LatencyHistogram::GetBucketLowerBound(index);
+            unsigned long long upper = LatencyHistogram::GetBucketUpperBound(index);
+            Assert::IsTrue((lower <= value) && (value <= upper));
+            Assert::IsTrue((upper - lower) * LatencyHistogram::SubBucketCount <= max(value, 1ull));
+        }
+
+        // Largest values are clamped to the last bucket
+        Assert::AreEqual(LatencyHistogram::BucketCount - 1, LatencyHistogram::GetBucketIndex((1ull << LatencyHistogram::ValueBits) - 1));
+    }
+
+    TEST_METHOD(CX_W_LH_Percentiles)
+    {
+        LatencyHistogram histogram;
+        LatencyHistogram::Summary empty = histogram.GetSummary();
+        Assert::AreEqual(0ull, empty.Count);
+        Assert::AreEqual(0ull, empty.P99);
+
+        for (unsigned long long value = 1; value <= 100; value++)
+        {
+            histogram.Record(value * 1000); // 100us to 10ms
+        }
+        histogram.Record(1ull << 50); // Clamped
+
+        LatencyHistogram::Summary summary = histogram.GetSummary();
+        Assert::AreEqual(101ull, summary.Count);
+        Assert::AreEqual((1ull << LatencyHistogram::ValueBits) - 1, summary.Max);
+        Assert::IsTrue((summary.P50 >= 50000) && (summary.P50 <= 50000 * 9 / 8));
+        Assert::IsTrue((summary.P90 >= 90000) && (summary.P90 <= 90000 * 9 / 8));
+        Assert::IsTrue(summary.P99 >= 99000);
+
+        std::wstring json;
+        histogram.AppendJson(json);
+        Assert::IsTrue(json.find(L"\"count\":101,") != std::wstring::npos);
+        Assert::IsTrue(json.find(L"\"buckets\":[[") != std::wstring::npos);
+    }
+};
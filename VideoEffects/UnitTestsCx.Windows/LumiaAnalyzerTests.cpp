@@ -0,0 +1,414 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\EffectStatistics.h"
+#include "..\VideoEffects\VideoEffects.Shared\LatencyHistogram.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Microsoft::WRL;
+using namespace Lumia::Imaging;
+using namespace Platform;
+using namespace VideoEffects;
+using namespace Windows::Foundation;
+
+namespace AWM = ABI::Windows::Media;
+namespace AWFC = ABI::Windows::Foundation::Collections;
+
+// Times of the frames analyzed. Analyses wait for the Release event, which lets tests hold the analyzer busy,
+// and set the Analyzed event when done.
+struct AnalyzerLog
+{
+    AnalyzerLog()
+        : Release(CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET | CREATE_EVENT_INITIAL_SET, EVENT_ALL_ACCESS))
+        , Analyzed(CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS))
+    {
+    }
+
+    ~AnalyzerLog()
+    {
+        CloseHandle(Release);
+        CloseHandle(Analyzed);
+    }
+
+    HANDLE Release;
+    HANDLE Analyzed;
+    std::vector<long long> Times;
+};
+
+TEST_CLASS(LumiaAnalyzerTests)
+{
+public:
+
+    TEST_METHOD(CX_W_LA_DropWhileBusy)
+    {
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(log, 0);
+
+        // Frames arriving while the analyzer is busy are dropped
+        Assert::IsTrue(!!ResetEvent(log->Release));
+        for (long long n = 0; n < 5; n++)
+        {
+            _ProcessFrame(mft, n * 333333);
+        }
+        Assert::IsTrue(!!SetEvent(log->Release));
+        _WaitForAnalyzed(mft, 1);
+
+        Assert::IsTrue(std::vector<long long>{ 0 } == log->Times);
+        _CheckStatistics(mft, 1, 4, 0);
+    }
+
+    TEST_METHOD(CX_W_LA_Interval)
+    {
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(log, 1, L"SamplingInterval", 100);
+
+        // 40fps: one frame in four on the 100ms cadence
+        for (long long n = 0; n < 10; n++)
+        {
+            _ProcessFrame(mft, n * 250000);
+            _WaitForAnalyzed(mft, (unsigned int)n / 4 + 1);
+        }
+
+        // Seeking backward restarts the cadence
+        _ProcessFrame(mft, 0);
+        _WaitForAnalyzed(mft, 4);
+
+        Assert::IsTrue(std::vector<long long>{ 0, 1000000, 2000000, 0 } == log->Times);
+        _CheckStatistics(mft, 4, 0, 7);
+    }
+
+    TEST_METHOD(CX_W_LA_EveryNthFrame)
+    {
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(log, 2, L"SamplingStride", 3);
+
+        for (long long n = 0; n < 12; n++)
+        {
+            _ProcessFrame(mft, n * 333333);
+            _WaitForAnalyzed(mft, (unsigned int)n / 3 + 1);
+        }
+
+        Assert::IsTrue(std::vector<long long>{ 0, 3 * 333333, 6 * 333333, 9 * 333333 } == log->Times);
+        _CheckStatistics(mft, 4, 0, 8);
+    }
+
+    TEST_METHOD(CX_W_LA_LatestWins)
+    {
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(log, 3);
+
+        // Frames arriving while the analyzer is busy replace each other, the last one is analyzed next
+        Assert::IsTrue(!!ResetEvent(log->Release));
+        for (long long n = 0; n < 5; n++)
+        {
+            _ProcessFrame(mft, n * 333333);
+        }
+        Assert::IsTrue(!!SetEvent(log->Release));
+        _WaitForAnalyzed(mft, 2);
+
+        Assert::IsTrue(std::vector<long long>{ 0, 4 * 333333 } == log->Times);
+        _CheckStatistics(mft, 2, 3, 0);
+    }
+
+    TEST_METHOD(CX_W_LA_BoundedQueue)
+    {
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(log, 4, L"SamplingQueueSize", 2);
+
+        // Frames arriving while the analyzer is busy are queued, then dropped once the queue is full
+        Assert::IsTrue(!!ResetEvent(log->Release));
+        for (long long n = 0; n < 5; n++)
+        {
+            _ProcessFrame(mft, n * 333333);
+        }
+        Assert::IsTrue(!!SetEvent(log->Release));
+        _WaitForAnalyzed(mft, 3);
+
+        Assert::IsTrue(std::vector<long long>{ 0, 333333, 2 * 333333 } == log->Times);
+        _CheckStatistics(mft, 3, 2, 0);
+    }
+
+    TEST_METHOD(CX_W_LA_Gray8Nv12)
+    {
+        // Gray8 analyzers read the Y plane of NV12 frames: as is at full size, averaged over 2x2 blocks at half size.
+        // The pattern is constant over 2x2 blocks and the UV plane saturated, so both sizes see the same values.
+        const unsigned int width = 64;
+        const unsigned int height = 48;
+        for (unsigned int length : { width, width / 2 })
+        {
+            std::vector<unsigned char> pixels;
+            HANDLE analyzed = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+            auto definition = ref new LumiaAnalyzerDefinition(ColorMode::Gray8, length, ref new BitmapVideoAnalyzer([&pixels, analyzed](Bitmap^ bitmap, TimeSpan /*time*/)
+            {
+                Assert::IsTrue(bitmap->ColorMode == ColorMode::Gray8);
+                unsigned int pitch = bitmap->Buffers[0]->Pitch;
+                unsigned char *data = _GetData(bitmap->Buffers[0]->Buffer);
+                for (unsigned int y = 0; y < (unsigned int)bitmap->Dimensions.Height; y++)
+                {
+                    pixels.insert(pixels.end(), data + y * pitch, data + y * pitch + (unsigned int)bitmap->Dimensions.Width);
+                }
+                (void)SetEvent(analyzed);
+            }));
+            ComPtr<IMFTransform> mft = _CreateMFT(definition, MFVideoFormat_NV12, width, height);
+
+            ComPtr<IMFSample> sample = _CreateSample(0, MFVideoFormat_NV12, width, height);
+            ComPtr<IMFMediaBuffer> buffer;
+            ComPtr<IMF2DBuffer> buffer2D;
+            Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+            Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+            unsigned char *data = nullptr;
+            long pitch = 0;
+            Assert::AreEqual(S_OK, buffer2D->Lock2D(&data, &pitch));
+            for (unsigned int y = 0; y < height; y++)
+            {
+                for (unsigned int x = 0; x < width; x++)
+                {
+                    data[y * pitch + x] = _GetBlockValue(x / 2, y / 2);
+                }
+            }
+            for (unsigned int y = height; y < 3 * height / 2; y++)
+            {
+                memset(data + y * pitch, 0xFF, width);
+            }
+            Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+
+            _ProcessSample(mft, sample);
+            Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(analyzed, 5000, FALSE));
+            CloseHandle(analyzed);
+
+            unsigned int scale = width / length;
+            Assert::AreEqual((size_t)(width * height / (scale * scale)), pixels.size());
+            for (unsigned int y = 0; y < height / scale; y++)
+            {
+                for (unsigned int x = 0; x < width / scale; x++)
+                {
+                    Assert::AreEqual((unsigned int)_GetBlockValue(x * scale / 2, y * scale / 2), (unsigned int)pixels[y * width / scale + x]);
+                }
+            }
+        }
+    }
+
+    // Micro-benchmark: 720p frames converted to analyzer bitmaps one at a time, the analyzer itself doing nothing
+    TEST_METHOD(CX_W_LA_Benchmark)
+    {
+        const unsigned int iterations = 100;
+        const unsigned int width = 1280;
+        const unsigned int height = 720;
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        for (GUID subtype : { MFVideoFormat_RGB32, MFVideoFormat_NV12 })
+        {
+            for (ColorMode colorMode : { ColorMode::Bgra8888, ColorMode::Yuv420Sp, ColorMode::Gray8 })
+            {
+                for (unsigned int length : { width, 320u })
+                {
+                    auto log = std::make_shared<AnalyzerLog>();
+                    ComPtr<IMFTransform> mft = _CreateMFT(_CreateDefinition(log, 3, colorMode, length), subtype, width, height);
+                    ComPtr<IMFSample> sample = _CreateSample(0, subtype, width, height);
+
+                    // Warm up: the first frame creates the bitmap wrappers and video processor resources
+                    _ProcessSample(mft, sample);
+                    Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(log->Analyzed, 5000, FALSE));
+
+                    LARGE_INTEGER start;
+                    LARGE_INTEGER stop;
+                    QueryPerformanceCounter(&start);
+                    for (unsigned int n = 0; n < iterations; n++)
+                    {
+                        _ProcessSample(mft, sample);
+                        Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(log->Analyzed, 5000, FALSE));
+                    }
+                    QueryPerformanceCounter(&stop);
+
+                    double milliseconds = (double)(stop.QuadPart - start.QuadPart) * 1000 / frequency.QuadPart / iterations;
+
+                    wchar_t message[128];
+                    swprintf_s(message, L"%s 720p to %s %u: %.2f ms/frame\n", subtype == MFVideoFormat_NV12 ? L"NV12" : L"RGB32", _GetColorModeName(colorMode), length, milliseconds);
+                    Logger::WriteMessage(message);
+                }
+            }
+        }
+    }
+
+    // Micro-benchmark: per-frame overhead on 16x16 frames, small enough for the analysis not to hide it.
+    // Frames cycle through a few samples like sample allocators recycle theirs, so the IBuffer wrappers get reused.
+    TEST_METHOD(CX_W_LA_FrameOverheadBenchmark)
+    {
+        const unsigned int iterations = 500;
+
+        auto log = std::make_shared<AnalyzerLog>();
+        ComPtr<IMFTransform> mft = _CreateMFT(_CreateDefinition(log, 3, ColorMode::Bgra8888, 16), MFVideoFormat_RGB32, 16, 16);
+
+        std::vector<ComPtr<IMFSample>> samples;
+        for (unsigned int n = 0; n < 4; n++)
+        {
+            samples.push_back(_CreateSample(0, MFVideoFormat_RGB32, 16, 16));
+        }
+
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER start;
+        LARGE_INTEGER stop;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+        for (unsigned int n = 0; n < iterations; n++)
+        {
+            ComPtr<IMFSample> sample = samples[n % samples.size()];
+            Assert::AreEqual(S_OK, sample->SetSampleTime(n * 333333ll));
+            _ProcessSample(mft, sample);
+            Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(log->Analyzed, 5000, FALSE));
+        }
+        QueryPerformanceCounter(&stop);
+        double frameTime = 1e6 * (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart / iterations;
+        _WaitForAnalyzed(mft, iterations);
+
+        // A wrapper is only created when the previous one has not been returned to the pool yet
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        unsigned long long created = MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_CREATED, 0);
+        unsigned long long reused = MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_REUSED, 0);
+        Assert::AreEqual((unsigned long long)iterations, created + reused);
+        Assert::IsTrue(created <= 2);
+
+        wchar_t message[128];
+        swprintf_s(message, L"Frame overhead: %.1f us, IBuffer wrappers created: %llu, reused: %llu\n", frameTime, created, reused);
+        Logger::WriteMessage(message);
+    }
+
+private:
+
+    ComPtr<IMFTransform> _CreateMFT(
+        _In_ const std::shared_ptr<AnalyzerLog>& log,
+        _In_ unsigned int samplingPolicy,
+        _In_opt_ String^ key = nullptr,
+        _In_ unsigned int value = 0
+        )
+    {
+        auto definition = _CreateDefinition(log, samplingPolicy, ColorMode::Bgra8888, 160);
+        if (key != nullptr)
+        {
+            definition->Properties->Insert(key, value);
+        }
+        return _CreateMFT(definition, MFVideoFormat_RGB32, 640, 480);
+    }
+
+    ComPtr<IMFTransform> _CreateMFT(_In_ LumiaAnalyzerDefinition^ definition, _In_ REFGUID subtype, _In_ unsigned int width, _In_ unsigned int height)
+    {
+        ComPtr<AWM::IMediaExtension> mediaExtension;
+        Assert::AreEqual(S_OK, ActivateInstance(StringReference(definition->ActivatableClassId->Data()).GetHSTRING(), &mediaExtension));
+        Assert::AreEqual(S_OK, mediaExtension->SetProperties(reinterpret_cast<AWFC::IPropertySet*>(definition->Properties)));
+
+        ComPtr<IMFTransform> mft;
+        Assert::AreEqual(S_OK, mediaExtension.As(&mft));
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType(subtype, width, height).Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType(subtype, width, height).Get(), 0));
+        return mft;
+    }
+
+    LumiaAnalyzerDefinition^ _CreateDefinition(
+        _In_ const std::shared_ptr<AnalyzerLog>& log,
+        _In_ unsigned int samplingPolicy,
+        _In_ ColorMode colorMode,
+        _In_ unsigned int length
+        )
+    {
+        auto definition = ref new LumiaAnalyzerDefinition(colorMode, length, ref new BitmapVideoAnalyzer([log](Bitmap^ /*bitmap*/, TimeSpan time)
+        {
+            (void)WaitForSingleObjectEx(log->Release, INFINITE, FALSE);
+            log->Times.push_back(time.Duration);
+            (void)SetEvent(log->Analyzed);
+        }));
+        definition->Properties->Insert(L"SamplingPolicy", samplingPolicy);
+        return definition;
+    }
+
+    void _ProcessFrame(_In_ const ComPtr<IMFTransform>& mft, _In_ long long time)
+    {
+        _ProcessSample(mft, _CreateSample(time, MFVideoFormat_RGB32, 640, 480));
+    }
+
+    // Frames pass through the analyzer unchanged
+    void _ProcessSample(_In_ const ComPtr<IMFTransform>& mft, _In_ const ComPtr<IMFSample>& sample)
+    {
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+    }
+
+    ComPtr<IMFSample> _CreateSample(_In_ long long time, _In_ REFGUID subtype, _In_ unsigned int width, _In_ unsigned int height)
+    {
+        ComPtr<IMFMediaBuffer> buffer;
+        Assert::AreEqual(S_OK, MFCreate2DMediaBuffer(width, height, subtype.Data1, false, &buffer));
+
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(time));
+        Assert::AreEqual(S_OK, sample->SetSampleDuration(333333));
+        return sample;
+    }
+
+    // Analysis runs on the thread pool
+    void _WaitForAnalyzed(_In_ const ComPtr<IMFTransform>& mft, _In_ unsigned int count)
+    {
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        for (unsigned int n = 0; (n < 500) && (MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_ANALYZER_FRAMES_ANALYZED, 0) < count); n++)
+        {
+            Sleep(10);
+            Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        }
+        Assert::AreEqual((unsigned long long)count, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_ANALYZER_FRAMES_ANALYZED, 0));
+    }
+
+    void _CheckStatistics(_In_ const ComPtr<IMFTransform>& mft, _In_ unsigned long long analyzed, _In_ unsigned long long dropped, _In_ unsigned long long skipped)
+    {
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(analyzed, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_ANALYZER_FRAMES_ANALYZED, 0));
+        Assert::AreEqual(dropped, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_ANALYZER_FRAMES_DROPPED, 0));
+        Assert::AreEqual(skipped, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_ANALYZER_FRAMES_SKIPPED, 0));
+
+        LatencyHistogram::Summary lag = {};
+        Assert::AreEqual(S_OK, attributes->GetBlob(VE_STATISTICS_LUMIA_ANALYZER_LAG, reinterpret_cast<UINT8*>(&lag), sizeof(lag), nullptr));
+        Assert::AreEqual(analyzed, lag.Count);
+    }
+
+    ComPtr<IMFMediaType> _CreateMediaType(_In_ REFGUID subtype, _In_ unsigned int width, _In_ unsigned int height) const
+    {
+        ComPtr<IMFMediaType> mt;
+        Assert::AreEqual(S_OK, MFCreateMediaType(&mt));
+        Assert::AreEqual(S_OK, mt->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video));
+        Assert::AreEqual(S_OK, mt->SetGUID(MF_MT_SUBTYPE, subtype));
+        Assert::AreEqual(S_OK, mt->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
+        Assert::AreEqual(S_OK, MFSetAttributeSize(mt.Get(), MF_MT_FRAME_SIZE, width, height));
+        Assert::AreEqual(S_OK, MFSetAttributeRatio(mt.Get(), MF_MT_FRAME_RATE, 1, 30));
+        return mt;
+    }
+
+    static unsigned char _GetBlockValue(_In_ unsigned int blockX, _In_ unsigned int blockY)
+    {
+        return (unsigned char)(blockX * 7 + blockY * 11);
+    }
+
+    static unsigned char *_GetData(_In_ Windows::Storage::Streams::IBuffer^ buffer)
+    {
+        ComPtr<Windows::Storage::Streams::IBufferByteAccess> byteAccess;
+        Assert::AreEqual(S_OK, reinterpret_cast<IInspectable*>(buffer)->QueryInterface(IID_PPV_ARGS(&byteAccess)));
+        unsigned char *data = nullptr;
+        Assert::AreEqual(S_OK, byteAccess->Buffer(&data));
+        return data;
+    }
+
+    static const wchar_t* _GetColorModeName(_In_ ColorMode colorMode)
+    {
+        switch (colorMode)
+        {
+        case ColorMode::Bgra8888: return L"Bgra8888";
+        case ColorMode::Yuv420Sp: return L"Yuv420Sp";
+        default: return L"Gray8";
+        }
+    }
+};
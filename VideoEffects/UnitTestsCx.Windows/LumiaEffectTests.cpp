@@ -1,4 +1,7 @@
 #include "pch.h"
+#include <robuffer.h>
+#include "..\VideoEffects\VideoEffects.Shared\EffectStatistics.h"
+#include "..\VideoEffects\VideoEffects.Shared\LatencyHistogram.h"
 
 using namespace concurrency;
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -15,6 +18,82 @@ using namespace Windows::Foundation::Collections;
 namespace AWM = ABI::Windows::Media;
 namespace AWFC = ABI::Windows::Foundation::Collections;
 
+// Vertical 3-tap box blur of each byte: output rows depend on the input rows above and below
+ref class VerticalBlurEffect sealed : public IBandedBitmapVideoEffect
+{
+public:
+
+    virtual property unsigned int HaloRows
+    {
+        unsigned int get() { return 1; }
+    }
+
+    virtual void Process(Bitmap^ input, Bitmap^ output, TimeSpan time)
+    {
+        ProcessBand(input, output, 0, 0, time);
+    }
+
+    virtual void ProcessBand(Bitmap^ input, Bitmap^ output, unsigned int /*row*/, unsigned int inputRowOffset, TimeSpan /*time*/)
+    {
+        unsigned int width = (unsigned int)output->Dimensions.Width;
+        unsigned int height = (unsigned int)output->Dimensions.Height;
+        unsigned int inputHeight = (unsigned int)input->Dimensions.Height;
+        unsigned int inputPitch = input->Buffers[0]->Pitch;
+        unsigned int outputPitch = output->Buffers[0]->Pitch;
+        const unsigned char *inputData = _GetData(input->Buffers[0]->Buffer);
+        unsigned char *outputData = _GetData(output->Buffers[0]->Buffer);
+
+        for (unsigned int y = 0; y < height; y++)
+        {
+            unsigned int inputRow = y + inputRowOffset;
+            const unsigned char *above = inputData + inputPitch * (inputRow > 0 ? inputRow - 1 : 0);
+            const unsigned char *center = inputData + inputPitch * inputRow;
+            const unsigned char *below = inputData + inputPitch * (inputRow + 1 < inputHeight ? inputRow + 1 : inputRow);
+            unsigned char *dst = outputData + outputPitch * y;
+            for (unsigned int x = 0; x < 4 * width; x++)
+            {
+                dst[x] = (unsigned char)((above[x] + center[x] + below[x]) / 3);
+            }
+        }
+    }
+
+private:
+
+    static unsigned char *_GetData(Windows::Storage::Streams::IBuffer^ buffer)
+    {
+        ComPtr<Windows::Storage::Streams::IBufferByteAccess> byteAccess;
+        Assert::AreEqual(S_OK, reinterpret_cast<IInspectable*>(buffer)->QueryInterface(IID_PPV_ARGS(&byteAccess)));
+        unsigned char *data = nullptr;
+        Assert::AreEqual(S_OK, byteAccess->Buffer(&data));
+        return data;
+    }
+};
+
+// Holds the caller of Process() until released
+ref class BlockingBitmapEffect sealed : public IBitmapVideoEffect
+{
+internal:
+
+    BlockingBitmapEffect(HANDLE entered, HANDLE release)
+        : _entered(entered)
+        , _release(release)
+    {
+    }
+
+public:
+
+    virtual void Process(Bitmap^ /*input*/, Bitmap^ /*output*/, TimeSpan /*time*/)
+    {
+        (void)SetEvent(_entered);
+        (void)WaitForSingleObjectEx(_release, 5000, FALSE);
+    }
+
+private:
+
+    HANDLE _entered;
+    HANDLE _release;
+};
+
 TEST_CLASS(LumiaEffectTests)
 {
 public:
@@ -47,17 +126,1125 @@ public:
         Assert::AreEqual(MF_E_NO_MORE_TYPES, mft->GetOutputAvailableType(0, 1, &mt)); // Only 1 media type (RGB32)
     }
 
+    TEST_METHOD(CX_W_LE_Nv12)
+    {
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"Nv12", 1u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        // NV12 offered first when opted in
+        ComPtr<IMFMediaType> mt;
+        GUID subtype = GUID_NULL;
+        Assert::AreEqual(S_OK, mft->GetInputAvailableType(0, 0, &mt));
+        Assert::AreEqual(S_OK, mt->GetGUID(MF_MT_SUBTYPE, &subtype));
+        Assert::IsTrue(subtype == MFVideoFormat_NV12);
+
+        ComPtr<IMFMediaType> type = _CreateMediaType();
+        Assert::AreEqual(S_OK, type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, type.Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0, 640, 480, MFVideoFormat_NV12.Data1).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        ComPtr<IMFSample> outputSample;
+        outputSample.Attach(output.pSample);
+
+        DWORD length = 0;
+        Assert::AreEqual(S_OK, outputSample->GetTotalLength(&length));
+        Assert::AreEqual(640ul * 480 * 3 / 2, length);
+
+        // RGB32 only by default
+        mft = _CreateMFT();
+        Assert::AreEqual(S_OK, mft->GetInputAvailableType(0, 0, &mt));
+        Assert::AreEqual(S_OK, mt->GetGUID(MF_MT_SUBTYPE, &subtype));
+        Assert::IsTrue(subtype == MFVideoFormat_RGB32);
+        Assert::AreEqual(MF_E_NO_MORE_TYPES, mft->GetInputAvailableType(0, 1, &mt));
+    }
+
+    TEST_METHOD(CX_W_LE_InputQueue)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT(3);
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        // Output ready as soon as a sample is queued
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(MF_E_TRANSFORM_NEED_MORE_INPUT, mft->ProcessOutput(0, 1, &output, &status));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->GetOutputStatus(&status));
+        Assert::AreEqual((DWORD)MFT_OUTPUT_STATUS_SAMPLE_READY, status);
+        Assert::AreEqual(0ll, _GetOutputTime(mft));
+
+        // Input accepted ahead of output until the queue is full
+        for (long long n = 1; n < 4; n++)
+        {
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(n).Get(), 0));
+        }
+        Assert::AreEqual(MF_E_NOTACCEPTING, mft->ProcessInput(0, _CreateSample(4).Get(), 0));
+
+        // Draining returns all the queued samples in order
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, 0));
+        for (long long n = 1; n < 4; n++)
+        {
+            Assert::AreEqual(n * 333333, _GetOutputTime(mft));
+        }
+        Assert::AreEqual(MF_E_TRANSFORM_NEED_MORE_INPUT, mft->ProcessOutput(0, 1, &output, &status));
+    }
+
+    TEST_METHOD(CX_W_LE_GatherBuffers)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSplitSample(0).Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_GATHER, 0));
+        Assert::AreEqual(0ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_CONTIGUOUS, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_GatherBuffersPaddedStride)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        // Rows padded well beyond the pitch of the normalized buffers
+        const unsigned int stride = 640 * 4 + 256;
+        ComPtr<IMFMediaType> type = _CreateMediaType();
+        Assert::AreEqual(S_OK, type->SetUINT32(MF_MT_DEFAULT_STRIDE, stride));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        // Bright top half, dark bottom half, mid-gray padding, split in two 1D buffers in the middle of a row
+        std::vector<unsigned char> frame(stride * 480);
+        for (unsigned int y = 0; y < 480; y++)
+        {
+            memset(&frame[y * stride], y < 240 ? 0xFF : 0x00, 640 * 4);
+            memset(&frame[y * stride + 640 * 4], 0x80, stride - 640 * 4);
+        }
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(0));
+        const unsigned long lengths[] = { stride * 100 + 10, stride * 380 - 10 };
+        unsigned long offset = 0;
+        for (unsigned long length : lengths)
+        {
+            ComPtr<IMFMediaBuffer> buffer;
+            Assert::AreEqual(S_OK, MFCreateMemoryBuffer(length, &buffer));
+            unsigned char *data = nullptr;
+            Assert::AreEqual(S_OK, buffer->Lock(&data, nullptr, nullptr));
+            memcpy(data, &frame[offset], length);
+            Assert::AreEqual(S_OK, buffer->Unlock());
+            Assert::AreEqual(S_OK, buffer->SetCurrentLength(length));
+            Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+            offset += length;
+        }
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        ComPtr<IMFSample> outputSample;
+        outputSample.Attach(output.pSample);
+
+        // Rows land where they belong, padding dropped: both ends of the last bright row are bright,
+        // both ends of the first dark row are dark
+        ComPtr<IMFMediaBuffer> outputBuffer;
+        ComPtr<IMF2DBuffer> outputBuffer2D;
+        Assert::AreEqual(S_OK, outputSample->GetBufferByIndex(0, &outputBuffer));
+        Assert::AreEqual(S_OK, outputBuffer.As(&outputBuffer2D));
+        unsigned char *scanline0 = nullptr;
+        long pitch = 0;
+        Assert::AreEqual(S_OK, outputBuffer2D->Lock2D(&scanline0, &pitch));
+        unsigned int brightLeft = scanline0[239 * pitch + 1];
+        unsigned int brightRight = scanline0[239 * pitch + 639 * 4 + 1];
+        unsigned int darkLeft = scanline0[240 * pitch + 1];
+        unsigned int darkRight = scanline0[240 * pitch + 639 * 4 + 1];
+        Assert::AreEqual(S_OK, outputBuffer2D->Unlock2D());
+        Assert::AreEqual(brightLeft, brightRight);
+        Assert::AreEqual(darkLeft, darkRight);
+        Assert::IsTrue(brightLeft > darkLeft);
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_GATHER, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_ZeroCopyMultiBuffer)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        // A 2D buffer holding the frame followed by a non-empty trailing buffer
+        ComPtr<IMFSample> sample = _CreateSample(0);
+        ComPtr<IMFMediaBuffer> trailer;
+        Assert::AreEqual(S_OK, MFCreateMemoryBuffer(16, &trailer));
+        Assert::AreEqual(S_OK, trailer->SetCurrentLength(16));
+        Assert::AreEqual(S_OK, sample->AddBuffer(trailer.Get()));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+
+        // Counted once, without copies
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_ZERO_COPY, 0));
+        Assert::AreEqual(0ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_GATHER, 0));
+        Assert::AreEqual(0ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_1D_TO_2D, 0));
+        Assert::AreEqual(0ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_NONE, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_SampleAllocatorMaxSize)
+    {
+        // The pools must hold the queued frames, plus two frames with motion-adaptive deinterlacing
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"InputQueueSize", 4u);
+        definition->Properties->Insert(L"SampleAllocatorMaxSize", 3u);
+        Assert::AreEqual(E_INVALIDARG, _SetProperties(definition));
+        definition->Properties->Insert(L"Deinterlace", 2u);
+        definition->Properties->Insert(L"SampleAllocatorMaxSize", 5u);
+        Assert::AreEqual(E_INVALIDARG, _SetProperties(definition));
+        definition->Properties->Insert(L"SampleAllocatorMaxSize", 6u);
+        Assert::AreEqual(S_OK, _SetProperties(definition));
+
+        // Without an explicit maximum, the default grows with the queue
+        definition->Properties->Remove(L"SampleAllocatorMaxSize");
+        definition->Properties->Insert(L"InputQueueSize", 60u);
+        Assert::AreEqual(S_OK, _SetProperties(definition));
+
+        // A pool just large enough streams without running out of samples: split frames are gathered
+        // into input-pool samples
+        definition->Properties->Remove(L"Deinterlace");
+        definition->Properties->Insert(L"InputQueueSize", 4u);
+        definition->Properties->Insert(L"SampleAllocatorMaxSize", 4u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        for (long long n = 0; n < 12; n++)
+        {
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSplitSample(n).Get(), 0));
+            if (n >= 3)
+            {
+                Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+                output.pSample->Release();
+                output.pSample = nullptr;
+            }
+        }
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(12ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_GATHER, 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_BottomUp)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        ComPtr<IMFMediaType> type = _CreateMediaType();
+        Assert::AreEqual(S_OK, type->SetUINT32(MF_MT_DEFAULT_STRIDE, (unsigned int)(-640 * 4)));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, type.Get(), 0));
+
+        // Bottom-up 1D buffer: dark bottom half first in memory, bright top half last
+        const unsigned long length = 640 * 4 * 480;
+        ComPtr<IMFMediaBuffer> buffer;
+        Assert::AreEqual(S_OK, MFCreateMemoryBuffer(length, &buffer));
+        unsigned char *data = nullptr;
+        Assert::AreEqual(S_OK, buffer->Lock(&data, nullptr, nullptr));
+        memset(data, 0x00, length / 2);
+        memset(data + length / 2, 0xFF, length / 2);
+        Assert::AreEqual(S_OK, buffer->Unlock());
+        Assert::AreEqual(S_OK, buffer->SetCurrentLength(length));
+
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        ComPtr<IMFSample> outputSample;
+        outputSample.Attach(output.pSample);
+
+        // The picture is still upright: top row bright, bottom row dark
+        ComPtr<IMFMediaBuffer> outputBuffer;
+        ComPtr<IMF2DBuffer> outputBuffer2D;
+        Assert::AreEqual(S_OK, outputSample->GetBufferByIndex(0, &outputBuffer));
+        Assert::AreEqual(S_OK, outputBuffer.As(&outputBuffer2D));
+        unsigned char *scanline0 = nullptr;
+        long pitch = 0;
+        Assert::AreEqual(S_OK, outputBuffer2D->Lock2D(&scanline0, &pitch));
+        unsigned int top = scanline0[640 * 2 + 1];
+        unsigned int bottom = scanline0[479 * pitch + 640 * 2 + 1];
+        Assert::AreEqual(S_OK, outputBuffer2D->Unlock2D());
+        Assert::IsTrue(top > bottom);
+
+        // Read in place, no normalization copy
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(0ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_NORMALIZE_1D_TO_2D, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_QosDrop)
+    {
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"QosPolicy", 1u); // Drop
+        definition->Properties->Insert(L"QosLatencyBudget", 20u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        // First frame on time
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+        output.pSample = nullptr;
+
+        // Frame with the same presentation time processed well past the budget
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Sleep(100);
+        Assert::AreEqual(MF_E_TRANSFORM_NEED_MORE_INPUT, mft->ProcessOutput(0, 1, &output, &status));
+
+        // Frame far in the future, flagged as following a drop
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(300).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        Assert::IsTrue(!!MFGetAttributeUINT32(output.pSample, MFSampleExtension_Discontinuity, false));
+        output.pSample->Release();
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(2ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_QOS_FRAMES_PROCESSED, 0));
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_QOS_FRAMES_DROPPED, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_FormatChange)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+        output.pSample = nullptr;
+
+        // Resolution change while streaming, with a frame already queued at the new resolution
+        ComPtr<IMFMediaType> smallType = _CreateMediaType();
+        Assert::AreEqual(S_OK, MFSetAttributeSize(smallType.Get(), MF_MT_FRAME_SIZE, 320, 240));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, smallType.Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(1, 320, 240).Get(), 0));
+
+        // Output type renegotiated without draining the queued frame
+        Assert::AreEqual(MF_E_TRANSFORM_STREAM_CHANGE, mft->ProcessOutput(0, 1, &output, &status));
+        Assert::AreEqual((DWORD)MFT_OUTPUT_DATA_BUFFER_FORMAT_CHANGE, output.dwStatus);
+        Assert::IsTrue(output.pSample == nullptr);
+        output.dwStatus = 0;
+
+        ComPtr<IMFMediaType> availableType;
+        Assert::AreEqual(S_OK, mft->GetOutputAvailableType(0, 0, &availableType));
+        unsigned int width;
+        unsigned int height;
+        Assert::AreEqual(S_OK, MFGetAttributeSize(availableType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+        Assert::AreEqual(320u, width);
+        Assert::AreEqual(240u, height);
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, availableType.Get(), 0));
+
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        long long time = 0;
+        Assert::AreEqual(S_OK, output.pSample->GetSampleTime(&time));
+        Assert::AreEqual(333333ll, time);
+        output.pSample->Release();
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_FORMAT_CHANGES, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_Prewarm)
+    {
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"Prewarm", 1u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+
+        // Streaming starts on the thread pool
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        for (unsigned int n = 0; (n < 100) && (MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_PREWARM_COUNT, 0) == 0); n++)
+        {
+            Sleep(10);
+            Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        }
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_PREWARM_COUNT, 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::IsTrue(MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_FIRST_FRAME_LATENCY, 0) > 0);
+
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_LatencyStatistics)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        for (long long n = 0; n < 2; n++)
+        {
+            DWORD status = 0;
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(n).Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+            output.pSample->Release();
+        }
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+
+        LatencyHistogram::Summary process = {};
+        Assert::AreEqual(S_OK, attributes->GetBlob(VE_STATISTICS_LATENCY_PROCESS, reinterpret_cast<UINT8*>(&process), sizeof(process), nullptr));
+        Assert::AreEqual(2ull, process.Count);
+        Assert::IsTrue((process.Max > 0) && (process.P50 <= process.Max));
+
+        LatencyHistogram::Summary queueWait = {};
+        Assert::AreEqual(S_OK, attributes->GetBlob(VE_STATISTICS_LATENCY_QUEUE_WAIT, reinterpret_cast<UINT8*>(&queueWait), sizeof(queueWait), nullptr));
+        Assert::AreEqual(2ull, queueWait.Count);
+
+        // The JSON dump is published when streaming ends
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        wchar_t *json = nullptr;
+        unsigned int length = 0;
+        Assert::AreEqual(S_OK, attributes->GetAllocatedString(VE_STATISTICS_LATENCY_JSON, &json, &length));
+        Assert::IsTrue(std::wstring(json).find(L"\"process\":{\"count\":2,") != std::wstring::npos);
+        CoTaskMemFree(json);
+    }
+
+    TEST_METHOD(CX_W_LE_RenderGraphReuse)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+
+        // Frames alternate between bright and dark: a graph still rendering a previous input would be caught
+        unsigned long long firstFrameObjects = 0;
+        unsigned int outputs[5] = {};
+        ComPtr<IMFAttributes> attributes;
+        for (long long n = 0; n < 5; n++)
+        {
+            ComPtr<IMFSample> sample = _CreateSample(n);
+            _FillSample(sample, (n % 2 == 0) ? 0xE0 : 0x20);
+
+            DWORD status = 0;
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+            ComPtr<IMFSample> outputSample;
+            outputSample.Attach(output.pSample);
+            outputs[n] = (_GetPixel(outputSample, 320, 240) >> 8) & 0xFF; // Green
+
+            Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+            if (n == 0)
+            {
+                firstFrameObjects = MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_RENDER_OBJECTS, 0);
+            }
+        }
+
+        // Each output follows its own input: bright frames brighter than the dark frames around them
+        for (long long n = 1; n < 5; n++)
+        {
+            Assert::IsTrue((n % 2 == 0) ? (outputs[n] > outputs[n - 1]) : (outputs[n] < outputs[n - 1]));
+        }
+
+        // The graph built on the first frame renders the following ones without creating objects
+        Assert::AreEqual(1ull, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_RENDER_GRAPHS, 0));
+        Assert::IsTrue(firstFrameObjects > 0);
+        Assert::AreEqual(firstFrameObjects, MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_RENDER_OBJECTS, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_AsyncPipelined)
+    {
+        // Each render graph gets its own filter chain
+        auto chainCount = std::make_shared<long>(0);
+        auto definition = ref new LumiaEffectDefinition(ref new FilterChainFactory([chainCount]()
+        {
+            InterlockedIncrement(chainCount.get());
+            auto filters = ref new Vector<IFilter^>();
+            filters->Append(ref new AntiqueFilter());
+            return filters;
+        }));
+        definition->Properties->Insert(L"AsyncFramesInFlight", 4u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        // 1080p frames: renders last long enough for the following frames to be submitted meanwhile
+        ComPtr<IMFMediaType> frameType = _CreateMediaType();
+        Assert::AreEqual(S_OK, MFSetAttributeSize(frameType.Get(), MF_MT_FRAME_SIZE, 1920, 1080));
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(S_OK, attributes->SetUINT32(MF_TRANSFORM_ASYNC_UNLOCK, TRUE));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, frameType.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, frameType.Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0));
+
+        ComPtr<IMFMediaEventGenerator> events;
+        Assert::AreEqual(S_OK, mft.As(&events));
+
+        // Renders complete in the background, outputs still come back in input order
+        const long long frameCount = 12;
+        long long inputCount = 0;
+        long long outputCount = 0;
+        while (outputCount < frameCount)
+        {
+            ComPtr<IMFMediaEvent> event;
+            MediaEventType type = MEUnknown;
+            Assert::AreEqual(S_OK, events->GetEvent(0, &event));
+            Assert::AreEqual(S_OK, event->GetType(&type));
+
+            if ((type == METransformNeedInput) && (inputCount < frameCount))
+            {
+                Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(inputCount, 1920, 1080).Get(), 0));
+                inputCount++;
+            }
+            else if (type == METransformHaveOutput)
+            {
+                DWORD status = 0;
+                MFT_OUTPUT_DATA_BUFFER output = {};
+                Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+                ComPtr<IMFSample> outputSample;
+                outputSample.Attach(output.pSample);
+
+                long long time = 0;
+                Assert::AreEqual(S_OK, outputSample->GetSampleTime(&time));
+                Assert::AreEqual(outputCount * 333333, time);
+                outputCount++;
+            }
+        }
+
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::IsTrue(MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_LUMIA_RENDERS_IN_FLIGHT_MAX, 0) >= 2);
+        Assert::AreEqual(MFGetAttributeUINT64(attributes.Get(), VE_STATISTICS_LUMIA_RENDER_GRAPHS, 0), (unsigned long long)*chainCount);
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_AsyncMessages)
+    {
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"AsyncFramesInFlight", 2u);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        // Asynchronous MFTs stay locked until the client unlocks them
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1u, MFGetAttributeUINT32(attributes.Get(), MF_TRANSFORM_ASYNC, 0));
+        Assert::AreEqual(MF_E_TRANSFORM_ASYNC_LOCKED, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0));
+        Assert::AreEqual(S_OK, attributes->SetUINT32(MF_TRANSFORM_ASYNC_UNLOCK, TRUE));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+
+        ComPtr<IMFMediaEventGenerator> events;
+        Assert::AreEqual(S_OK, mft.As(&events));
+
+        // No input requested before the start of the stream
+        ComPtr<IMFMediaEvent> event;
+        Assert::AreEqual(MF_E_NO_EVENTS_AVAILABLE, events->GetEvent(MF_EVENT_FLAG_NO_WAIT, &event));
+        Assert::AreEqual(MF_E_NOTACCEPTING, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+
+        // One METransformNeedInput per frame in flight, input beyond the requests is rejected
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0));
+        Assert::AreEqual((unsigned int)METransformNeedInput, (unsigned int)_GetEvent(events));
+        Assert::AreEqual((unsigned int)METransformNeedInput, (unsigned int)_GetEvent(events));
+        Assert::AreEqual(MF_E_NO_EVENTS_AVAILABLE, events->GetEvent(MF_EVENT_FLAG_NO_WAIT, &event));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(1).Get(), 0));
+        Assert::AreEqual(MF_E_NOTACCEPTING, mft->ProcessInput(0, _CreateSample(2).Get(), 0));
+
+        // Each output returned frees a slot: never more requests than free slots, outputs in input order.
+        // Drain once all the frames are in: the remaining outputs come back, then METransformDrainComplete.
+        const long long frameCount = 8;
+        long long inputCount = 2;
+        long long outputCount = 0;
+        long long requestCount = 2;
+        bool drainComplete = false;
+        while (!drainComplete)
+        {
+            MediaEventType type = _GetEvent(events);
+            if (type == METransformNeedInput)
+            {
+                requestCount++;
+                Assert::IsTrue(requestCount <= outputCount + 2);
+                if (inputCount < frameCount)
+                {
+                    Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(inputCount).Get(), 0));
+                    inputCount++;
+                    if (inputCount == frameCount)
+                    {
+                        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_COMMAND_DRAIN, 0));
+                    }
+                }
+            }
+            else if (type == METransformHaveOutput)
+            {
+                Assert::AreEqual(outputCount * 333333, _GetOutputTime(mft));
+                outputCount++;
+            }
+            else
+            {
+                Assert::AreEqual((unsigned int)METransformDrainComplete, (unsigned int)type);
+                drainComplete = true;
+            }
+        }
+        Assert::AreEqual(frameCount, outputCount);
+        Assert::AreEqual(MF_E_NO_EVENTS_AVAILABLE, events->GetEvent(MF_EVENT_FLAG_NO_WAIT, &event));
+
+        // Flush: frames in flight are dropped and input requests canceled until the next start of stream
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0));
+        Assert::AreEqual((unsigned int)METransformNeedInput, (unsigned int)_GetEvent(events));
+        Assert::AreEqual((unsigned int)METransformNeedInput, (unsigned int)_GetEvent(events));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(100).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(101).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0));
+        Assert::AreEqual(MF_E_NOTACCEPTING, mft->ProcessInput(0, _CreateSample(102).Get(), 0));
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(MF_E_TRANSFORM_NEED_MORE_INPUT, mft->ProcessOutput(0, 1, &output, &status));
+
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, 0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(200).Get(), 0));
+        outputCount = 0;
+        while (outputCount < 1)
+        {
+            // METransformHaveOutput sent before the flush find no output
+            if (_GetEvent(events) == METransformHaveOutput)
+            {
+                output.pSample = nullptr;
+                HRESULT hr = mft->ProcessOutput(0, 1, &output, &status);
+                if (hr == S_OK)
+                {
+                    ComPtr<IMFSample> outputSample;
+                    outputSample.Attach(output.pSample);
+                    long long time = 0;
+                    Assert::AreEqual(S_OK, outputSample->GetSampleTime(&time));
+                    Assert::AreEqual(200ll * 333333, time);
+                    outputCount++;
+                }
+                else
+                {
+                    Assert::AreEqual(MF_E_TRANSFORM_NEED_MORE_INPUT, hr);
+                }
+            }
+        }
+
+        Assert::AreEqual(S_OK, mft->ProcessMessage(MFT_MESSAGE_NOTIFY_END_STREAMING, 0));
+
+        // Back to synchronous mode
+        ComPtr<AWM::IMediaExtension> mediaExtension;
+        Assert::AreEqual(S_OK, mft.As(&mediaExtension));
+        definition->Properties->Insert(L"AsyncFramesInFlight", 0u);
+        Assert::AreEqual(S_OK, mediaExtension->SetProperties(reinterpret_cast<AWFC::IPropertySet*>(definition->Properties)));
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(0u, MFGetAttributeUINT32(attributes.Get(), MF_TRANSFORM_ASYNC, 0));
+        Assert::AreEqual(0u, MFGetAttributeUINT32(attributes.Get(), MFT_SUPPORT_DYNAMIC_FORMAT_CHANGE, 0));
+    }
+
+    TEST_METHOD(CX_W_LE_LockContention)
+    {
+        HANDLE entered = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+        HANDLE release = CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
+        HANDLE queried = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+        auto definition = ref new LumiaEffectDefinition(ref new BitmapVideoEffectFactory([entered, release]()
+        {
+            return ref new BlockingBitmapEffect(entered, release);
+        }));
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+
+        // Hold ProcessOutput() in ProcessSample()
+        auto output = create_task([mft]()
+        {
+            DWORD status = 0;
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            HRESULT hr = mft->ProcessOutput(0, 1, &output, &status);
+            if (SUCCEEDED(hr))
+            {
+                output.pSample->Release();
+            }
+            return hr;
+        });
+        Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(entered, 5000, FALSE));
+
+        // Queries only take the state lock: they do not wait for the frame
+        auto queries = create_task([mft, queried]()
+        {
+            HRESULT hr = S_OK;
+            for (unsigned int n = 0; (n < 100) && SUCCEEDED(hr); n++)
+            {
+                ComPtr<IMFAttributes> attributes;
+                ComPtr<IMFMediaType> type;
+                hr = mft->GetAttributes(&attributes);
+                hr = SUCCEEDED(hr) ? mft->GetInputAvailableType(0, 0, &type) : hr;
+                hr = SUCCEEDED(hr) ? mft->GetOutputCurrentType(0, &type) : hr;
+            }
+            (void)SetEvent(queried);
+            return hr;
+        });
+        Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObjectEx(queried, 5000, FALSE));
+        Assert::AreEqual(S_OK, queries.get());
+
+        // Streaming calls wait for the frame
+        ComPtr<IMFSample> sample = _CreateSample(1);
+        auto input = create_task([mft, sample]()
+        {
+            return mft->ProcessInput(0, sample.Get(), 0);
+        });
+        ComPtr<IMFAttributes> attributes;
+        for (unsigned int n = 0; n < 500; n++)
+        {
+            Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+            if (MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_STREAMING_LOCK_CONTENTIONS, 0) != 0)
+            {
+                break;
+            }
+            Sleep(10);
+        }
+        Assert::AreEqual(1u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_STREAMING_LOCK_CONTENTIONS, 0));
+        Assert::AreEqual(0u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_STATE_LOCK_CONTENTIONS, 0));
+
+        (void)SetEvent(release);
+        Assert::AreEqual(S_OK, output.get());
+        Assert::AreEqual(S_OK, input.get());
+
+        CloseHandle(entered);
+        CloseHandle(release);
+        CloseHandle(queried);
+    }
+
+    TEST_METHOD(CX_W_LE_FrameTracing)
+    {
+        auto definition = _CreateDefinition();
+        definition->Properties->Insert(L"FrameTracing", 3u);
+        Assert::AreEqual(E_INVALIDARG, _SetProperties(definition));
+
+        // The setting belongs to each instance: a traced effect and an untraced one stream side by side
+        definition->Properties->Insert(L"FrameTracing", 2u);
+        ComPtr<IMFTransform> traced = _CreateMFT(definition);
+        ComPtr<IMFTransform> untraced = _CreateMFT();
+        for (const ComPtr<IMFTransform>& mft : { traced, untraced })
+        {
+            Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+            Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+            Assert::AreEqual(0ll, _GetOutputTime(mft));
+        }
+    }
+
+    TEST_METHOD(CX_W_LE_TypeCache)
+    {
+        ComPtr<IMFTransform> mft = _CreateMFT();
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+
+        // Output must match input, the second check is answered from the cache
+        ComPtr<IMFMediaType> smallType = _CreateMediaType();
+        Assert::AreEqual(S_OK, MFSetAttributeSize(smallType.Get(), MF_MT_FRAME_SIZE, 320, 240));
+        Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetOutputType(0, smallType.Get(), MFT_SET_TYPE_TEST_ONLY));
+        Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetOutputType(0, smallType.Get(), MFT_SET_TYPE_TEST_ONLY));
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_TYPE_CACHE_HITS, 0));
+
+        // Cache hits need all the attributes to match: IUnknown attributes are told apart by object
+        const GUID objectKey = { 0x6A3C1E52, 0x0B7D, 0x4F19, { 0x8E, 0x22, 0x5D, 0x91, 0xC4, 0x0A, 0x73, 0xBE } };
+        ComPtr<IMFMediaType> objectTypes[2];
+        for (auto& objectType : objectTypes)
+        {
+            ComPtr<IMFAttributes> object;
+            Assert::AreEqual(S_OK, MFCreateAttributes(&object, 0));
+            objectType = _CreateMediaType();
+            Assert::AreEqual(S_OK, MFSetAttributeSize(objectType.Get(), MF_MT_FRAME_SIZE, 320, 240));
+            Assert::AreEqual(S_OK, objectType->SetUnknown(objectKey, object.Get()));
+            Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetOutputType(0, objectType.Get(), MFT_SET_TYPE_TEST_ONLY));
+        }
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(1u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_TYPE_CACHE_HITS, 0));
+        Assert::AreEqual(MF_E_INVALIDMEDIATYPE, mft->SetOutputType(0, objectTypes[0].Get(), MFT_SET_TYPE_TEST_ONLY));
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(2u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_TYPE_CACHE_HITS, 0));
+
+        // Changing the input type invalidates the cache
+        Assert::AreEqual(S_OK, mft->SetInputType(0, smallType.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, smallType.Get(), MFT_SET_TYPE_TEST_ONLY));
+
+        // Callers get copies of the cached available types
+        ComPtr<IMFMediaType> availableType;
+        Assert::AreEqual(S_OK, mft->GetOutputAvailableType(0, 0, &availableType));
+        Assert::AreEqual(S_OK, MFSetAttributeSize(availableType.Get(), MF_MT_FRAME_SIZE, 16, 16));
+        Assert::AreEqual(S_OK, mft->GetOutputAvailableType(0, 0, &availableType));
+        unsigned int width;
+        unsigned int height;
+        Assert::AreEqual(S_OK, MFGetAttributeSize(availableType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+        Assert::AreEqual(320u, width);
+    }
+
+    // Benchmark: type negotiation as done by topology resolution, on a new effect (one per clip) and repeated on the same effect
+    TEST_METHOD(CX_W_LE_NegotiationBenchmark)
+    {
+        const unsigned int iterations = 200;
+
+        LARGE_INTEGER frequency;
+        LARGE_INTEGER start;
+        LARGE_INTEGER stop;
+        QueryPerformanceFrequency(&frequency);
+
+        std::vector<ComPtr<IMFTransform>> mfts;
+        for (unsigned int n = 0; n < iterations; n++)
+        {
+            mfts.push_back(_CreateMFT());
+        }
+
+        QueryPerformanceCounter(&start);
+        for (auto& mft : mfts)
+        {
+            _Negotiate(mft);
+        }
+        QueryPerformanceCounter(&stop);
+        double coldTime = 1e6 * (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart / iterations;
+
+        QueryPerformanceCounter(&start);
+        for (unsigned int n = 0; n < iterations; n++)
+        {
+            _Negotiate(mfts[0]);
+        }
+        QueryPerformanceCounter(&stop);
+        double warmTime = 1e6 * (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart / iterations;
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mfts[0]->GetAttributes(&attributes));
+
+        wchar_t message[128];
+        swprintf_s(message, L"Negotiation new effect: %.1f us, repeated: %.1f us, cache hits: %u\n", 
+            coldTime, warmTime, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_TYPE_CACHE_HITS, 0));
+        Logger::WriteMessage(message);
+    }
+
+    TEST_METHOD(CX_W_LE_Scaler)
+    {
+        // Empty filter chain: the output is the scaled input, whether scaled before or after the chain
+        for (unsigned int scaler : { 1u, 2u })
+        {
+            auto definition = ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
+            {
+                return ref new Vector<IFilter^>();
+            }));
+            definition->InputWidth = 640;
+            definition->InputHeight = 480;
+            definition->OutputWidth = 320;
+            definition->OutputHeight = 240;
+            definition->Properties->Insert(L"Scaler", scaler);
+            ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+            ComPtr<IMFMediaType> type = _CreateMediaType();
+            Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+            Assert::AreEqual(S_OK, MFSetAttributeSize(type.Get(), MF_MT_FRAME_SIZE, 320, 240));
+            Assert::AreEqual(S_OK, mft->SetOutputType(0, type.Get(), 0));
+
+            // Left half dark, right half bright
+            ComPtr<IMFSample> sample = _CreateSample(0);
+            ComPtr<IMFMediaBuffer> buffer;
+            ComPtr<IMF2DBuffer> buffer2D;
+            Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+            Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+            unsigned char *scanline0 = nullptr;
+            long pitch = 0;
+            Assert::AreEqual(S_OK, buffer2D->Lock2D(&scanline0, &pitch));
+            for (unsigned int y = 0; y < 480; y++)
+            {
+                memset(scanline0 + y * pitch, 0x20, 4 * 320);
+                memset(scanline0 + y * pitch + 4 * 320, 0xE0, 4 * 320);
+            }
+            Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+
+            DWORD status = 0;
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+            ComPtr<IMFSample> outputSample;
+            outputSample.Attach(output.pSample);
+
+            ComPtr<IMFMediaBuffer> outputBuffer;
+            ComPtr<IMF2DBuffer> outputBuffer2D;
+            Assert::AreEqual(S_OK, outputSample->GetBufferByIndex(0, &outputBuffer));
+            Assert::AreEqual(S_OK, outputBuffer.As(&outputBuffer2D));
+            Assert::AreEqual(S_OK, outputBuffer2D->Lock2D(&scanline0, &pitch));
+            unsigned int left = scanline0[120 * pitch + 4 * 40 + 1];
+            unsigned int right = scanline0[120 * pitch + 4 * 280 + 1];
+            Assert::AreEqual(S_OK, outputBuffer2D->Unlock2D());
+            Assert::AreEqual(0x20u, left);
+            Assert::AreEqual(0xE0u, right);
+        }
+    }
+
+    TEST_METHOD(CX_W_LE_ScalerNv12)
+    {
+        // Both planes scaled: the UV plane has the pitch of the Y plane and half its rows
+        for (unsigned int scaler : { 1u, 2u })
+        {
+            auto definition = ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
+            {
+                return ref new Vector<IFilter^>();
+            }));
+            definition->InputWidth = 640;
+            definition->InputHeight = 480;
+            definition->OutputWidth = 320;
+            definition->OutputHeight = 240;
+            definition->Properties->Insert(L"Nv12", 1u);
+            definition->Properties->Insert(L"Scaler", scaler);
+            ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+            ComPtr<IMFMediaType> type = _CreateMediaType();
+            Assert::AreEqual(S_OK, type->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12));
+            Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+            Assert::AreEqual(S_OK, MFSetAttributeSize(type.Get(), MF_MT_FRAME_SIZE, 320, 240));
+            Assert::AreEqual(S_OK, mft->SetOutputType(0, type.Get(), 0));
+
+            // Luma: left half dark, right half bright. Chroma: top half low, bottom half high.
+            ComPtr<IMFSample> sample = _CreateSample(0, 640, 480, MFVideoFormat_NV12.Data1);
+            ComPtr<IMFMediaBuffer> buffer;
+            ComPtr<IMF2DBuffer> buffer2D;
+            Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+            Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+            unsigned char *scanline0 = nullptr;
+            long pitch = 0;
+            Assert::AreEqual(S_OK, buffer2D->Lock2D(&scanline0, &pitch));
+            for (unsigned int y = 0; y < 480; y++)
+            {
+                memset(scanline0 + y * pitch, 0x20, 320);
+                memset(scanline0 + y * pitch + 320, 0xE0, 320);
+            }
+            for (unsigned int y = 0; y < 240; y++)
+            {
+                memset(scanline0 + (480 + y) * pitch, y < 120 ? 0x40 : 0xC0, 640);
+            }
+            Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+
+            DWORD status = 0;
+            MFT_OUTPUT_DATA_BUFFER output = {};
+            Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+            Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+            ComPtr<IMFSample> outputSample;
+            outputSample.Attach(output.pSample);
+
+            ComPtr<IMFMediaBuffer> outputBuffer;
+            ComPtr<IMF2DBuffer> outputBuffer2D;
+            DWORD outputLength = 0;
+            Assert::AreEqual(S_OK, outputSample->GetBufferByIndex(0, &outputBuffer));
+            Assert::AreEqual(S_OK, outputBuffer.As(&outputBuffer2D));
+            Assert::AreEqual(S_OK, outputBuffer2D->Lock2D(&scanline0, &pitch));
+            Assert::AreEqual(S_OK, outputBuffer2D->GetContiguousLength(&outputLength));
+            unsigned int left = scanline0[120 * pitch + 40];
+            unsigned int right = scanline0[120 * pitch + 280];
+            unsigned int top = scanline0[(240 + 30) * pitch + 160];
+            unsigned int bottom = scanline0[(240 + 90) * pitch + 161];
+            Assert::AreEqual(S_OK, outputBuffer2D->Unlock2D());
+
+            Assert::IsTrue(pitch >= 320);
+            Assert::AreEqual((DWORD)(pitch * 240 * 3 / 2), outputLength);
+            Assert::AreEqual(0x20u, left);
+            Assert::AreEqual(0xE0u, right);
+            Assert::AreEqual(0x40u, top);
+            Assert::AreEqual(0xC0u, bottom);
+        }
+    }
+
+    TEST_METHOD(CX_W_LE_BandedBitmapEffect)
+    {
+        // Bands must produce the same frame as a single band, halo rows included
+        std::vector<unsigned char> reference = _ProcessBanded(1, 640, 480);
+        std::vector<unsigned char> banded = _ProcessBanded(7, 640, 480); // Uneven split
+        Assert::IsTrue(reference == banded);
+
+        // Band count published as a statistic
+        ComPtr<IMFTransform> mft = _CreateBandedMFT(7, 640, 480);
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, _CreateSample(0).Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        output.pSample->Release();
+
+        ComPtr<IMFAttributes> attributes;
+        Assert::AreEqual(S_OK, mft->GetAttributes(&attributes));
+        Assert::AreEqual(7u, MFGetAttributeUINT32(attributes.Get(), VE_STATISTICS_LUMIA_BITMAP_EFFECT_BANDS, 0));
+    }
+
+    // Scaling benchmark: 1080p frames of a banded bitmap effect split into 1 to N bands, N being the core count
+    TEST_METHOD(CX_W_LE_BandedBitmapEffectBenchmark)
+    {
+        const unsigned int iterations = 30;
+
+        SYSTEM_INFO info;
+        GetNativeSystemInfo(&info);
+
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        double singleBandTime = 0.;
+        for (unsigned int bandCount = 1; bandCount <= info.dwNumberOfProcessors; bandCount++)
+        {
+            ComPtr<IMFTransform> mft = _CreateBandedMFT(bandCount, 1920, 1080);
+            ComPtr<IMFSample> sample = _CreateSample(0, 1920, 1080);
+
+            LARGE_INTEGER start;
+            LARGE_INTEGER stop;
+            QueryPerformanceCounter(&start);
+            for (unsigned int n = 0; n < iterations; n++)
+            {
+                DWORD status = 0;
+                MFT_OUTPUT_DATA_BUFFER output = {};
+                Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+                Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+                output.pSample->Release();
+            }
+            QueryPerformanceCounter(&stop);
+            double frameTime = 1e3 * (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart / iterations;
+            if (bandCount == 1)
+            {
+                singleBandTime = frameTime;
+            }
+
+            wchar_t message[128];
+            swprintf_s(message, L"Bands: %u, frame: %.2f ms, speedup: %.2fx\n", bandCount, frameTime, singleBandTime / frameTime);
+            Logger::WriteMessage(message);
+        }
+    }
+
 private:
 
-    ComPtr<IMFTransform> _CreateMFT()
+    ComPtr<IMFTransform> _CreateBandedMFT(unsigned int bandCount, unsigned int width, unsigned int height)
+    {
+        auto definition = ref new LumiaEffectDefinition(ref new BitmapVideoEffectFactory([]()
+        {
+            return ref new VerticalBlurEffect();
+        }));
+        definition->Properties->Insert(L"BitmapEffectBands", bandCount);
+        ComPtr<IMFTransform> mft = _CreateMFT(definition);
+
+        ComPtr<IMFMediaType> type = _CreateMediaType();
+        Assert::AreEqual(S_OK, MFSetAttributeSize(type.Get(), MF_MT_FRAME_SIZE, width, height));
+        Assert::AreEqual(S_OK, mft->SetInputType(0, type.Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, type.Get(), 0));
+        return mft;
+    }
+
+    // Runs a frame with a pattern through a banded effect and returns the output pixels
+    std::vector<unsigned char> _ProcessBanded(unsigned int bandCount, unsigned int width, unsigned int height)
     {
-        auto definition = ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
+        ComPtr<IMFTransform> mft = _CreateBandedMFT(bandCount, width, height);
+
+        ComPtr<IMFSample> sample = _CreateSample(0, width, height);
+        ComPtr<IMFMediaBuffer> buffer;
+        ComPtr<IMF2DBuffer> buffer2D;
+        Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+        Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+        unsigned char *scanline0 = nullptr;
+        long pitch = 0;
+        Assert::AreEqual(S_OK, buffer2D->Lock2D(&scanline0, &pitch));
+        for (unsigned int y = 0; y < height; y++)
+        {
+            for (unsigned int x = 0; x < 4 * width; x++)
+            {
+                scanline0[y * pitch + x] = (unsigned char)(x * 7 + y * y * 13);
+            }
+        }
+        Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessInput(0, sample.Get(), 0));
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        ComPtr<IMFSample> outputSample;
+        outputSample.Attach(output.pSample);
+
+        ComPtr<IMFMediaBuffer> outputBuffer;
+        ComPtr<IMF2DBuffer> outputBuffer2D;
+        Assert::AreEqual(S_OK, outputSample->GetBufferByIndex(0, &outputBuffer));
+        Assert::AreEqual(S_OK, outputBuffer.As(&outputBuffer2D));
+        Assert::AreEqual(S_OK, outputBuffer2D->Lock2D(&scanline0, &pitch));
+        std::vector<unsigned char> pixels;
+        for (unsigned int y = 0; y < height; y++)
+        {
+            pixels.insert(pixels.end(), scanline0 + y * pitch, scanline0 + y * pitch + 4 * width);
+        }
+        Assert::AreEqual(S_OK, outputBuffer2D->Unlock2D());
+        return pixels;
+    }
+
+    LumiaEffectDefinition^ _CreateDefinition()
+    {
+        return ref new LumiaEffectDefinition(ref new FilterChainFactory([]()
         {
             auto filters = ref new Vector<IFilter^>();
             filters->Append(ref new AntiqueFilter());
             return filters;
         }));
+    }
 
+    ComPtr<IMFTransform> _CreateMFT(unsigned int inputQueueSize = 0)
+    {
+        auto definition = _CreateDefinition();
+        if (inputQueueSize != 0)
+        {
+            definition->Properties->Insert(L"InputQueueSize", inputQueueSize);
+        }
+        return _CreateMFT(definition);
+    }
+
+    ComPtr<IMFTransform> _CreateMFT(LumiaEffectDefinition^ definition)
+    {
         ComPtr<AWM::IMediaExtension> mediaExtension;
         Assert::AreEqual(S_OK, ActivateInstance(StringReference(definition->ActivatableClassId->Data()).GetHSTRING(), &mediaExtension));
 
@@ -69,6 +1256,54 @@ private:
         return mft;
     }
 
+    HRESULT _SetProperties(LumiaEffectDefinition^ definition)
+    {
+        ComPtr<AWM::IMediaExtension> mediaExtension;
+        Assert::AreEqual(S_OK, ActivateInstance(StringReference(definition->ActivatableClassId->Data()).GetHSTRING(), &mediaExtension));
+        return mediaExtension->SetProperties(reinterpret_cast<AWFC::IPropertySet*>(definition->Properties));
+    }
+
+    // Enumerates and tests types the way the topology loader does, repeatedly for each partial topology
+    void _Negotiate(_In_ const ComPtr<IMFTransform>& mft)
+    {
+        for (unsigned int attempt = 0; attempt < 4; attempt++)
+        {
+            ComPtr<IMFMediaType> type;
+            for (DWORD n = 0; mft->GetInputAvailableType(0, n, &type) == S_OK; n++)
+            {
+            }
+            Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), MFT_SET_TYPE_TEST_ONLY));
+            for (DWORD n = 0; mft->GetOutputAvailableType(0, n, &type) == S_OK; n++)
+            {
+            }
+            Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), MFT_SET_TYPE_TEST_ONLY));
+        }
+        Assert::AreEqual(S_OK, mft->SetInputType(0, _CreateMediaType().Get(), 0));
+        Assert::AreEqual(S_OK, mft->SetOutputType(0, _CreateMediaType().Get(), 0));
+    }
+
+    static MediaEventType _GetEvent(_In_ const ComPtr<IMFMediaEventGenerator>& events)
+    {
+        ComPtr<IMFMediaEvent> event;
+        MediaEventType type = MEUnknown;
+        Assert::AreEqual(S_OK, events->GetEvent(0, &event));
+        Assert::AreEqual(S_OK, event->GetType(&type));
+        return type;
+    }
+
+    static long long _GetOutputTime(_In_ const ComPtr<IMFTransform>& mft)
+    {
+        DWORD status = 0;
+        MFT_OUTPUT_DATA_BUFFER output = {};
+        Assert::AreEqual(S_OK, mft->ProcessOutput(0, 1, &output, &status));
+        ComPtr<IMFSample> outputSample;
+        outputSample.Attach(output.pSample);
+
+        long long time = 0;
+        Assert::AreEqual(S_OK, outputSample->GetSampleTime(&time));
+        return time;
+    }
+
     ComPtr<IMFMediaType> _CreateMediaType() const
     {
         ComPtr<IMFMediaType> mt;
@@ -81,5 +1316,65 @@ private:
         return mt;
     }
 
+    // RGB32 640x480 frame split in two 1D buffers, with the split in the middle of a row
+    ComPtr<IMFSample> _CreateSplitSample(long long n) const
+    {
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(n * 333333));
+        Assert::AreEqual(S_OK, sample->SetSampleDuration(333333));
+        const unsigned long lengths[] = { 640 * 4 * 100 + 10, 640 * 4 * 380 - 10 };
+        for (unsigned long length : lengths)
+        {
+            ComPtr<IMFMediaBuffer> buffer;
+            Assert::AreEqual(S_OK, MFCreateMemoryBuffer(length, &buffer));
+            Assert::AreEqual(S_OK, buffer->SetCurrentLength(length));
+            Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+        }
+        return sample;
+    }
+
+    ComPtr<IMFSample> _CreateSample(long long n, unsigned int width = 640, unsigned int height = 480, unsigned long format = MFVideoFormat_RGB32.Data1) const
+    {
+        ComPtr<IMFMediaBuffer> buffer;
+        Assert::AreEqual(S_OK, MFCreate2DMediaBuffer(width, height, format, false, &buffer));
+
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->AddBuffer(buffer.Get()));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(n * 333333));
+        Assert::AreEqual(S_OK, sample->SetSampleDuration(333333));
+        return sample;
+    }
+
+    // Sets all the bytes of an RGB32 frame to the same value
+    static void _FillSample(_In_ const ComPtr<IMFSample>& sample, unsigned char value)
+    {
+        ComPtr<IMFMediaBuffer> buffer;
+        ComPtr<IMF2DBuffer> buffer2D;
+        Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+        Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+        unsigned char *scanline0 = nullptr;
+        long pitch = 0;
+        DWORD length = 0;
+        Assert::AreEqual(S_OK, buffer2D->Lock2D(&scanline0, &pitch));
+        Assert::AreEqual(S_OK, buffer2D->GetContiguousLength(&length));
+        memset(scanline0, value, length);
+        Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+    }
 
+    // Returns the BGRA value of a pixel of an RGB32 frame
+    static unsigned int _GetPixel(_In_ const ComPtr<IMFSample>& sample, unsigned int x, unsigned int y)
+    {
+        ComPtr<IMFMediaBuffer> buffer;
+        ComPtr<IMF2DBuffer> buffer2D;
+        Assert::AreEqual(S_OK, sample->GetBufferByIndex(0, &buffer));
+        Assert::AreEqual(S_OK, buffer.As(&buffer2D));
+        unsigned char *scanline0 = nullptr;
+        long pitch = 0;
+        Assert::AreEqual(S_OK, buffer2D->Lock2D(&scanline0, &pitch));
+        unsigned int pixel = *reinterpret_cast<unsigned int*>(scanline0 + y * pitch + 4 * x);
+        Assert::AreEqual(S_OK, buffer2D->Unlock2D());
+        return pixel;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\TraceBuffer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace Microsoft::WRL;
+
+TEST_CLASS(TraceBufferTests)
+{
+public:
+
+    TEST_METHOD_INITIALIZE(Initialize)
+    {
+        TraceBuffer::SetEnabled(true);
+    }
+
+    TEST_METHOD_CLEANUP(Cleanup)
+    {
+        TraceBuffer::SetEnabled(false); // Default
+    }
+
+    TEST_METHOD(CX_W_TB_RingWrap)
+    {
+        // Write more records than the ring holds: only the most recent ones are kept, in order
+        const unsigned int count = TraceBuffer::RecordCount + 100;
+        for (unsigned int n = 0; n < count; n++)
+        {
+            TraceBuffer::Write(TraceEvent::ProcessInput, this, n, 0);
+        }
+
+        std::vector<TraceRecord> records = _CollectCurrentThread();
+        Assert::AreEqual(TraceBuffer::RecordCount, (unsigned int)records.size());
+        for (unsigned int n = 0; n < records.size(); n++)
+        {
+            Assert::AreEqual((long long)(count - TraceBuffer::RecordCount + n), records[n].Value0);
+            Assert::IsTrue(records[n].Object == this);
+        }
+    }
+
+    TEST_METHOD(CX_W_TB_Disabled)
+    {
+        TraceBuffer::Write(TraceEvent::ProcessOutput, this, 1, 0);
+
+        TraceBuffer::SetEnabled(false);
+        TraceBuffer::Write(TraceEvent::ProcessOutput, this, 2, 0);
+
+        std::vector<TraceRecord> records = _CollectCurrentThread();
+        Assert::AreEqual(1ll, records.back().Value0);
+    }
+
+    // Micro-benchmark: per-frame cost of binary sample records
+    TEST_METHOD(CX_W_TB_Benchmark)
+    {
+        ComPtr<IMFSample> sample;
+        Assert::AreEqual(S_OK, MFCreateSample(&sample));
+        Assert::AreEqual(S_OK, sample->SetSampleTime(333333));
+        Assert::AreEqual(S_OK, sample->SetSampleDuration(333333));
+
+        const unsigned int iterations = 1000000;
+        for (bool enabled : { false, true })
+        {
+            TraceBuffer::SetEnabled(enabled);
+
+            LARGE_INTEGER frequency;
+            LARGE_INTEGER start;
+            LARGE_INTEGER stop;
+            QueryPerformanceFrequency(&frequency);
+            QueryPerformanceCounter(&start);
+            for (unsigned int n = 0; n < iterations; n++)
+            {
+                TraceBuffer::WriteSample(TraceEvent::ProcessInput, this, sample.Get());
+            }
+            QueryPerformanceCounter(&stop);
+
+            double ns = 1e9 * (double)(stop.QuadPart - start.QuadPart) / frequency.QuadPart / iterations;
+
+            wchar_t message[128];
+            swprintf_s(message, L"WriteSample() %s: %.1f ns\n", enabled ? L"enabled" : L"disabled", ns);
+            Logger::WriteMessage(message);
+        }
+    }
+
+private:
+
+    static std::vector<TraceRecord> _CollectCurrentThread()
+    {
+        std::vector<TraceRecord> records;
+        for (const TraceRecord& record : TraceBuffer::Collect())
+        {
+            if (record.ThreadId == GetCurrentThreadId())
+            {
+                records.push_back(record);
+            }
+        }
+        return records;
+    }
+};
@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "..\VideoEffects\VideoEffects.Shared\VideoFormat.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(VideoFormatTests)
+{
+public:
+
+    TEST_METHOD(CX_W_VF_FrameSizes)
+    {
+        // Semi-planar 4:2:0: chroma plane at full pitch, half height
+        const VideoFormat::FormatInfo *nv12 = VideoFormat::Find(MFVideoFormat_NV12.Data1);
+        Assert::IsNotNull(nv12);
+        Assert::AreEqual(640u, VideoFormat::GetDefaultPitch(*nv12, 640));
+        Assert::AreEqual(640u * 480u * 3u / 2u, VideoFormat::GetFrameSize(*nv12, 640, 480));
+        Assert::IsTrue(VideoFormat::HasSinglePitch(*nv12));
+
+        // Planar 4:2:0: chroma planes at half pitch, odd heights rounded up
+        for (unsigned long format : { MFVideoFormat_I420.Data1, MFVideoFormat_YV12.Data1 })
+        {
+            const VideoFormat::FormatInfo *info = VideoFormat::Find(format);
+            Assert::IsNotNull(info);
+            Assert::IsFalse(VideoFormat::HasSinglePitch(*info));
+            Assert::AreEqual(3u, info->PlaneCount);
+            Assert::AreEqual(320u, VideoFormat::GetPlanePitch(*info, 1, 640));
+            Assert::AreEqual(241u, VideoFormat::GetPlaneRowCount(*info, 2, 481));
+            Assert::AreEqual(640u * 481u + 2u * 320u * 241u, VideoFormat::GetFrameSize(*info, 640, 481));
+        }
+
+        // Packed formats: DWORD-aligned YUY2, bottom-up RGB
+        const VideoFormat::FormatInfo *yuy2 = VideoFormat::Find(MFVideoFormat_YUY2.Data1);
+        Assert::IsNotNull(yuy2);
+        Assert::AreEqual(644u, VideoFormat::GetDefaultPitch(*yuy2, 321));
+        const VideoFormat::FormatInfo *rgb32 = VideoFormat::Find(MFVideoFormat_RGB32.Data1);
+        Assert::IsNotNull(rgb32);
+        Assert::IsTrue(rgb32->BottomUp);
+        Assert::AreEqual(2560u * 480u, VideoFormat::GetFrameSize(*rgb32, 2560, 480));
+
+        // Opaque and compressed formats have no layout, nor do formats no effect advertises
+        Assert::IsNull(VideoFormat::Find(MFVideoFormat_420O.Data1));
+        Assert::IsNull(VideoFormat::Find(MFVideoFormat_H264.Data1));
+        Assert::IsNull(VideoFormat::Find(MFVideoFormat_P010.Data1));
+    }
+};
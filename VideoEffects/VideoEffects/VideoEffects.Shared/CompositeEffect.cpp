@@ -0,0 +1,223 @@
+﻿#include "pch.h"
+#include "Video1in1outEffect.h"
+#include "CompositeEffect.h"
+
+using namespace Microsoft::WRL;
+using namespace Platform;
+using namespace std;
+using namespace Windows::Foundation::Collections;
+
+void CompositeEffect::Initialize(_In_ IMap<String^, Object^>^ props)
+{
+    CHKNULL(props);
+
+    auto activatableClassIds = safe_cast<IVector<String^>^>(props->Lookup(L"StageActivatableClassIds"));
+    auto stageProperties = safe_cast<IVector<IPropertySet^>^>(props->Lookup(L"StageProperties"));
+    if ((activatableClassIds->Size == 0) || (activatableClassIds->Size != stageProperties->Size))
+    {
+        throw ref new InvalidArgumentException(L"Invalid stage list");
+    }
+
+    // Create and configure the stages
+    vector<Stage> stages;
+    unsigned int processingStageCount = 0;
+    for (unsigned int n = 0; n < activatableClassIds->Size; n++)
+    {
+        ComPtr<IInspectable> inspectable;
+        CHK(RoActivateInstance(StringReference(activatableClassIds->GetAt(n)->Data()).GetHSTRING(), &inspectable));
+
+        ComPtr<ABI::Windows::Media::IMediaExtension> extension;
+        CHK(inspectable.As(&extension));
+        CHK(extension->SetProperties(reinterpret_cast<ABI::Windows::Foundation::Collections::IPropertySet*>(stageProperties->GetAt(n))));
+
+        Stage stage;
+        CHK(extension.As(&stage.Transform));
+        if (FAILED(extension.As(&stage.Effect)))
+        {
+            throw ref new InvalidArgumentException(L"Stages must be effects from this library");
+        }
+        stage.PassThrough = stage.Effect->IsPassThroughStage();
+        processingStageCount += stage.PassThrough ? 0 : 1;
+
+        Trace("Stage %u: %S%s", n, activatableClassIds->GetAt(n)->Data(), stage.PassThrough ? " (pass-through)" : "");
+        stages.push_back(stage);
+    }
+
+    _stages = move(stages);
+    _processingStageCount = processingStageCount;
+    _passthrough = (processingStageCount == 0);
+
+    _supportedFormats = GetSupportedFormats();
+    if (_supportedFormats.empty())
+    {
+        throw ref new InvalidArgumentException(L"Stages do not share a video format");
+    }
+}
+
+vector<unsigned long> CompositeEffect::GetSupportedFormats() const
+{
+    // Formats supported by all the stages, in the order of preference of the first one
+    vector<unsigned long> formats;
+    if (_stages.empty())
+    {
+        return formats; // Before initialization
+    }
+
+    vector<vector<unsigned long>> stageFormats;
+    for (auto& stage : _stages)
+    {
+        vector<unsigned long> candidates;
+        for (DWORD typeIndex = 0;; typeIndex++)
+        {
+            ComPtr<IMFMediaType> type;
+            HRESULT hr = stage.Transform->GetInputAvailableType(0, typeIndex, &type);
+            if (hr == MF_E_NO_MORE_TYPES)
+            {
+                break;
+            }
+            CHK(hr);
+
+            GUID subtype;
+            CHK(type->GetGUID(MF_MT_SUBTYPE, &subtype));
+            candidates.push_back(subtype.Data1);
+        }
+        stageFormats.push_back(candidates);
+    }
+
+    for (unsigned long format : stageFormats[0])
+    {
+        bool shared = true;
+        for (auto& candidates : stageFormats)
+        {
+            shared = shared && (find(candidates.begin(), candidates.end(), format) != candidates.end());
+        }
+        if (shared)
+        {
+            formats.push_back(format);
+        }
+    }
+
+    return formats;
+}
+
+bool CompositeEffect::IsValidInputType(_In_ const ComPtr<IMFMediaType>& type) const
+{
+    // Stages receive deinterlaced frames
+    return Video1in1outEffect::IsValidInputType(type) && _AreValidStageTypes(_GetDeinterlacedType(type));
+}
+
+bool CompositeEffect::IsValidOutputType(_In_ const ComPtr<IMFMediaType>& type) const
+{
+    return Video1in1outEffect::IsValidOutputType(type) && _AreValidStageTypes(type);
+}
+
+bool CompositeEffect::_AreValidStageTypes(_In_ const ComPtr<IMFMediaType>& type) const
+{
+    // Processing stages output the type they get as input (see StartStreaming()): stages which change
+    // the resolution or the format are rejected here rather than when streaming starts
+    for (auto& stage : _stages)
+    {
+        if (FAILED(stage.Transform->SetInputType(0, type.Get(), MFT_SET_TYPE_TEST_ONLY)))
+        {
+            return false;
+        }
+        if (!stage.PassThrough && FAILED(stage.Transform->SetOutputType(0, type.Get(), MFT_SET_TYPE_TEST_ONLY)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CompositeEffect::StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/)
+{
+    // All the stages run in the output media type of the composite effect (the input type, progressive)
+    for (auto& stage : _stages)
+    {
+        CHK(stage.Transform->SetOutputType(0, nullptr, 0));
+        CHK(stage.Transform->SetInputType(0, _outputType.Get(), 0));
+        if (!stage.PassThrough)
+        {
+            CHK(stage.Transform->SetOutputType(0, _outputType.Get(), 0));
+        }
+        CHK(stage.Effect->StartStage(_deviceManager.Get()));
+    }
+
+    // Intermediate frames between processing stages, written by one stage and read by the next
+    if (_processingStageCount >= 2)
+    {
+        ComPtr<IMFAttributes> attributes;
+        if (_deviceManager != nullptr)
+        {
+            CHK(MFCreateAttributes(&attributes, 3));
+            CHK(attributes->SetUINT32(MF_SA_BUFFERS_PER_SAMPLE, 1));
+            CHK(attributes->SetUINT32(MF_SA_D3D11_USAGE, D3D11_USAGE_DEFAULT));
+            CHK(attributes->SetUINT32(MF_SA_D3D11_BINDFLAGS, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE));
+        }
+
+        // Two samples used alternately, plus slack in case a stage holds on to its input briefly
+        unique_ptr<SampleAllocatorPool> allocator(new SampleAllocatorPool(_deviceManager));
+        CHK(allocator->Initialize(2, 4, attributes.Get(), _outputType.Get()));
+        _intermediateAllocator = move(allocator);
+    }
+}
+
+bool CompositeEffect::ProcessSample(_In_ const ComPtr<IMFSample>& inputSample, _In_ const ComPtr<IMFSample>& outputSample)
+{
+    // Each processing stage reads the frame written by the previous one, the last one writes the output sample
+    ComPtr<IMFSample> current = inputSample;
+    unsigned int remaining = _processingStageCount;
+    for (auto& stage : _stages)
+    {
+        bool producedData = false;
+        if (stage.PassThrough)
+        {
+            CHK(stage.Effect->ProcessStage(current.Get(), nullptr, &producedData));
+            continue;
+        }
+
+        ComPtr<IMFSample> target = outputSample;
+        if (--remaining != 0)
+        {
+            CHK(_intermediateAllocator->AllocateSample(&target));
+        }
+
+        CHK(stage.Effect->ProcessStage(current.Get(), target.Get(), &producedData));
+        if (!producedData)
+        {
+            return false;
+        }
+
+        current = target; // Releases the previous intermediate sample back to the pool
+    }
+
+    return true;
+}
+
+void CompositeEffect::ProcessSample(_In_ const ComPtr<IMFSample>& sample)
+{
+    // Only pass-through stages
+    for (auto& stage : _stages)
+    {
+        bool producedData;
+        CHK(stage.Effect->ProcessStage(sample.Get(), nullptr, &producedData));
+    }
+}
+
+void CompositeEffect::EndStreaming()
+{
+    HRESULT hr = S_OK;
+    for (auto& stage : _stages)
+    {
+        // Keep going on failure so all the stages get stopped
+        HRESULT hrStage = stage.Effect->EndStage();
+        hr = FAILED(hr) ? hr : hrStage;
+
+        (void)stage.Transform->SetOutputType(0, nullptr, 0);
+        (void)stage.Transform->SetInputType(0, nullptr, 0);
+    }
+
+    _intermediateAllocator = nullptr;
+
+    CHK(hr);
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+// Runs several effects of this library inside a single MFT (see CompositeEffectDefinition)
+//
+// The stages are activated and configured from their definitions, then driven through IVideoEffectStage.
+// They share the media type of the composite effect: the first format supported by all the stages.
+// Frames go through the stages using at most two intermediate samples (ping-pong), in place of the queues,
+// sample pools, and input normalization of one MFT per effect.
+//
+// The following XML snippet needs to be added to Package.appxmanifest:
+//
+//<Extensions>
+//  <Extension Category = "windows.activatableClass.inProcessServer">
+//    <InProcessServer>
+//      <Path>VideoEffects.WindowsPhone.dll</Path>
+//      <ActivatableClass ActivatableClassId = "VideoEffects.CompositeEffect" ThreadingModel = "both" />
+//    </InProcessServer>
+//  </Extension>
+//</Extensions>
+//
+
+class CompositeEffect WrlSealed : public Microsoft::WRL::RuntimeClass<Video1in1outEffect>
+{
+    InspectableClass(L"VideoEffects.CompositeEffect", TrustLevel::BaseTrust);
+
+public:
+
+    CompositeEffect()
+        : _processingStageCount(0)
+    {
+    }
+
+    HRESULT RuntimeClassInitialize()
+    {
+        return Video1in1outEffect::RuntimeClassInitialize();
+    }
+
+    virtual void Initialize(_In_ Windows::Foundation::Collections::IMap<Platform::String^, Platform::Object^>^ props) override;
+
+    // Format management
+    virtual std::vector<unsigned long> GetSupportedFormats() const override;
+    virtual bool IsValidInputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const override;
+    virtual bool IsValidOutputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const override;
+
+    // Data processing
+    virtual void StartStreaming(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height) override;
+    virtual bool ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample) override;
+    virtual void ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& sample) override;
+    virtual void EndStreaming() override;
+
+private:
+
+    struct Stage
+    {
+        Microsoft::WRL::ComPtr<IMFTransform> Transform;
+        Microsoft::WRL::ComPtr<IVideoEffectStage> Effect;
+        bool PassThrough;
+    };
+
+    bool _AreValidStageTypes(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const;
+
+    std::vector<Stage> _stages;
+    unsigned int _processingStageCount; // Stages which are not pass-through
+    std::unique_ptr<SampleAllocatorPool> _intermediateAllocator; // null with less than two processing stages
+};
+
+ActivatableClass(CompositeEffect);
\ No newline at end of file
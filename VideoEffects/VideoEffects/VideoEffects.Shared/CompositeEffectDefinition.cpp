@@ -0,0 +1,35 @@
+#include "pch.h"
+#include "CompositeEffectDefinition.h"
+
+using namespace Platform;
+using namespace Platform::Collections;
+using namespace VideoEffects;
+using namespace Windows::Foundation::Collections;
+
+#if WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP
+CompositeEffectDefinition::CompositeEffectDefinition(_In_ IIterable<Windows::Media::Effects::IVideoEffectDefinition^>^ stages)
+#else
+CompositeEffectDefinition::CompositeEffectDefinition(_In_ IIterable<VideoEffects::IVideoEffectDefinition^>^ stages)
+#endif
+    : _activatableClassId(L"VideoEffects.CompositeEffect")
+    , _properties(ref new PropertySet())
+{
+    CHKNULL(stages);
+
+    // Copy the stages so later changes to the caller's collection have no effect
+    auto activatableClassIds = ref new Vector<String^>();
+    auto properties = ref new Vector<IPropertySet^>();
+    for (auto stage : stages)
+    {
+        CHKNULL(stage);
+        activatableClassIds->Append(stage->ActivatableClassId);
+        properties->Append(stage->Properties);
+    }
+    if (activatableClassIds->Size == 0)
+    {
+        throw ref new InvalidArgumentException(L"No stage");
+    }
+
+    _properties->Insert(L"StageActivatableClassIds", activatableClassIds);
+    _properties->Insert(L"StageProperties", properties);
+}
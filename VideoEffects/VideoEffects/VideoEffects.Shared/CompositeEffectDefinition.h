@@ -0,0 +1,47 @@
+#pragma once
+
+namespace VideoEffects
+{
+    public ref class CompositeEffectDefinition sealed
+#if WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP
+        : public Windows::Media::Effects::IVideoEffectDefinition
+#else
+        : public VideoEffects::IVideoEffectDefinition
+#endif
+    {
+    public:
+
+        ///<summary>Run several effects of this library inside a single effect.</summary>
+        ///<param name='stages'>
+        /// The effects to run, in order. They must support a common video format, and run in the first format
+        /// supported by all of them. Frames go from one stage to the next without going through the
+        /// video pipeline: no per-stage queuing, sample allocation, or buffer normalization.
+        ///</param>
+#if WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP
+        CompositeEffectDefinition(_In_ Windows::Foundation::Collections::IIterable<Windows::Media::Effects::IVideoEffectDefinition^>^ stages);
+#else
+        CompositeEffectDefinition(_In_ Windows::Foundation::Collections::IIterable<VideoEffects::IVideoEffectDefinition^>^ stages);
+#endif
+
+        virtual property Platform::String^ ActivatableClassId
+        {
+            Platform::String^ get()
+            {
+                return _activatableClassId;
+            }
+        }
+
+        virtual property Windows::Foundation::Collections::IPropertySet^ Properties
+        {
+            Windows::Foundation::Collections::IPropertySet^ get()
+            {
+                return _properties;
+            }
+        }
+
+    private:
+
+        Platform::String^ _activatableClassId;
+        Windows::Foundation::Collections::IPropertySet^ _properties;
+    };
+}
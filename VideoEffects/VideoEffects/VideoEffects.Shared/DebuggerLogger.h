@@ -31,6 +31,13 @@ public:
     }
 #endif
 
+    // Default: LogLevel::Information. LogLevel::Verbose turns on the per-frame traces of all the effects, whatever their
+    // "FrameTracing" property.
+    void SetLevel(_In_ LogLevel level)
+    {
+        _level = level;
+    }
+
     template <size_t L>
     void Log(_In_ char const (&function)[L], _In_ LogLevel level, _In_ PCSTR format, ...)
     {
@@ -0,0 +1,351 @@
+#pragma once
+
+//
+// Deinterlacing kernels for 8-bit video planes
+//
+// One field of each interlaced frame is kept and the rows of the other field are rebuilt:
+//    Bob: missing rows are the average of the kept rows above and below.
+//    MotionAdaptive: missing rows are woven from the other field where the kept rows did not change since
+//        the previous frame, and averaged like Bob where they did.
+// Frames are processed out of place, at the input frame rate (one progressive frame per interlaced frame).
+//
+// As with ImageCopy, the kernel is picked at runtime: SSE2 on x86/x64, NEON on ARM, scalar code otherwise.
+//
+
+#include <stdlib.h>
+
+#include "ImageCopy.h"
+
+namespace Deinterlace
+{
+    enum class Kernel
+    {
+        Scalar,
+        Sse2,
+        Neon
+    };
+
+    enum class Mode
+    {
+        Bob,
+        MotionAdaptive
+    };
+
+    typedef void(*InterpolateRowFunction)(
+        _Out_writes_bytes_(length) unsigned char *dst,
+        _In_reads_bytes_(length) const unsigned char *above,
+        _In_reads_bytes_(length) const unsigned char *below,
+        _In_ unsigned int length
+        );
+
+    typedef void(*AdaptiveRowFunction)(
+        _Out_writes_bytes_(length) unsigned char *dst,
+        _In_reads_bytes_(length) const unsigned char *above,
+        _In_reads_bytes_(length) const unsigned char *below,
+        _In_reads_bytes_(length) const unsigned char *woven,         // Row of the other field, same position
+        _In_reads_bytes_(length) const unsigned char *previousAbove, // Rows above and below in the previous frame
+        _In_reads_bytes_(length) const unsigned char *previousBelow,
+        _In_ unsigned int length,
+        _In_ unsigned char threshold // Largest per-byte difference treated as static
+        );
+
+    namespace Details
+    {
+        inline void InterpolateRowScalar(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_ unsigned int length
+            )
+        {
+            for (unsigned int i = 0; i < length; i++)
+            {
+                dst[i] = (unsigned char)((above[i] + below[i] + 1) >> 1);
+            }
+        }
+
+        inline void AdaptiveRowScalar(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_reads_bytes_(length) const unsigned char *woven,
+            _In_reads_bytes_(length) const unsigned char *previousAbove,
+            _In_reads_bytes_(length) const unsigned char *previousBelow,
+            _In_ unsigned int length,
+            _In_ unsigned char threshold
+            )
+        {
+            for (unsigned int i = 0; i < length; i++)
+            {
+                int motionAbove = abs(above[i] - previousAbove[i]);
+                int motionBelow = abs(below[i] - previousBelow[i]);
+                dst[i] = max(motionAbove, motionBelow) > threshold ? (unsigned char)((above[i] + below[i] + 1) >> 1) : woven[i];
+            }
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+        inline void InterpolateRowSse2(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_ unsigned int length
+            )
+        {
+            unsigned int i = 0;
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_avg_epu8(a, b)); // Rounds up like the scalar code
+            }
+            InterpolateRowScalar(dst + i, above + i, below + i, length - i);
+        }
+
+        inline __m128i AbsDiffSse2(_In_ __m128i a, _In_ __m128i b)
+        {
+            return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        }
+
+        inline void AdaptiveRowSse2(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_reads_bytes_(length) const unsigned char *woven,
+            _In_reads_bytes_(length) const unsigned char *previousAbove,
+            _In_reads_bytes_(length) const unsigned char *previousBelow,
+            _In_ unsigned int length,
+            _In_ unsigned char threshold
+            )
+        {
+            const __m128i thresholds = _mm_set1_epi8((char)threshold);
+            const __m128i zero = _mm_setzero_si128();
+
+            unsigned int i = 0;
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + i));
+                __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(woven + i));
+                __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previousAbove + i));
+                __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previousBelow + i));
+
+                __m128i motion = _mm_max_epu8(AbsDiffSse2(a, pa), AbsDiffSse2(b, pb));
+                __m128i still = _mm_cmpeq_epi8(_mm_subs_epu8(motion, thresholds), zero); // motion <= threshold
+
+                __m128i result = _mm_or_si128(_mm_and_si128(still, w), _mm_andnot_si128(still, _mm_avg_epu8(a, b)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+            }
+            AdaptiveRowScalar(dst + i, above + i, below + i, woven + i, previousAbove + i, previousBelow + i, length - i, threshold);
+        }
+
+#elif defined(_M_ARM)
+
+        inline void InterpolateRowNeon(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_ unsigned int length
+            )
+        {
+            unsigned int i = 0;
+            for (; i + 16 <= length; i += 16)
+            {
+                vst1q_u8(dst + i, vrhaddq_u8(vld1q_u8(above + i), vld1q_u8(below + i)));
+            }
+            InterpolateRowScalar(dst + i, above + i, below + i, length - i);
+        }
+
+        inline void AdaptiveRowNeon(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_bytes_(length) const unsigned char *above,
+            _In_reads_bytes_(length) const unsigned char *below,
+            _In_reads_bytes_(length) const unsigned char *woven,
+            _In_reads_bytes_(length) const unsigned char *previousAbove,
+            _In_reads_bytes_(length) const unsigned char *previousBelow,
+            _In_ unsigned int length,
+            _In_ unsigned char threshold
+            )
+        {
+            const uint8x16_t thresholds = vdupq_n_u8(threshold);
+
+            unsigned int i = 0;
+            for (; i + 16 <= length; i += 16)
+            {
+                uint8x16_t a = vld1q_u8(above + i);
+                uint8x16_t b = vld1q_u8(below + i);
+                uint8x16_t motion = vmaxq_u8(vabdq_u8(a, vld1q_u8(previousAbove + i)), vabdq_u8(b, vld1q_u8(previousBelow + i)));
+                uint8x16_t moving = vcgtq_u8(motion, thresholds);
+                vst1q_u8(dst + i, vbslq_u8(moving, vrhaddq_u8(a, b), vld1q_u8(woven + i)));
+            }
+            AdaptiveRowScalar(dst + i, above + i, below + i, woven + i, previousAbove + i, previousBelow + i, length - i, threshold);
+        }
+
+#endif
+
+        // Bob and motion-adaptive row functions of one kernel
+        struct Functions
+        {
+            Kernel Id;
+            InterpolateRowFunction InterpolateRow;
+            AdaptiveRowFunction AdaptiveRow;
+        };
+
+        // Returns nullptr if the CPU does not support the kernel
+        inline const Functions* GetFunctions(_In_ Kernel kernel)
+        {
+            switch (kernel)
+            {
+#if defined(_M_IX86) || defined(_M_X64)
+            case Kernel::Sse2:
+            {
+                if (!ImageCopy::Details::IsSse2Supported())
+                {
+                    return nullptr;
+                }
+                static const Functions sse2 = { Kernel::Sse2, &InterpolateRowSse2, &AdaptiveRowSse2 };
+                return &sse2;
+            }
+#elif defined(_M_ARM)
+            case Kernel::Neon: // Windows on ARM requires NEON
+            {
+                static const Functions neon = { Kernel::Neon, &InterpolateRowNeon, &AdaptiveRowNeon };
+                return &neon;
+            }
+#endif
+            case Kernel::Scalar:
+            {
+                static const Functions scalar = { Kernel::Scalar, &InterpolateRowScalar, &AdaptiveRowScalar };
+                return &scalar;
+            }
+            default:
+                return nullptr;
+            }
+        }
+
+        // Set on first use. ProcessPlane() reads it once per plane, so all the rows of a plane use one kernel.
+        __declspec(selectany) Functions* volatile s_functions = nullptr;
+
+        inline const Functions* GetBestFunctions()
+        {
+            const Kernel kernels[] = { Kernel::Sse2, Kernel::Neon };
+            for (Kernel kernel : kernels)
+            {
+                const Functions *functions = GetFunctions(kernel);
+                if (functions != nullptr)
+                {
+                    return functions;
+                }
+            }
+            return GetFunctions(Kernel::Scalar);
+        }
+
+        inline const Functions* GetCurrentFunctions()
+        {
+            const Functions *functions = s_functions;
+            if (functions == nullptr)
+            {
+                // Compare-exchange: keep a table set concurrently by SetKernel() or by another first use
+                const Functions *best = GetBestFunctions();
+                functions = static_cast<const Functions*>(InterlockedCompareExchangePointer(
+                    reinterpret_cast<void* volatile*>(&s_functions),
+                    const_cast<Functions*>(best),
+                    nullptr
+                    ));
+                if (functions == nullptr)
+                {
+                    functions = best;
+                }
+            }
+            return functions;
+        }
+    }
+
+    // SSE2 or NEON when available, scalar otherwise
+    inline Kernel GetBestKernel()
+    {
+        return Details::GetBestFunctions()->Id;
+    }
+
+    // Forces the kernel used by ProcessPlane() (tests and benchmarks).
+    // Returns false if the CPU does not support it.
+    inline bool SetKernel(_In_ Kernel kernel)
+    {
+        const Details::Functions *functions = Details::GetFunctions(kernel);
+        if (functions == nullptr)
+        {
+            return false;
+        }
+
+        (void)InterlockedExchangePointer(reinterpret_cast<void* volatile*>(&Details::s_functions), const_cast<Details::Functions*>(functions));
+        return true;
+    }
+
+    inline Kernel GetKernel()
+    {
+        return Details::GetCurrentFunctions()->Id;
+    }
+
+    // Deinterlaces one plane of 'rowCount' rows of 'rowLength' bytes. Rows of the kept field are copied,
+    // the others rebuilt. 'previous' is the same plane in the previous output frame, which holds the rows
+    // of the kept field of the previous frame: it is required for Mode::MotionAdaptive, Bob is used without it.
+    inline void ProcessPlane(
+        _Out_ unsigned char *dst,
+        _In_ long dstStride,
+        _In_ const unsigned char *src,
+        _In_ long srcStride,
+        _In_opt_ const unsigned char *previous,
+        _In_ long previousStride,
+        _In_ unsigned int rowLength,
+        _In_ unsigned int rowCount,
+        _In_ bool keepOddRows, // Bottom field first
+        _In_ Mode mode,
+        _In_ unsigned char threshold
+        )
+    {
+        const Details::Functions *functions = Details::GetCurrentFunctions();
+
+        if (rowCount < 2)
+        {
+            ImageCopy::CopyRows(dst, dstStride, src, srcStride, rowLength, rowCount);
+            return;
+        }
+
+        bool adaptive = (mode == Mode::MotionAdaptive) && (previous != nullptr);
+        unsigned int keptParity = keepOddRows ? 1 : 0;
+        for (unsigned int row = 0; row < rowCount; row++)
+        {
+            unsigned char *dstRow = dst + (long)row * dstStride;
+            const unsigned char *srcRow = src + (long)row * srcStride;
+            if ((row & 1) == keptParity)
+            {
+                ImageCopy::CopyRow(dstRow, srcRow, rowLength);
+                continue;
+            }
+
+            // Kept rows around the missing one, mirrored at the top and bottom edges
+            unsigned int above = row > 0 ? row - 1 : row + 1;
+            unsigned int below = row + 1 < rowCount ? row + 1 : row - 1;
+            const unsigned char *srcAbove = src + (long)above * srcStride;
+            const unsigned char *srcBelow = src + (long)below * srcStride;
+
+            if (adaptive)
+            {
+                functions->AdaptiveRow(
+                    dstRow,
+                    srcAbove,
+                    srcBelow,
+                    srcRow,
+                    previous + (long)above * previousStride,
+                    previous + (long)below * previousStride,
+                    rowLength,
+                    threshold
+                    );
+            }
+            else
+            {
+                functions->InterpolateRow(dstRow, srcAbove, srcBelow, rowLength);
+            }
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+//
+// Statistics exposed by Video1in1outEffect on the attribute store returned by IMFTransform::GetAttributes()
+//
+// Values are snapshots refreshed each time GetAttributes() is called. Counters accumulate
+// over the lifetime of the effect.
+//
+// Statistics prefixed with the name of an effect are published by that effect through PublishStatistics().
+//
+
+// UINT32 - number of samples currently waiting in the input queue
+// {02E4D7D1-FBBE-494E-A961-5398C0134CF7}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_QUEUE_DEPTH = { 0x02E4D7D1, 0xFBBE, 0x494E, { 0xA9, 0x61, 0x53, 0x98, 0xC0, 0x13, 0x4C, 0xF7 } };
+
+// UINT32 - largest number of samples held in the input queue
+// {E4F7C81D-7302-4FF6-A93D-BF46CC5AE0A4}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_QUEUE_DEPTH_MAX = { 0xE4F7C81D, 0x7302, 0x4FF6, { 0xA9, 0x3D, 0xBF, 0x46, 0xCC, 0x5A, 0xE0, 0xA4 } };
+
+// UINT32 - maximum number of samples the input queue can hold (see the "InputQueueSize" property)
+// {DA0D2343-7D4A-4756-A236-769A992C0DF8}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_QUEUE_CAPACITY = { 0xDA0D2343, 0x7D4A, 0x4756, { 0xA2, 0x36, 0x76, 0x9A, 0x99, 0x2C, 0x0D, 0xF8 } };
+
+// UINT64 - number of input samples accepted by ProcessInput()
+// {4702A9B2-CAC2-4E48-95CF-10E631464497}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_SAMPLES = { 0x4702A9B2, 0xCAC2, 0x4E48, { 0x95, 0xCF, 0x10, 0xE6, 0x31, 0x46, 0x44, 0x97 } };
+
+// UINT64 - number of input samples rejected by ProcessInput() with MF_E_NOTACCEPTING
+// {0C8F9274-9DF3-4757-A60C-1509469C622B}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_SAMPLES_REJECTED = { 0x0C8F9274, 0x9DF3, 0x4757, { 0xA6, 0x0C, 0x15, 0x09, 0x46, 0x9C, 0x62, 0x2B } };
+
+// UINT64 - number of output samples returned by ProcessOutput()
+// {4E16395F-9F4F-4D20-BCDC-34BA91BEDD87}
+extern __declspec(selectany) const GUID VE_STATISTICS_OUTPUT_SAMPLES = { 0x4E16395F, 0x9F4F, 0x4D20, { 0xBC, 0xDC, 0x34, 0xBA, 0x91, 0xBE, 0xDD, 0x87 } };
+
+// UINT32 - number of frames currently owned by the effect in asynchronous mode (processing or waiting for ProcessOutput())
+// {2ECE8255-F776-44A1-A46D-BA01DFEAB3D4}
+extern __declspec(selectany) const GUID VE_STATISTICS_ASYNC_FRAMES_IN_FLIGHT = { 0x2ECE8255, 0xF776, 0x44A1, { 0xA4, 0x6D, 0xBA, 0x01, 0xDF, 0xEA, 0xB3, 0xD4 } };
+
+// UINT32 - largest number of frames owned by the effect in asynchronous mode
+// {AAC2343D-7698-483B-A627-F2141099782E}
+extern __declspec(selectany) const GUID VE_STATISTICS_ASYNC_FRAMES_IN_FLIGHT_MAX = { 0xAAC2343D, 0x7698, 0x483B, { 0xA6, 0x27, 0xF2, 0x14, 0x10, 0x99, 0x78, 0x2E } };
+
+// UINT32 - number of times a thread had to wait for the state lock (media types, attributes)
+// {019CA3B1-C928-4807-AA03-BC4E1C33FAF2}
+extern __declspec(selectany) const GUID VE_STATISTICS_STATE_LOCK_CONTENTIONS = { 0x019CA3B1, 0xC928, 0x4807, { 0xAA, 0x03, 0xBC, 0x4E, 0x1C, 0x33, 0xFA, 0xF2 } };
+
+// UINT32 - number of times a thread had to wait for the streaming lock (sample queues)
+// {B29A831C-6628-4898-9694-F80191231522}
+extern __declspec(selectany) const GUID VE_STATISTICS_STREAMING_LOCK_CONTENTIONS = { 0xB29A831C, 0x6628, 0x4898, { 0x96, 0x94, 0xF8, 0x01, 0x91, 0x23, 0x15, 0x22 } };
+
+// UINT32 - number of input samples allocated by the effect and not yet returned to its pool
+// {8007B7BA-06B7-4D98-9CF0-1BCB9B058C38}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_ALLOCATOR_IN_USE = { 0x8007B7BA, 0x06B7, 0x4D98, { 0x9C, 0xF0, 0x1B, 0xCB, 0x9B, 0x05, 0x8C, 0x38 } };
+
+// UINT32 - largest number of input samples in use at the same time
+// {A8B146AF-48B1-45D0-80F4-FD412D3E59BC}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_ALLOCATOR_IN_USE_MAX = { 0xA8B146AF, 0x48B1, 0x45D0, { 0x80, 0xF4, 0xFD, 0x41, 0x2D, 0x3E, 0x59, 0xBC } };
+
+// UINT32 - number of input samples allocated and waiting in the pool
+// {AC65554A-4474-4128-9E4D-D140D1C2EC4E}
+extern __declspec(selectany) const GUID VE_STATISTICS_INPUT_ALLOCATOR_FREE = { 0xAC65554A, 0x4474, 0x4128, { 0x9E, 0x4D, 0xD1, 0x40, 0xD1, 0xC2, 0xEC, 0x4E } };
+
+// UINT32 - number of output samples allocated by the effect and not yet returned to its pool
+// {2F1E3056-2B06-4C16-A71F-B31C1EE63051}
+extern __declspec(selectany) const GUID VE_STATISTICS_OUTPUT_ALLOCATOR_IN_USE = { 0x2F1E3056, 0x2B06, 0x4C16, { 0xA7, 0x1F, 0xB3, 0x1C, 0x1E, 0xE6, 0x30, 0x51 } };
+
+// UINT32 - largest number of output samples in use at the same time
+// {A57911B3-A225-40E8-AEBA-D48AA6B8B80C}
+extern __declspec(selectany) const GUID VE_STATISTICS_OUTPUT_ALLOCATOR_IN_USE_MAX = { 0xA57911B3, 0xA225, 0x40E8, { 0xAE, 0xBA, 0xD4, 0x8A, 0xA6, 0xB8, 0xB8, 0x0C } };
+
+// UINT32 - number of output samples allocated and waiting in the pool
+// {7BC14FE6-99A5-46FD-8677-3C8DAA297FF7}
+extern __declspec(selectany) const GUID VE_STATISTICS_OUTPUT_ALLOCATOR_FREE = { 0x7BC14FE6, 0x99A5, 0x46FD, { 0x86, 0x77, 0x3C, 0x8D, 0xAA, 0x29, 0x7F, 0xF7 } };
+
+// UINT32 - number of times the sample pools were shrunk because of memory pressure
+// {A8CA9DC2-7753-4454-AC09-C40049F8A009}
+extern __declspec(selectany) const GUID VE_STATISTICS_ALLOCATOR_TRIMS = { 0xA8CA9DC2, 0x7753, 0x4454, { 0xAC, 0x09, 0xC4, 0x00, 0x49, 0xF8, 0xA0, 0x09 } };
+
+// The VE_STATISTICS_NORMALIZE_* counters partition the input samples: each sample is counted once,
+// under the last normalization step applied to it.
+
+// UINT64 - number of input samples used as-is (single 2D buffer)
+// {E4EDB345-0DA3-42F7-80BC-55370DF26F4A}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_NONE = { 0xE4EDB345, 0x0DA3, 0x42F7, { 0x80, 0xBC, 0x55, 0x37, 0x0D, 0xF2, 0x6F, 0x4A } };
+
+// UINT64 - number of multi-buffer input samples with a buffer holding the whole frame, used without merging
+// {BC734CDB-E7D6-4579-9DB9-6D718A80E299}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_ZERO_COPY = { 0xBC734CDB, 0xE7D6, 0x4579, { 0x9D, 0xB9, 0x6D, 0x71, 0x8A, 0x80, 0xE2, 0x99 } };
+
+// UINT64 - number of multi-buffer input samples gathered into a pooled 2D buffer in a single copy
+// {1EBD29C9-212B-4A20-A9FB-CA7B271162B9}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_GATHER = { 0x1EBD29C9, 0x212B, 0x4A20, { 0xA9, 0xFB, 0xCA, 0x7B, 0x27, 0x11, 0x62, 0xB9 } };
+
+// UINT64 - number of multi-buffer input samples merged by ConvertToContiguousBuffer() (DXGI buffers)
+// {13DEA769-7D30-4683-96B5-55B46244FF40}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_CONTIGUOUS = { 0x13DEA769, 0x7D30, 0x4683, { 0x96, 0xB5, 0x55, 0xB4, 0x62, 0x44, 0xFF, 0x40 } };
+
+// UINT64 - number of 1D input buffers copied into pooled 2D buffers
+// {38AC6CAE-7781-4AA2-97A5-552FADEE1BA4}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_1D_TO_2D = { 0x38AC6CAE, 0x7781, 0x4AA2, { 0x97, 0xA5, 0x55, 0x2F, 0xAD, 0xEE, 0x1B, 0xA4 } };
+
+// UINT64 - number of input textures copied to get D3D11_BIND_SHADER_RESOURCE
+// {4D2DA0E5-9369-4313-9E61-471666585315}
+extern __declspec(selectany) const GUID VE_STATISTICS_NORMALIZE_TEXTURE_COPY = { 0x4D2DA0E5, 0x9369, 0x4313, { 0x9E, 0x61, 0x47, 0x16, 0x66, 0x58, 0x53, 0x15 } };
+
+// UINT64 - number of frames processed at full quality while QoS was enabled
+// {54E076AE-0AF9-4568-BC03-85924F6C1080}
+extern __declspec(selectany) const GUID VE_STATISTICS_QOS_FRAMES_PROCESSED = { 0x54E076AE, 0x0AF9, 0x4568, { 0xBC, 0x03, 0x85, 0x92, 0x4F, 0x6C, 0x10, 0x80 } };
+
+// UINT64 - number of late frames dropped
+// {2A5B6DF9-F2BE-48AE-98A7-89F152F979E3}
+extern __declspec(selectany) const GUID VE_STATISTICS_QOS_FRAMES_DROPPED = { 0x2A5B6DF9, 0xF2BE, 0x48AE, { 0x98, 0xA7, 0x89, 0xF1, 0x52, 0xF9, 0x79, 0xE3 } };
+
+// UINT64 - number of late frames passed through unprocessed
+// {C61C8098-55DE-46C1-9AE6-CDF727651D14}
+extern __declspec(selectany) const GUID VE_STATISTICS_QOS_FRAMES_PASSED_THROUGH = { 0xC61C8098, 0x55DE, 0x46C1, { 0x9A, 0xE6, 0xCD, 0xF7, 0x27, 0x65, 0x1D, 0x14 } };
+
+// UINT64 - number of late frames processed at reduced quality
+// {B807E54A-DC6E-4E73-BD25-9E83C78E5F8B}
+extern __declspec(selectany) const GUID VE_STATISTICS_QOS_FRAMES_REDUCED_QUALITY = { 0xB807E54A, 0xDC6E, 0x4E73, { 0xBD, 0x25, 0x9E, 0x83, 0xC7, 0x8E, 0x5F, 0x8B } };
+
+// UINT64 - maximum lateness of a frame when processing started, in 100ns units
+// {8007157B-2800-4205-9410-46F113F4DB4C}
+extern __declspec(selectany) const GUID VE_STATISTICS_QOS_LATENESS_MAX = { 0x8007157B, 0x2800, 0x4205, { 0x94, 0x10, 0x46, 0xF1, 0x13, 0xF4, 0xDB, 0x4C } };
+
+// UINT32 - number of media-type negotiation calls answered from the type cache
+// {DF41391B-2D47-422D-B08A-7FE98087B4FF}
+extern __declspec(selectany) const GUID VE_STATISTICS_TYPE_CACHE_HITS = { 0xDF41391B, 0x2D47, 0x422D, { 0xB0, 0x8A, 0x7F, 0xE9, 0x80, 0x87, 0xB4, 0xFF } };
+
+// UINT32 - number of media-type negotiation calls forwarded to the effect
+// {71D3DFDB-EA90-4403-8158-9F213C63EA0E}
+extern __declspec(selectany) const GUID VE_STATISTICS_TYPE_CACHE_MISSES = { 0x71D3DFDB, 0xEA90, 0x4403, { 0x81, 0x58, 0x9F, 0x21, 0x3C, 0x63, 0xEA, 0x0E } };
+
+// UINT64 - number of interlaced frames deinterlaced by the effect
+// {1FD93947-8178-4B28-9E14-FCC3B0A532B2}
+extern __declspec(selectany) const GUID VE_STATISTICS_DEINTERLACE_FRAMES = { 0x1FD93947, 0x8178, 0x4B28, { 0x9E, 0x14, 0xFC, 0xC3, 0xB0, 0xA5, 0x32, 0xB2 } };
+
+// UINT64 - total time spent deinterlacing, in 100ns units (divide by VE_STATISTICS_DEINTERLACE_FRAMES for the per-frame cost)
+// {1F9EE898-BF42-4FCA-A01D-430E13C4F646}
+extern __declspec(selectany) const GUID VE_STATISTICS_DEINTERLACE_TIME = { 0x1F9EE898, 0xBF42, 0x4FCA, { 0xA0, 0x1D, 0x43, 0x0E, 0x13, 0xC4, 0xF6, 0x46 } };
+
+// UINT64 - number of media-type changes handled while streaming, without restarting the effect
+// {E49C40CF-A0F8-48D0-9F12-BFC8F6DEF435}
+extern __declspec(selectany) const GUID VE_STATISTICS_FORMAT_CHANGES = { 0xE49C40CF, 0xA0F8, 0x48D0, { 0x9F, 0x12, 0xBF, 0xC8, 0xF6, 0xDE, 0xF4, 0x35 } };
+
+// UINT64 - number of sample allocators kept across media-type changes (frame format unchanged)
+// {9760EDD3-8DD6-48DD-A823-CF622DD8201F}
+extern __declspec(selectany) const GUID VE_STATISTICS_FORMAT_CHANGE_ALLOCATORS_REUSED = { 0x9760EDD3, 0x8DD6, 0x48DD, { 0xA8, 0x23, 0xCF, 0x62, 0x2D, 0xD8, 0x20, 0x1F } };
+
+// UINT64 - time from MFT_MESSAGE_NOTIFY_BEGIN_STREAMING (or the first input sample) to the first output sample, in 100ns units
+// {555F2346-65D0-4C81-B80E-F307FBC3FB5F}
+extern __declspec(selectany) const GUID VE_STATISTICS_FIRST_FRAME_LATENCY = { 0x555F2346, 0x65D0, 0x4C81, { 0xB8, 0x0E, 0xF3, 0x07, 0xFB, 0xC3, 0xFB, 0x5F } };
+
+// UINT64 - time spent starting the last streaming session (sample allocators and effect resources), in 100ns units
+// {B279D361-117C-4AEF-AA1D-E1C2D5216099}
+extern __declspec(selectany) const GUID VE_STATISTICS_STREAMING_START_TIME = { 0xB279D361, 0x117C, 0x4AEF, { 0xAA, 0x1D, 0xE1, 0xC2, 0xD5, 0x21, 0x60, 0x99 } };
+
+// UINT64 - number of streaming sessions started on the thread pool ahead of the first frame
+// {1B698CAB-D03C-4A85-B605-B353B22F3417}
+extern __declspec(selectany) const GUID VE_STATISTICS_PREWARM_COUNT = { 0x1B698CAB, 0xD03C, 0x4A85, { 0xB6, 0x05, 0xB3, 0x53, 0xB2, 0x2F, 0x34, 0x17 } };
+
+// BLOB - LatencyHistogram::Summary of the time spent normalizing input samples (buffer merging and copies), in 100ns units
+// {7936D59B-F6A0-49EA-AC23-F0C8024DD9AD}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_NORMALIZE = { 0x7936D59B, 0xF6A0, 0x49EA, { 0xAC, 0x23, 0xF0, 0xC8, 0x02, 0x4D, 0xD9, 0xAD } };
+
+// BLOB - LatencyHistogram::Summary of the time spent getting samples from the sample allocators, in 100ns units
+// {7A5C275B-F8D9-44E8-AD11-F9B86939EC43}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_ALLOCATE = { 0x7A5C275B, 0xF8D9, 0x44E8, { 0xAD, 0x11, 0xF9, 0xB8, 0x69, 0x39, 0xEC, 0x43 } };
+
+// BLOB - LatencyHistogram::Summary of the time spent in ProcessSample(), in 100ns units
+// {FCF72C3E-08B3-47E5-A660-E30C21EC3816}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_PROCESS = { 0xFCF72C3E, 0x08B3, 0x47E5, { 0xA6, 0x60, 0xE3, 0x0C, 0x21, 0xEC, 0x38, 0x16 } };
+
+// BLOB - LatencyHistogram::Summary of the time spent waiting for the state and streaming locks when contended, in 100ns units
+// {1283D18E-9E19-4712-B66A-6CB8C7D109F9}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_LOCK_WAIT = { 0x1283D18E, 0x9E19, 0x4712, { 0xB6, 0x6A, 0x6C, 0xB8, 0xC7, 0xD1, 0x09, 0xF9 } };
+
+// BLOB - LatencyHistogram::Summary of the time input samples wait in the effect before being processed, in 100ns units
+// {99F1EF47-A27F-46B7-82A5-145635E93567}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_QUEUE_WAIT = { 0x99F1EF47, 0xA27F, 0x46B7, { 0x82, 0xA5, 0x14, 0x56, 0x35, 0xE9, 0x35, 0x67 } };
+
+// UINT64 - number of frame copies made by the effect (input normalization, deinterlacing, and copies reported by the effect)
+// {34D2F249-8792-43CD-ACFC-A36BC13E8281}
+extern __declspec(selectany) const GUID VE_STATISTICS_COPIES = { 0x34D2F249, 0x8792, 0x43CD, { 0xAC, 0xFC, 0xA3, 0x6B, 0xC1, 0x3E, 0x82, 0x81 } };
+
+// UINT64 - number of bytes moved by the copies counted in VE_STATISTICS_COPIES
+// {C1E206F3-EE5E-4E99-B78D-545E749C1272}
+extern __declspec(selectany) const GUID VE_STATISTICS_COPY_BYTES = { 0xC1E206F3, 0xEE5E, 0x4E99, { 0xB7, 0x8D, 0x54, 0x5E, 0x74, 0x9C, 0x12, 0x72 } };
+
+// STRING - JSON dump of the latency histograms and copy counters: {"unit":"100ns","normalize":{...},...,"copies":N,"copyBytes":N}
+// (see LatencyHistogram::AppendJson() for the histogram objects). Updated on MFT_MESSAGE_NOTIFY_END_STREAMING
+// {9DFDD4C0-592C-4790-97CC-F8120A86C491}
+extern __declspec(selectany) const GUID VE_STATISTICS_LATENCY_JSON = { 0x9DFDD4C0, 0x592C, 0x4790, { 0x97, 0xCC, 0xF8, 0x12, 0x0A, 0x86, 0xC4, 0x91 } };
+
+// UINT64 - LumiaEffect: number of render graphs built (bitmaps, filter effect, and renderer reused across frames). One per
+// stream and concurrent ProcessSample() call, plus rebuilds when the buffer pitch or row order changes
+// {0C08431C-4239-4C62-AF9C-1CBA4930DBB4}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_RENDER_GRAPHS = { 0x0C08431C, 0x4239, 0x4C62, { 0xAF, 0x9C, 0x1C, 0xBA, 0x49, 0x30, 0xDB, 0xB4 } };
+
+// UINT64 - LumiaEffect: number of WinRT objects created to render frames (buffer wrappers, bitmaps, effects, filters, renderers)
+// {C4CA04E4-D105-46DD-8411-E5AD8F2713BB}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_RENDER_OBJECTS = { 0xC4CA04E4, 0xD105, 0x46DD, { 0x84, 0x11, 0xE5, 0xAD, 0x8F, 0x27, 0x13, 0xBB } };
+
+// UINT32 - LumiaEffect: largest number of renders in flight at once (above 1 when static filter chains run in asynchronous mode)
+// {6B310E49-DB1C-41E5-B5DA-223B1BEA72EC}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_RENDERS_IN_FLIGHT_MAX = { 0x6B310E49, 0xDB1C, 0x41E5, { 0xB5, 0xDA, 0x22, 0x3B, 0x1B, 0xEA, 0x72, 0xEC } };
+
+// UINT64 - LumiaAnalyzer: number of IBuffer wrappers created over MF buffers (see WinRTBufferPool.h)
+// {7BA59FD9-2ED8-4AA0-B65E-FB73BB6CD569}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_CREATED = { 0x7BA59FD9, 0x2ED8, 0x4AA0, { 0xB6, 0x5E, 0xFB, 0x73, 0xBB, 0x6C, 0xD5, 0x69 } };
+
+// UINT64 - LumiaAnalyzer: number of IBuffer wrappers reused from the pool instead of created
+// {E19996FE-C129-4F2F-867F-08AD4A545A93}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_REUSED = { 0xE19996FE, 0xC129, 0x4F2F, { 0x86, 0x7F, 0x08, 0xAD, 0x4A, 0x54, 0x5A, 0x93 } };
+
+// UINT32 - LumiaEffect: number of bands the frames of banded bitmap effects are split into (0 if not banded)
+// {F4DB1087-FE91-484A-8A9B-9CCACFAA8ADA}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_BITMAP_EFFECT_BANDS = { 0xF4DB1087, 0xFE91, 0x484A, { 0x8A, 0x9B, 0x9C, 0xCA, 0xCF, 0xAA, 0x8A, 0xDA } };
+
+// UINT64 - LumiaAnalyzer: number of frames passed to the analyzer
+// {8D0D147E-949F-4DA1-8FFA-25EFAA26F6C2}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_ANALYZER_FRAMES_ANALYZED = { 0x8D0D147E, 0x949F, 0x4DA1, { 0x8F, 0xFA, 0x25, 0xEF, 0xAA, 0x26, 0xF6, 0xC2 } };
+
+// UINT64 - LumiaAnalyzer: number of frames picked by the sampling policy but not analyzed (analyzer busy, frame
+// replaced by a newer one, queue full, format change, or analysis failure)
+// {273EBF75-F645-466C-A770-1D369BCD21E8}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_ANALYZER_FRAMES_DROPPED = { 0x273EBF75, 0xF645, 0x466C, { 0xA7, 0x70, 0x1D, 0x36, 0x9B, 0xCD, 0x21, 0xE8 } };
+
+// UINT64 - LumiaAnalyzer: number of frames left out by the sampling policy (interval or every Nth frame)
+// {63CE13CF-F312-4825-A758-ED38E77CA310}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_ANALYZER_FRAMES_SKIPPED = { 0x63CE13CF, 0xF312, 0x4825, { 0xA7, 0x58, 0xED, 0x38, 0xE7, 0x7C, 0xA3, 0x10 } };
+
+// BLOB - LumiaAnalyzer: LatencyHistogram::Summary of the time between frames arriving and their analysis starting, in 100ns units
+// {9F8A6DC9-DCD5-4B9D-AECB-5F7B559A7BA0}
+extern __declspec(selectany) const GUID VE_STATISTICS_LUMIA_ANALYZER_LAG = { 0x9F8A6DC9, 0xDCD5, 0x4B9D, { 0xAE, 0xCB, 0x5F, 0x7B, 0x55, 0x9A, 0x7B, 0xA0 } };
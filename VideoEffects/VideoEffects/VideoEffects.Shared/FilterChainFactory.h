@@ -64,6 +64,33 @@ namespace VideoEffects
         void Process(Lumia::Imaging::Bitmap^ input, Lumia::Imaging::Bitmap^ output, Windows::Foundation::TimeSpan time);
     };
 
+    //<summary>A bitmap video effect which can process horizontal bands of a frame in parallel</summary>
+    ///<remarks>
+    /// Returned by BitmapVideoEffectFactory like other bitmap effects. When the input and output resolutions
+    /// match, LumiaEffect splits each frame into bands processed concurrently on the thread pool, and only
+    /// calls Process() otherwise.
+    ///</remarks>
+    public interface class IBandedBitmapVideoEffect : IBitmapVideoEffect
+    {
+        ///<summary>Number of input rows above and below a band the effect reads to produce it (0 for per-pixel effects).</summary>
+        property unsigned int HaloRows
+        {
+            unsigned int get();
+        }
+
+        ///<summary>Process one band of a video frame.</summary>
+        ///<param name='input'>Input bitmap holding the band and the halo rows around it, clamped to the frame.</param>
+        ///<param name='output'>Output bitmap holding the band.</param>
+        ///<param name='row'>Frame row of the first row of the band.</param>
+        ///<param name='inputRowOffset'>Row of the input bitmap matching the first row of the output bitmap.</param>
+        ///<param name='time'>Timestamp of the frame, see IBitmapVideoEffect::Process().</param>
+        ///<remarks>
+        /// The bands of a frame are processed concurrently: the method must not modify state shared across
+        /// bands. The bitmaps are closed when the method returns, same as Process().
+        ///</remarks>
+        void ProcessBand(Lumia::Imaging::Bitmap^ input, Lumia::Imaging::Bitmap^ output, unsigned int row, unsigned int inputRowOffset, Windows::Foundation::TimeSpan time);
+    };
+
     //<summary>Bitmap video effect factory</summary>
     public delegate IBitmapVideoEffect^ BitmapVideoEffectFactory();
 
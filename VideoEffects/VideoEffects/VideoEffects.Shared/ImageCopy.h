@@ -0,0 +1,263 @@
+#pragma once
+
+//
+// Row-copy kernels for packed video frames
+//
+// The kernel is picked at runtime from what the CPU supports: AVX then SSE2 on x86/x64, NEON on ARM,
+// plain memcpy() otherwise. CopyRows() takes signed strides, so a negative source stride flips
+// bottom-up frames (RGB in system memory) while copying. Deinterlace.h and ImageScale.h reuse its CPU checks.
+//
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(_M_ARM)
+#include <arm_neon.h>
+#endif
+
+namespace ImageCopy
+{
+    enum class Kernel
+    {
+        Memcpy,
+        Sse2,
+        Avx,
+        Neon
+    };
+
+    typedef void(*RowCopyFunction)(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length);
+
+    namespace Details
+    {
+        inline void CopyRowMemcpy(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length)
+        {
+            memcpy(dst, src, length);
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+        inline void CopyRowSse2(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length)
+        {
+            unsigned int i = 0;
+            for (; i + 64 <= length; i += 64)
+            {
+                __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+                __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+                __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), v1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), v2);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 48), v3);
+            }
+            for (; i + 16 <= length; i += 16)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+            }
+            memcpy(dst + i, src + i, length - i);
+        }
+
+        inline void CopyRowAvx(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length)
+        {
+            unsigned int i = 0;
+            for (; i + 128 <= length; i += 128)
+            {
+                __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+                __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 64));
+                __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 96));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v0);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), v1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), v2);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 96), v3);
+            }
+            for (; i + 32 <= length; i += 32)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+            }
+            _mm256_zeroupper(); // Avoid AVX-SSE transition penalties in the caller
+            memcpy(dst + i, src + i, length - i);
+        }
+
+        inline bool IsSse2Supported()
+        {
+#if defined(_M_X64)
+            return true;
+#else
+            return !!IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+        }
+
+        inline bool IsAvxSupported()
+        {
+            // CPU support (CPUID.1:ECX.AVX) and OS support for saving YMM registers (OSXSAVE, XCR0 bits 1-2)
+            int info[4];
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            return osxsave && avx && ((_xgetbv(0) & 6) == 6);
+        }
+
+#elif defined(_M_ARM)
+
+        inline void CopyRowNeon(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length)
+        {
+            unsigned int i = 0;
+            for (; i + 64 <= length; i += 64)
+            {
+                uint8x16_t v0 = vld1q_u8(src + i);
+                uint8x16_t v1 = vld1q_u8(src + i + 16);
+                uint8x16_t v2 = vld1q_u8(src + i + 32);
+                uint8x16_t v3 = vld1q_u8(src + i + 48);
+                vst1q_u8(dst + i, v0);
+                vst1q_u8(dst + i + 16, v1);
+                vst1q_u8(dst + i + 32, v2);
+                vst1q_u8(dst + i + 48, v3);
+            }
+            for (; i + 16 <= length; i += 16)
+            {
+                vst1q_u8(dst + i, vld1q_u8(src + i));
+            }
+            memcpy(dst + i, src + i, length - i);
+        }
+
+#endif
+
+        // Kernel id and copy routine, in one static table per kernel
+        struct Functions
+        {
+            Kernel Id;
+            RowCopyFunction CopyRow;
+        };
+
+        // Returns nullptr if the CPU does not support the kernel
+        inline const Functions* GetFunctions(_In_ Kernel kernel)
+        {
+            switch (kernel)
+            {
+#if defined(_M_IX86) || defined(_M_X64)
+            case Kernel::Sse2:
+            {
+                if (!IsSse2Supported())
+                {
+                    return nullptr;
+                }
+                static const Functions sse2 = { Kernel::Sse2, &CopyRowSse2 };
+                return &sse2;
+            }
+            case Kernel::Avx:
+            {
+                if (!IsAvxSupported())
+                {
+                    return nullptr;
+                }
+                static const Functions avx = { Kernel::Avx, &CopyRowAvx };
+                return &avx;
+            }
+#elif defined(_M_ARM)
+            case Kernel::Neon: // Windows on ARM requires NEON
+            {
+                static const Functions neon = { Kernel::Neon, &CopyRowNeon };
+                return &neon;
+            }
+#endif
+            case Kernel::Memcpy:
+            {
+                static const Functions memcpyFunctions = { Kernel::Memcpy, &CopyRowMemcpy };
+                return &memcpyFunctions;
+            }
+            default:
+                return nullptr;
+            }
+        }
+
+        // Selected on first use. GetKernel() and CopyRow() read the kernel id and its function from the
+        // same table, so they always agree.
+        __declspec(selectany) Functions* volatile s_functions = nullptr;
+
+        // AVX first: wider loads and stores than SSE2 on the same CPUs
+        inline const Functions* GetBestFunctions()
+        {
+            const Kernel kernels[] = { Kernel::Avx, Kernel::Sse2, Kernel::Neon };
+            for (Kernel kernel : kernels)
+            {
+                const Functions *functions = GetFunctions(kernel);
+                if (functions != nullptr)
+                {
+                    return functions;
+                }
+            }
+            return GetFunctions(Kernel::Memcpy);
+        }
+
+        inline const Functions* GetCurrentFunctions()
+        {
+            const Functions *functions = s_functions;
+            if (functions == nullptr)
+            {
+                // Only the first caller publishes: a kernel forced by SetKernel() in between is kept
+                const Functions *best = GetBestFunctions();
+                functions = static_cast<const Functions*>(InterlockedCompareExchangePointer(
+                    reinterpret_cast<void* volatile*>(&s_functions),
+                    const_cast<Functions*>(best),
+                    nullptr
+                    ));
+                if (functions == nullptr)
+                {
+                    functions = best;
+                }
+            }
+            return functions;
+        }
+    }
+
+    inline Kernel GetBestKernel()
+    {
+        return Details::GetBestFunctions()->Id;
+    }
+
+    // Forces the kernel used by CopyRow()/CopyRows() (tests and benchmarks).
+    // Returns false if the CPU does not support it.
+    inline bool SetKernel(_In_ Kernel kernel)
+    {
+        const Details::Functions *functions = Details::GetFunctions(kernel);
+        if (functions == nullptr)
+        {
+            return false;
+        }
+
+        (void)InterlockedExchangePointer(reinterpret_cast<void* volatile*>(&Details::s_functions), const_cast<Details::Functions*>(functions));
+        return true;
+    }
+
+    inline Kernel GetKernel()
+    {
+        return Details::GetCurrentFunctions()->Id;
+    }
+
+    inline void CopyRow(_Out_writes_bytes_(length) unsigned char *dst, _In_reads_bytes_(length) const unsigned char *src, _In_ unsigned int length)
+    {
+        Details::GetCurrentFunctions()->CopyRow(dst, src, length);
+    }
+
+    // Copies 'rowCount' rows of 'rowLength' bytes. Strides are in bytes and can be negative.
+    inline void CopyRows(
+        _In_ unsigned char *dst,
+        _In_ long dstStride,
+        _In_ const unsigned char *src,
+        _In_ long srcStride,
+        _In_ unsigned int rowLength,
+        _In_ unsigned int rowCount
+        )
+    {
+        RowCopyFunction copyRow = Details::GetCurrentFunctions()->CopyRow;
+        for (unsigned int row = 0; row < rowCount; row++)
+        {
+            copyRow(dst, src, rowLength);
+            dst += dstStride;
+            src += srcStride;
+        }
+    }
+}
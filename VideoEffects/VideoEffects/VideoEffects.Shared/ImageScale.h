@@ -0,0 +1,741 @@
+#pragma once
+
+//
+// Polyphase scaler for 8-bit video planes
+//
+// Planes are resized in two separable passes: each source row is resampled horizontally into a ring of
+// intermediate rows, which are then combined vertically into the destination rows. Filter taps are computed
+// once per output column and row (one phase per output position), stretched over the source pixels when
+// downscaling so the filters also act as anti-aliasing low-pass filters, and stored as 2.14 fixed-point values.
+// Interleaved channels are supported (1 for luma, 2 for NV12 chroma, 4 for RGB32).
+//
+// The area filter averages the source pixels covered by each destination pixel (box decimation when
+// downscaling). Luma planes decimated by 2 or 4 horizontally take a dedicated box kernel.
+//
+// As with ImageCopy, the kernel is picked at runtime: SSE2 on x86/x64, NEON on ARM, scalar code otherwise.
+// All kernels produce the same output. The horizontal pass is only vectorized for 4-channel planes and box decimation.
+//
+
+#include <math.h>
+#include <vector>
+
+#include "ImageCopy.h"
+
+namespace ImageScale
+{
+    enum class Kernel
+    {
+        Scalar,
+        Sse2,
+        Neon
+    };
+
+    enum class Filter
+    {
+        Bilinear,
+        Bicubic, // Catmull-Rom
+        Lanczos3,
+        Area
+    };
+
+    static const unsigned int CoefficientBits = 14;
+
+    typedef void(*HorizontalRowFunction)(
+        _Out_ unsigned char *dst,
+        _In_ const unsigned char *src,
+        _In_ unsigned int dstWidth,
+        _In_reads_(dstWidth) const int *starts,
+        _In_reads_(dstWidth * taps) const short *coefficients,
+        _In_ unsigned int taps
+        );
+
+    typedef void(*VerticalRowFunction)(
+        _Out_writes_bytes_(length) unsigned char *dst,
+        _In_reads_(taps) const unsigned char *const *rows,
+        _In_reads_(taps) const short *coefficients,
+        _In_ unsigned int taps,
+        _In_ unsigned int length
+        );
+
+    // Averages groups of 'factor' pixels of a 1-channel row, 'factor' being 2 or 4
+    typedef void(*HorizontalBoxFunction)(
+        _Out_writes_bytes_(dstWidth) unsigned char *dst,
+        _In_ const unsigned char *src,
+        _In_ unsigned int dstWidth,
+        _In_ unsigned int factor
+        );
+
+    namespace Details
+    {
+        inline unsigned char Round(_In_ int sum)
+        {
+            int value = (sum + (1 << (CoefficientBits - 1))) >> CoefficientBits;
+            return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+
+        template <unsigned int Channels>
+        inline void HorizontalRowScalar(
+            _Out_ unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_reads_(dstWidth) const int *starts,
+            _In_reads_(dstWidth * taps) const short *coefficients,
+            _In_ unsigned int taps
+            )
+        {
+            for (unsigned int x = 0; x < dstWidth; x++)
+            {
+                const unsigned char *pixel = src + starts[x] * Channels;
+                const short *c = coefficients + x * taps;
+                for (unsigned int channel = 0; channel < Channels; channel++)
+                {
+                    int sum = 0;
+                    for (unsigned int k = 0; k < taps; k++)
+                    {
+                        sum += c[k] * pixel[k * Channels + channel];
+                    }
+                    dst[x * Channels + channel] = Round(sum);
+                }
+            }
+        }
+
+        inline void VerticalRowScalar(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_(taps) const unsigned char *const *rows,
+            _In_reads_(taps) const short *coefficients,
+            _In_ unsigned int taps,
+            _In_ unsigned int length
+            )
+        {
+            for (unsigned int i = 0; i < length; i++)
+            {
+                int sum = 0;
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    sum += coefficients[k] * rows[k][i];
+                }
+                dst[i] = Round(sum);
+            }
+        }
+
+        // Same rounding as the area taps (1/factor each) in 2.14 fixed point
+        inline void HorizontalBoxScalar(
+            _Out_writes_bytes_(dstWidth) unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_ unsigned int factor
+            )
+        {
+            for (unsigned int x = 0; x < dstWidth; x++)
+            {
+                const unsigned char *pixel = src + x * factor;
+                unsigned int sum = 0;
+                for (unsigned int k = 0; k < factor; k++)
+                {
+                    sum += pixel[k];
+                }
+                dst[x] = (unsigned char)((sum + factor / 2) / factor);
+            }
+        }
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+        inline __m128i RoundSse2(_In_ __m128i sum)
+        {
+            return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << (CoefficientBits - 1))), CoefficientBits);
+        }
+
+        // Taps are processed in pairs: pixels of two taps are interleaved so _mm_madd_epi16() applies both coefficients
+        inline void HorizontalRow4Sse2(
+            _Out_ unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_reads_(dstWidth) const int *starts,
+            _In_reads_(dstWidth * taps) const short *coefficients,
+            _In_ unsigned int taps
+            )
+        {
+            const __m128i zero = _mm_setzero_si128();
+            for (unsigned int x = 0; x < dstWidth; x++)
+            {
+                const unsigned char *pixel = src + starts[x] * 4;
+                const short *c = coefficients + x * taps;
+                __m128i sum = zero;
+
+                unsigned int k = 0;
+                for (; k + 2 <= taps; k += 2)
+                {
+                    __m128i p0 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixel + k * 4));
+                    __m128i p1 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixel + k * 4 + 4));
+                    __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(p0, p1), zero); // B0 B1 G0 G1 R0 R1 A0 A1
+                    __m128i cc = _mm_set1_epi32((int)(((unsigned int)(unsigned short)c[k + 1] << 16) | (unsigned short)c[k]));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(p, cc));
+                }
+                if (k < taps)
+                {
+                    __m128i p = _mm_unpacklo_epi8(_mm_unpacklo_epi8(_mm_cvtsi32_si128(*reinterpret_cast<const int*>(pixel + k * 4)), zero), zero);
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(p, _mm_set1_epi32((unsigned short)c[k])));
+                }
+
+                __m128i result = _mm_packs_epi32(RoundSse2(sum), zero);
+                *reinterpret_cast<int*>(dst + x * 4) = _mm_cvtsi128_si32(_mm_packus_epi16(result, zero));
+            }
+        }
+
+        inline void VerticalRowSse2(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_(taps) const unsigned char *const *rows,
+            _In_reads_(taps) const short *coefficients,
+            _In_ unsigned int taps,
+            _In_ unsigned int length
+            )
+        {
+            const __m128i zero = _mm_setzero_si128();
+
+            unsigned int i = 0;
+            for (; i + 16 <= length; i += 16)
+            {
+                __m128i sum0 = zero;
+                __m128i sum1 = zero;
+                __m128i sum2 = zero;
+                __m128i sum3 = zero;
+                for (unsigned int k = 0; k < taps; k += 2)
+                {
+                    // Odd tap counts pair the last row with zeros
+                    bool pair = k + 1 < taps;
+                    __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+                    __m128i r1 = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i)) : zero;
+                    unsigned short c1 = pair ? (unsigned short)coefficients[k + 1] : 0;
+                    __m128i cc = _mm_set1_epi32((int)(((unsigned int)c1 << 16) | (unsigned short)coefficients[k]));
+
+                    __m128i lo = _mm_unpacklo_epi8(r0, r1);
+                    __m128i hi = _mm_unpackhi_epi8(r0, r1);
+                    sum0 = _mm_add_epi32(sum0, _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), cc));
+                    sum1 = _mm_add_epi32(sum1, _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), cc));
+                    sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), cc));
+                    sum3 = _mm_add_epi32(sum3, _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), cc));
+                }
+
+                __m128i result0 = _mm_packs_epi32(RoundSse2(sum0), RoundSse2(sum1));
+                __m128i result1 = _mm_packs_epi32(RoundSse2(sum2), RoundSse2(sum3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(result0, result1));
+            }
+
+            const unsigned char *tailRows[64];
+            if (i < length)
+            {
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    tailRows[k] = rows[k] + i;
+                }
+                VerticalRowScalar(dst + i, tailRows, coefficients, taps, length - i);
+            }
+        }
+
+        // Pairs of bytes are summed as 16-bit lanes (low byte + high byte), pairs of pairs by _mm_madd_epi16()
+        inline void HorizontalBoxSse2(
+            _Out_writes_bytes_(dstWidth) unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_ unsigned int factor
+            )
+        {
+            const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+            unsigned int x = 0;
+            if (factor == 2)
+            {
+                const __m128i one = _mm_set1_epi16(1);
+                for (; x + 16 <= dstWidth; x += 16)
+                {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x + 16));
+                    __m128i sumA = _mm_add_epi16(_mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8));
+                    __m128i sumB = _mm_add_epi16(_mm_and_si128(b, lowBytes), _mm_srli_epi16(b, 8));
+                    sumA = _mm_srli_epi16(_mm_add_epi16(sumA, one), 1);
+                    sumB = _mm_srli_epi16(_mm_add_epi16(sumB, one), 1);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(sumA, sumB));
+                }
+            }
+            else
+            {
+                const __m128i ones = _mm_set1_epi16(1);
+                const __m128i two = _mm_set1_epi32(2);
+                for (; x + 16 <= dstWidth; x += 16)
+                {
+                    __m128i sums[4];
+                    for (unsigned int n = 0; n < 4; n++)
+                    {
+                        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * x + 16 * n));
+                        __m128i pairs = _mm_add_epi16(_mm_and_si128(v, lowBytes), _mm_srli_epi16(v, 8));
+                        sums[n] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, ones), two), 2);
+                    }
+                    __m128i result0 = _mm_packs_epi32(sums[0], sums[1]);
+                    __m128i result1 = _mm_packs_epi32(sums[2], sums[3]);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(result0, result1));
+                }
+            }
+
+            if (x < dstWidth)
+            {
+                HorizontalBoxScalar(dst + x, src + x * factor, dstWidth - x, factor);
+            }
+        }
+
+#elif defined(_M_ARM)
+
+        inline void HorizontalRow4Neon(
+            _Out_ unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_reads_(dstWidth) const int *starts,
+            _In_reads_(dstWidth * taps) const short *coefficients,
+            _In_ unsigned int taps
+            )
+        {
+            for (unsigned int x = 0; x < dstWidth; x++)
+            {
+                const unsigned char *pixel = src + starts[x] * 4;
+                const short *c = coefficients + x * taps;
+                int32x4_t sum = vdupq_n_s32(0);
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    // Loads exactly one pixel: no read past the end of the row
+                    uint8x8_t p = vreinterpret_u8_u32(vld1_dup_u32(reinterpret_cast<const uint32_t*>(pixel + k * 4)));
+                    sum = vmlal_n_s16(sum, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(p))), c[k]);
+                }
+
+                int16x4_t result = vqrshrn_n_s32(sum, CoefficientBits);
+                uint8x8_t bytes = vqmovun_s16(vcombine_s16(result, result));
+                vst1_lane_u32(reinterpret_cast<uint32_t*>(dst + x * 4), vreinterpret_u32_u8(bytes), 0);
+            }
+        }
+
+        inline void VerticalRowNeon(
+            _Out_writes_bytes_(length) unsigned char *dst,
+            _In_reads_(taps) const unsigned char *const *rows,
+            _In_reads_(taps) const short *coefficients,
+            _In_ unsigned int taps,
+            _In_ unsigned int length
+            )
+        {
+            unsigned int i = 0;
+            for (; i + 8 <= length; i += 8)
+            {
+                int32x4_t sum0 = vdupq_n_s32(0);
+                int32x4_t sum1 = vdupq_n_s32(0);
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(rows[k] + i)));
+                    sum0 = vmlal_n_s16(sum0, vget_low_s16(r), coefficients[k]);
+                    sum1 = vmlal_n_s16(sum1, vget_high_s16(r), coefficients[k]);
+                }
+                vst1_u8(dst + i, vqmovun_s16(vcombine_s16(vqrshrn_n_s32(sum0, CoefficientBits), vqrshrn_n_s32(sum1, CoefficientBits))));
+            }
+
+            const unsigned char *tailRows[64];
+            if (i < length)
+            {
+                for (unsigned int k = 0; k < taps; k++)
+                {
+                    tailRows[k] = rows[k] + i;
+                }
+                VerticalRowScalar(dst + i, tailRows, coefficients, taps, length - i);
+            }
+        }
+
+        // Pairwise widening adds, then rounding narrowing shifts
+        inline void HorizontalBoxNeon(
+            _Out_writes_bytes_(dstWidth) unsigned char *dst,
+            _In_ const unsigned char *src,
+            _In_ unsigned int dstWidth,
+            _In_ unsigned int factor
+            )
+        {
+            unsigned int x = 0;
+            if (factor == 2)
+            {
+                for (; x + 8 <= dstWidth; x += 8)
+                {
+                    vst1_u8(dst + x, vrshrn_n_u16(vpaddlq_u8(vld1q_u8(src + 2 * x)), 1));
+                }
+            }
+            else
+            {
+                for (; x + 8 <= dstWidth; x += 8)
+                {
+                    uint16x4_t sum0 = vrshrn_n_u32(vpaddlq_u16(vpaddlq_u8(vld1q_u8(src + 4 * x))), 2);
+                    uint16x4_t sum1 = vrshrn_n_u32(vpaddlq_u16(vpaddlq_u8(vld1q_u8(src + 4 * x + 16))), 2);
+                    vst1_u8(dst + x, vmovn_u16(vcombine_u16(sum0, sum1)));
+                }
+            }
+
+            if (x < dstWidth)
+            {
+                HorizontalBoxScalar(dst + x, src + x * factor, dstWidth - x, factor);
+            }
+        }
+
+#endif
+
+        // Passes with vectorized versions, as implemented by one kernel
+        struct Functions
+        {
+            Kernel Id;
+            HorizontalRowFunction HorizontalRow4;
+            VerticalRowFunction VerticalRow;
+            HorizontalBoxFunction HorizontalBox;
+        };
+
+        // Returns nullptr if the CPU does not support the kernel
+        inline const Functions* GetFunctions(_In_ Kernel kernel)
+        {
+            switch (kernel)
+            {
+#if defined(_M_IX86) || defined(_M_X64)
+            case Kernel::Sse2:
+            {
+                if (!ImageCopy::Details::IsSse2Supported())
+                {
+                    return nullptr;
+                }
+                static const Functions sse2 = { Kernel::Sse2, &HorizontalRow4Sse2, &VerticalRowSse2, &HorizontalBoxSse2 };
+                return &sse2;
+            }
+#elif defined(_M_ARM)
+            case Kernel::Neon: // Windows on ARM requires NEON
+            {
+                static const Functions neon = { Kernel::Neon, &HorizontalRow4Neon, &VerticalRowNeon, &HorizontalBoxNeon };
+                return &neon;
+            }
+#endif
+            case Kernel::Scalar:
+            {
+                static const Functions scalar = { Kernel::Scalar, &HorizontalRowScalar<4>, &VerticalRowScalar, &HorizontalBoxScalar };
+                return &scalar;
+            }
+            default:
+                return nullptr;
+            }
+        }
+
+        // Set on first use. Scaler::Scale() loads it once per call, so the passes of a plane never mix kernels.
+        __declspec(selectany) Functions* volatile s_functions = nullptr;
+
+        inline const Functions* GetBestFunctions()
+        {
+            const Kernel kernels[] = { Kernel::Sse2, Kernel::Neon };
+            for (Kernel kernel : kernels)
+            {
+                const Functions *functions = GetFunctions(kernel);
+                if (functions != nullptr)
+                {
+                    return functions;
+                }
+            }
+            return GetFunctions(Kernel::Scalar);
+        }
+
+        inline const Functions* GetCurrentFunctions()
+        {
+            const Functions *functions = s_functions;
+            if (functions == nullptr)
+            {
+                // Lost races return the table already published
+                const Functions *best = GetBestFunctions();
+                functions = static_cast<const Functions*>(InterlockedCompareExchangePointer(
+                    reinterpret_cast<void* volatile*>(&s_functions),
+                    const_cast<Functions*>(best),
+                    nullptr
+                    ));
+                if (functions == nullptr)
+                {
+                    functions = best;
+                }
+            }
+            return functions;
+        }
+
+        inline double Sinc(_In_ double x)
+        {
+            const double pi = 3.14159265358979323846;
+            return x == 0. ? 1. : sin(pi * x) / (pi * x);
+        }
+
+        // Filter support radius, in source pixels at scale 1
+        inline double GetRadius(_In_ Filter filter)
+        {
+            switch (filter)
+            {
+            case Filter::Bilinear: return 1.;
+            case Filter::Bicubic: return 2.;
+            case Filter::Area: return .5;
+            default: return 3.;
+            }
+        }
+
+        inline double Evaluate(_In_ Filter filter, _In_ double x)
+        {
+            x = fabs(x);
+            switch (filter)
+            {
+            case Filter::Bilinear:
+                return x < 1. ? 1. - x : 0.;
+
+            case Filter::Bicubic: // Keys cubic, a = -0.5
+                if (x < 1.)
+                {
+                    return (1.5 * x - 2.5) * x * x + 1.;
+                }
+                return x < 2. ? ((-0.5 * x + 2.5) * x - 4.) * x + 2. : 0.;
+
+            default:
+                return x < 3. ? Sinc(x) * Sinc(x / 3.) : 0.;
+            }
+        }
+
+        // Area filter: part of the source pixel at 'offset' from the center of the destination pixel covered
+        // by the destination pixel, 'width' source pixels wide
+        inline double GetCoverage(_In_ double offset, _In_ double width)
+        {
+            double left = offset - .5 > -width / 2 ? offset - .5 : -width / 2;
+            double right = offset + .5 < width / 2 ? offset + .5 : width / 2;
+            return right > left ? right - left : 0.;
+        }
+
+        // Computes the taps of each destination position along one axis. Windows are kept inside the source
+        // and taps falling outside of it are added to the edge pixels (edge replication).
+        inline void ComputeCoefficients(
+            _In_ unsigned int srcSize,
+            _In_ unsigned int dstSize,
+            _In_ Filter filter,
+            _Out_ unsigned int *taps,
+            _Out_ std::vector<int> *starts,
+            _Out_ std::vector<short> *coefficients
+            )
+        {
+            double scale = (double)srcSize / dstSize;
+            double stretch = scale > 1. ? scale : 1.; // Downscaling widens the filter
+            double radius = GetRadius(filter) * stretch;
+
+            unsigned int count = 2 * (unsigned int)ceil(radius);
+            bool area = (filter == Filter::Area);
+            if (area)
+            {
+                // Whole pixels for integer ratios, plus one for the pixels partially covered at both ends otherwise
+                count = (unsigned int)ceil(stretch) + (scale == floor(scale) ? 0 : 1);
+            }
+            count = count < srcSize ? count : srcSize;
+            count = count < 64 ? count : 64; // Bounded for the vertical kernels, only reached when downscaling over 10x
+            *taps = count;
+
+            starts->resize(dstSize);
+            coefficients->assign(dstSize * count, 0);
+            std::vector<double> weights(count);
+            for (unsigned int i = 0; i < dstSize; i++)
+            {
+                double center = (i + .5) * scale - .5;
+                int first = area ? (int)floor(center - stretch / 2 + .5) : (int)floor(center) - (int)count / 2 + 1;
+                int start = first < 0 ? 0 : (first > (int)(srcSize - count) ? (int)(srcSize - count) : first);
+
+                double total = 0.;
+                for (unsigned int k = 0; k < count; k++)
+                {
+                    weights[k] = 0.;
+                }
+                for (unsigned int k = 0; k < count; k++)
+                {
+                    int position = first + (int)k;
+                    double weight = area ? GetCoverage(position - center, stretch) : Evaluate(filter, (position - center) / stretch);
+                    position = position < 0 ? 0 : (position >= (int)srcSize ? (int)srcSize - 1 : position);
+                    weights[position - start] += weight;
+                    total += weight;
+                }
+                if (total == 0.) // Nearest pixel if the window missed the filter lobes
+                {
+                    int nearest = (int)floor(center + .5);
+                    nearest = nearest < start ? start : (nearest >= start + (int)count ? start + (int)count - 1 : nearest);
+                    weights[nearest - start] = 1.;
+                    total = 1.;
+                }
+
+                // Normalized fixed-point taps, the rounding error going to the largest one
+                short *c = &(*coefficients)[i * count];
+                int sum = 0;
+                unsigned int largest = 0;
+                for (unsigned int k = 0; k < count; k++)
+                {
+                    c[k] = (short)floor(weights[k] / total * (1 << CoefficientBits) + .5);
+                    sum += c[k];
+                    largest = c[k] > c[largest] ? k : largest;
+                }
+                c[largest] = (short)(c[largest] + (1 << CoefficientBits) - sum);
+                (*starts)[i] = start;
+            }
+        }
+    }
+
+    // Kernel Scaler::Scale() uses unless SetKernel() was called
+    inline Kernel GetBestKernel()
+    {
+        return Details::GetBestFunctions()->Id;
+    }
+
+    // Forces the kernel used by Scaler::Scale() (tests and benchmarks).
+    // Returns false if the CPU does not support it.
+    inline bool SetKernel(_In_ Kernel kernel)
+    {
+        const Details::Functions *functions = Details::GetFunctions(kernel);
+        if (functions == nullptr)
+        {
+            return false;
+        }
+
+        (void)InterlockedExchangePointer(reinterpret_cast<void* volatile*>(&Details::s_functions), const_cast<Details::Functions*>(functions));
+        return true;
+    }
+
+    inline Kernel GetKernel()
+    {
+        return Details::GetCurrentFunctions()->Id;
+    }
+
+    //
+    // Scales planes of a given size, channel count, and filter. Holds the filter taps and intermediate rows:
+    // one scaler per plane and per thread.
+    //
+    class Scaler
+    {
+    public:
+
+        Scaler()
+            : _srcWidth(0)
+            , _srcHeight(0)
+            , _dstWidth(0)
+            , _dstHeight(0)
+            , _channels(0)
+            , _horizontalTaps(0)
+            , _horizontalBoxFactor(0)
+            , _verticalTaps(0)
+        {
+        }
+
+        // Sizes must be non-zero, 'channels' 1, 2, or 4
+        void Initialize(
+            _In_ unsigned int srcWidth,
+            _In_ unsigned int srcHeight,
+            _In_ unsigned int dstWidth,
+            _In_ unsigned int dstHeight,
+            _In_ unsigned int channels,
+            _In_ Filter filter
+            )
+        {
+            _srcWidth = srcWidth;
+            _srcHeight = srcHeight;
+            _dstWidth = dstWidth;
+            _dstHeight = dstHeight;
+            _channels = channels;
+            Details::ComputeCoefficients(srcWidth, dstWidth, filter, &_horizontalTaps, &_horizontalStarts, &_horizontalCoefficients);
+            Details::ComputeCoefficients(srcHeight, dstHeight, filter, &_verticalTaps, &_verticalStarts, &_verticalCoefficients);
+
+            // Luma decimated by 2 or 4: the area taps are a box over consecutive pixels
+            unsigned int factor = srcWidth / dstWidth;
+            bool box = (filter == Filter::Area) && (channels == 1) && (srcWidth == factor * dstWidth);
+            _horizontalBoxFactor = box && ((factor == 2) || (factor == 4)) ? factor : 0;
+
+            // Ring of horizontally-scaled rows: one per vertical tap, indexed by source row modulo the tap count
+            _rows.resize(_verticalTaps * dstWidth * channels);
+            _rowIndices.assign(_verticalTaps, -1);
+        }
+
+        bool IsInitialized() const
+        {
+            return _channels != 0;
+        }
+
+        // Strides are in bytes and can be negative
+        void Scale(
+            _Out_ unsigned char *dst,
+            _In_ long dstStride,
+            _In_ const unsigned char *src,
+            _In_ long srcStride
+            )
+        {
+            const Details::Functions *functions = Details::GetCurrentFunctions();
+
+            unsigned int rowLength = _dstWidth * _channels;
+            const unsigned char *rows[64];
+            for (unsigned int k = 0; k < _verticalTaps; k++)
+            {
+                _rowIndices[k] = -1; // Source changes from one call to the next
+            }
+
+            for (unsigned int y = 0; y < _dstHeight; y++)
+            {
+                int start = _verticalStarts[y];
+                for (unsigned int k = 0; k < _verticalTaps; k++)
+                {
+                    // Windows only move forward: the rows of the previous window are still in the ring
+                    int row = start + (int)k;
+                    unsigned int slot = (unsigned int)row % _verticalTaps;
+                    unsigned char *ringRow = &_rows[slot * rowLength];
+                    if (_rowIndices[slot] != row)
+                    {
+                        _ScaleRow(functions, ringRow, src + (long)row * srcStride);
+                        _rowIndices[slot] = row;
+                    }
+                    rows[k] = ringRow;
+                }
+
+                unsigned char *dstRow = dst + (long)y * dstStride;
+                if (_verticalTaps == 1)
+                {
+                    ImageCopy::CopyRow(dstRow, rows[0], rowLength); // Vertical identity
+                }
+                else
+                {
+                    functions->VerticalRow(dstRow, rows, &_verticalCoefficients[y * _verticalTaps], _verticalTaps, rowLength);
+                }
+            }
+        }
+
+    private:
+
+        void _ScaleRow(_In_ const Details::Functions *functions, _Out_ unsigned char *dst, _In_ const unsigned char *src)
+        {
+            switch (_channels)
+            {
+            case 1:
+                if (_horizontalBoxFactor != 0)
+                {
+                    functions->HorizontalBox(dst, src, _dstWidth, _horizontalBoxFactor);
+                    break;
+                }
+                Details::HorizontalRowScalar<1>(dst, src, _dstWidth, &_horizontalStarts[0], &_horizontalCoefficients[0], _horizontalTaps);
+                break;
+            case 2:
+                Details::HorizontalRowScalar<2>(dst, src, _dstWidth, &_horizontalStarts[0], &_horizontalCoefficients[0], _horizontalTaps);
+                break;
+            default:
+                functions->HorizontalRow4(dst, src, _dstWidth, &_horizontalStarts[0], &_horizontalCoefficients[0], _horizontalTaps);
+                break;
+            }
+        }
+
+        unsigned int _srcWidth;
+        unsigned int _srcHeight;
+        unsigned int _dstWidth;
+        unsigned int _dstHeight;
+        unsigned int _channels;
+
+        unsigned int _horizontalTaps;
+        std::vector<int> _horizontalStarts; // First source pixel of each destination pixel
+        std::vector<short> _horizontalCoefficients; // _horizontalTaps per destination pixel
+        unsigned int _horizontalBoxFactor; // 2 or 4 if the horizontal pass is a box decimation, 0 otherwise
+        unsigned int _verticalTaps;
+        std::vector<int> _verticalStarts;
+        std::vector<short> _verticalCoefficients;
+
+        std::vector<unsigned char> _rows;
+        std::vector<int> _rowIndices; // Source row held by each ring slot, -1 if none
+    };
+}
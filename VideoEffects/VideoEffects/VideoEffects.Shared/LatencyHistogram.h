@@ -0,0 +1,247 @@
+#pragma once
+
+//
+// Log-linear latency histogram (HDR histogram style)
+//
+// Durations are recorded in 100ns units. Each power of two is split into SubBucketCount linear buckets, so
+// values are kept with a relative error below 1/SubBucketCount (12.5%) from 100ns to about 30 hours, in a
+// fixed-size array. Record() is lock free: it can be called concurrently with itself and with the readers,
+// which then see a slightly stale but consistent-enough snapshot. Summaries use plain integers so they can be
+// published as attribute blobs.
+//
+
+class LatencyHistogram
+{
+public:
+
+    static const unsigned int SubBucketBits = 3;
+    static const unsigned int SubBucketCount = 1 << SubBucketBits;
+    static const unsigned int ValueBits = 40; // Larger values are clamped
+    static const unsigned int BucketCount = (ValueBits - SubBucketBits + 1) * SubBucketCount;
+
+    // Published as a BLOB by the effects (see EffectStatistics.h), all values in 100ns units
+    struct Summary
+    {
+        unsigned long long Count;
+        unsigned long long Mean;
+        unsigned long long P50;
+        unsigned long long P90;
+        unsigned long long P99;
+        unsigned long long Max;
+    };
+
+    // Records the time elapsed between its construction and destruction
+    class Scope
+    {
+    public:
+
+        explicit Scope(_In_ LatencyHistogram& histogram)
+            : _histogram(histogram)
+            , _start(Now())
+        {
+        }
+
+        ~Scope()
+        {
+            _histogram.Record(Elapsed(_start));
+        }
+
+    private:
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+        LatencyHistogram& _histogram;
+        long long _start;
+    };
+
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        for (unsigned int n = 0; n < BucketCount; n++)
+        {
+            _buckets[n] = 0;
+        }
+        _count = 0;
+        _sum = 0;
+        _max = 0;
+    }
+
+    void Record(_In_ unsigned long long value)
+    {
+        value = min(value, (1ull << ValueBits) - 1);
+
+        InterlockedIncrement(&_buckets[GetBucketIndex(value)]);
+        InterlockedIncrement64(&_count);
+        InterlockedExchangeAdd64(&_sum, (long long)value);
+
+        long long currentMax = _max;
+        while (((long long)value > currentMax) && (InterlockedCompareExchange64(&_max, (long long)value, currentMax) != currentMax))
+        {
+            currentMax = _max;
+        }
+    }
+
+    unsigned long long GetCount() const
+    {
+        return (unsigned long long)_count;
+    }
+
+    unsigned long long GetMax() const
+    {
+        return (unsigned long long)_max;
+    }
+
+    // Highest value equivalent to the value below which 'percentile' percent of the recorded values fall
+    unsigned long long GetValueAtPercentile(_In_ double percentile) const
+    {
+        unsigned long long count = GetCount();
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        unsigned long long target = (unsigned long long)(percentile / 100. * count + 0.5);
+        target = max(1ull, min(target, count));
+
+        unsigned long long total = 0;
+        for (unsigned int n = 0; n < BucketCount; n++)
+        {
+            total += (unsigned long)_buckets[n];
+            if (total >= target)
+            {
+                return min(GetBucketUpperBound(n), GetMax());
+            }
+        }
+        return GetMax();
+    }
+
+    Summary GetSummary() const
+    {
+        Summary summary;
+        summary.Count = GetCount();
+        summary.Mean = summary.Count != 0 ? (unsigned long long)_sum / summary.Count : 0;
+        summary.P50 = GetValueAtPercentile(50.);
+        summary.P90 = GetValueAtPercentile(90.);
+        summary.P99 = GetValueAtPercentile(99.);
+        summary.Max = GetMax();
+        return summary;
+    }
+
+    // Appends {"count":...,"mean":...,"p50":...,"p90":...,"p99":...,"max":...,"buckets":[[lower,upper,count],...]}
+    // Only non-empty buckets are listed
+    void AppendJson(_Inout_ std::wstring& json) const
+    {
+        Summary summary = GetSummary();
+        json += L"{\"count\":" + std::to_wstring(summary.Count);
+        json += L",\"mean\":" + std::to_wstring(summary.Mean);
+        json += L",\"p50\":" + std::to_wstring(summary.P50);
+        json += L",\"p90\":" + std::to_wstring(summary.P90);
+        json += L",\"p99\":" + std::to_wstring(summary.P99);
+        json += L",\"max\":" + std::to_wstring(summary.Max);
+        json += L",\"buckets\":[";
+        bool first = true;
+        for (unsigned int n = 0; n < BucketCount; n++)
+        {
+            unsigned long count = (unsigned long)_buckets[n];
+            if (count == 0)
+            {
+                continue;
+            }
+            json += first ? L"[" : L",[";
+            json += std::to_wstring(GetBucketLowerBound(n)) + L"," + std::to_wstring(GetBucketUpperBound(n)) + L"," + std::to_wstring(count) + L"]";
+            first = false;
+        }
+        json += L"]}";
+    }
+
+    static unsigned int GetBucketIndex(_In_ unsigned long long value)
+    {
+        if (value < 2 * SubBucketCount)
+        {
+            return (unsigned int)value;
+        }
+
+        unsigned int shift = _GetHighestBit(value) - SubBucketBits;
+        return (shift + 1) * SubBucketCount + (unsigned int)(value >> shift) - SubBucketCount;
+    }
+
+    static unsigned long long GetBucketLowerBound(_In_ unsigned int index)
+    {
+        if (index < 2 * SubBucketCount)
+        {
+            return index;
+        }
+
+        unsigned int shift = index / SubBucketCount - 1;
+        return (unsigned long long)(SubBucketCount + index % SubBucketCount) << shift;
+    }
+
+    static unsigned long long GetBucketUpperBound(_In_ unsigned int index)
+    {
+        if (index < 2 * SubBucketCount)
+        {
+            return index;
+        }
+
+        unsigned int shift = index / SubBucketCount - 1;
+        return ((unsigned long long)(SubBucketCount + index % SubBucketCount + 1) << shift) - 1;
+    }
+
+    // Performance-counter timestamp, see Elapsed()
+    static long long Now()
+    {
+        LARGE_INTEGER time;
+        (void)QueryPerformanceCounter(&time);
+        return time.QuadPart;
+    }
+
+    // Time elapsed since a Now() timestamp, in 100ns units
+    static unsigned long long Elapsed(_In_ long long start)
+    {
+        long long elapsed = Now() - start;
+        long long frequency = _GetFrequency();
+        return elapsed > 0 ? (unsigned long long)(elapsed / frequency * 10000000 + elapsed % frequency * 10000000 / frequency) : 0;
+    }
+
+private:
+
+    LatencyHistogram(const LatencyHistogram&);
+    LatencyHistogram& operator=(const LatencyHistogram&);
+
+    static unsigned int _GetHighestBit(_In_ unsigned long long value)
+    {
+        // _BitScanReverse64() is not available on 32-bit targets
+        unsigned long index;
+        if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+        {
+            return index + 32;
+        }
+        (void)_BitScanReverse(&index, (unsigned long)value);
+        return index;
+    }
+
+    static long long _GetFrequency()
+    {
+        // Fixed at boot, so concurrent first calls store the same value
+        static volatile long long s_frequency = 0; // Zero-initialized: no thread-safety issue with static initialization
+        long long frequency = s_frequency;
+        if (frequency == 0)
+        {
+            LARGE_INTEGER value;
+            (void)QueryPerformanceFrequency(&value);
+            frequency = value.QuadPart;
+            s_frequency = frequency;
+        }
+        return frequency;
+    }
+
+    volatile long _buckets[BucketCount];
+    volatile long long _count;
+    volatile long long _sum;
+    volatile long long _max;
+};
@@ -1,8 +1,10 @@
 #include "pch.h"
 #include "WinRTBufferOnMF2DBuffer.h"
+#include "WinRTBufferPool.h"
 #include "WinRTBufferView.h"
 #include "VideoProcessor.h"
 #include "Video1in1outEffect.h"
+#include "ImageScale.h"
 #include "LumiaAnalyzerDefinition.h"
 #include "LumiaAnalyzer.h"
 
@@ -23,7 +25,21 @@ LumiaAnalyzer::LumiaAnalyzer()
     , _length(0)
     , _outputWidth(0)
     , _outputHeight(0)
-    , _processingSample(false)
+    , _processorFlushNeeded(false)
+    , _processorTypesSet(false)
+    , _lumaOnly(false)
+    , _samplingPolicy(SamplingPolicy::DropWhileBusy)
+    , _samplingInterval(0)
+    , _samplingStride(1)
+    , _samplingQueueSize(0)
+    , _frameIndex(0)
+    , _nextSampleTime(0)
+    , _hasNextSampleTime(false)
+    , _analyzing(false)
+    , _generation(0)
+    , _analyzedCount(0)
+    , _droppedCount(0)
+    , _skippedCount(0)
 {
     _passthrough = true;
     _outputSubtype = {};
@@ -39,6 +55,50 @@ void LumiaAnalyzer::Initialize(_In_ IMap<String^, Object^>^ props)
 
     NT_ASSERT((_colorMode == ColorMode::Bgra8888) || (_colorMode == ColorMode::Yuv420Sp) || (_colorMode == ColorMode::Gray8));
     _outputSubtype = _colorMode == ColorMode::Bgra8888 ? MFVideoFormat_RGB32 : MFVideoFormat_NV12; // Gray8 maps to NV12 in MF
+
+    // By default frames arriving while the analyzer is busy are dropped, which makes the analysis rate depend
+    // on scheduling. The other policies pick frames at a steady cadence and hold on to the frames arriving
+    // during an analysis (which keeps those samples out of the pipeline sample pools meanwhile).
+    unsigned int samplingPolicy = GetUInt32(props, L"SamplingPolicy", (unsigned int)SamplingPolicy::DropWhileBusy);
+    if (samplingPolicy > (unsigned int)SamplingPolicy::BoundedQueue)
+    {
+        throw ref new InvalidArgumentException(L"SamplingPolicy");
+    }
+    _samplingPolicy = (SamplingPolicy)samplingPolicy;
+
+    unsigned int samplingInterval = GetUInt32(props, L"SamplingInterval", 100);
+    if (samplingInterval == 0)
+    {
+        throw ref new InvalidArgumentException(L"SamplingInterval");
+    }
+    _samplingInterval = 10000ll * samplingInterval;
+
+    _samplingStride = GetUInt32(props, L"SamplingStride", 2);
+    if (_samplingStride == 0)
+    {
+        throw ref new InvalidArgumentException(L"SamplingStride");
+    }
+
+    switch (_samplingPolicy)
+    {
+    case SamplingPolicy::DropWhileBusy:
+        _samplingQueueSize = 0;
+        break;
+
+    case SamplingPolicy::BoundedQueue:
+        _samplingQueueSize = GetUInt32(props, L"SamplingQueueSize", 3);
+        if (_samplingQueueSize == 0)
+        {
+            throw ref new InvalidArgumentException(L"SamplingQueueSize");
+        }
+        break;
+
+    default:
+        _samplingQueueSize = 1; // Mailbox
+        break;
+    }
+
+    Trace("Sampling policy %i, interval %lli, stride %i, queue size %i", _samplingPolicy, _samplingInterval, _samplingStride, _samplingQueueSize);
 }
 
 vector<unsigned long> LumiaAnalyzer::GetSupportedFormats() const
@@ -50,23 +110,100 @@ vector<unsigned long> LumiaAnalyzer::GetSupportedFormats() const
     formats.push_back(MFVideoFormat_420O.Data1);
     formats.push_back(MFVideoFormat_YUY2.Data1);
     formats.push_back(MFVideoFormat_YV12.Data1);
+    formats.push_back(MFVideoFormat_I420.Data1);
+    formats.push_back(MFVideoFormat_IYUV.Data1);
     formats.push_back(MFVideoFormat_RGB32.Data1);
     formats.push_back(MFVideoFormat_ARGB32.Data1);
 
     return formats;
 }
 
-void LumiaAnalyzer::StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned int width, _In_ unsigned int height)
+void LumiaAnalyzer::StartStreaming(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height)
 {
     auto lock = _analyzerLock.LockExclusive();
 
+    _processor = nullptr;
+    _SetConversion(format, width, height);
+
+    auto samplingLock = _samplingLock.LockExclusive();
+    _frameIndex = 0;
+    _hasNextSampleTime = false;
+    _generation++;
+}
+
+void LumiaAnalyzer::EndStreaming()
+{
+    // Release the frames waiting for the analyzer back to the pipeline
+    auto lock = _samplingLock.LockExclusive();
+    InterlockedExchangeAdd64(&_droppedCount, (long long)_pendingSamples.size());
+    _pendingSamples.clear();
+}
+
+void LumiaAnalyzer::OnFormatChanged(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height)
+{
+    auto lock = _analyzerLock.LockExclusive();
+
+    // Keep the video processor (and its D3D resources), only update its media types
+    if (_processor != nullptr)
+    {
+        CHK(_processor->SetOutputType(0, nullptr, 0));
+        CHK(_processor->SetInputType(0, nullptr, 0));
+    }
+    _SetConversion(format, width, height);
+
+    // Frames waiting for the analyzer have the previous format
+    auto samplingLock = _samplingLock.LockExclusive();
+    InterlockedExchangeAdd64(&_droppedCount, (long long)_pendingSamples.size());
+    _pendingSamples.clear();
+    _generation++;
+}
+
+// Called with _analyzerLock held
+void LumiaAnalyzer::_SetConversion(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height)
+{
     // Isotropic scaling
     float scale = _length / (float)max(width, height);
     _outputWidth = (unsigned int)(scale * width);
     _outputHeight = (unsigned int)(scale * height);
 
-    _processor = CreateVideoProcessor();
+    // Gray8 bitmaps of NV12 frames are their Y plane: read in place at the same size, area-decimated
+    // otherwise, without going through the video processor. The processor is only set up when a frame
+    // cannot be read that way (see _CanReadLuma()).
+    _lumaOnly = (_colorMode == ColorMode::Gray8) && ((format == MFVideoFormat_NV12.Data1) || (format == MFVideoFormat_420O.Data1));
+    _lumaBuffer = nullptr;
+    _processorOutputAllocator = nullptr;
+    _processorTypesSet = false;
+    if (_lumaOnly)
+    {
+        if ((_outputWidth != width) || (_outputHeight != height))
+        {
+            _lumaScaler.Initialize(width, height, _outputWidth, _outputHeight, 1, ImageScale::Filter::Area);
+            _lumaBuffer = ref new Buffer(_outputWidth * _outputHeight);
+            _lumaBuffer->Length = _outputWidth * _outputHeight;
+        }
+        return;
+    }
 
+    _SetProcessor();
+}
+
+// Called with _analyzerLock held
+void LumiaAnalyzer::_SetProcessor()
+{
+    if (_processor == nullptr)
+    {
+        _processor = CreateVideoProcessor();
+
+        CHK(MFCreateSample(&_processorInputSample));
+        CHK(_processorInputSample->SetSampleTime(0));
+        CHK(_processorInputSample->SetSampleDuration(10000000));
+    }
+    _SetProcessorTypes();
+}
+
+// Called with _analyzerLock held
+void LumiaAnalyzer::_SetProcessorTypes()
+{
     // Create the output media type
     ComPtr<IMFMediaType> outputType;
     CHK(MFCreateMediaType(&outputType));
@@ -76,6 +213,11 @@ void LumiaAnalyzer::StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned
     CHK(MFSetAttributeSize(outputType.Get(), MF_MT_FRAME_SIZE, _outputWidth, _outputHeight));
     CHK(MFSetAttributeRatio(outputType.Get(), MF_MT_FRAME_RATE, 1, 1));
     CHK(MFSetAttributeRatio(outputType.Get(), MF_MT_PIXEL_ASPECT_RATIO, 1, 1));
+    if (_colorMode == ColorMode::Bgra8888)
+    {
+        // Top-down RGB: the video processor flips bottom-up input while converting it, no extra copy
+        CHK(outputType->SetUINT32(MF_MT_DEFAULT_STRIDE, 4 * _outputWidth));
+    }
 
     // Set the input/output formats
     bool useGraphicsDevice = (_deviceManager != nullptr);
@@ -103,119 +245,301 @@ void LumiaAnalyzer::StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned
         CHK(_processor->SetInputType(0, _inputType.Get(), 0));
         CHK(_processor->SetOutputType(0, outputType.Get(), 0));
     }
+
+    // In SW mode, output samples come from a small pool: one in use by the analyzer, plus slack
+    // In HW mode, the video proc allocates
+    _processorOutputAllocator = nullptr;
+    MFT_OUTPUT_STREAM_INFO outputStreamInfo;
+    CHK(_processor->GetOutputStreamInfo(0, &outputStreamInfo));
+    if (!(outputStreamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES))
+    {
+        unique_ptr<SampleAllocatorPool> allocator(new SampleAllocatorPool(nullptr));
+        CHK(allocator->Initialize(1, 2, nullptr, outputType.Get()));
+        _processorOutputAllocator = move(allocator);
+    }
+
+    // Frames are converted one at a time without flushing in-between
+    CHK(_processor->ProcessMessage(MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+    _processorFlushNeeded = false;
+    _processorTypesSet = true;
 }
 
 void LumiaAnalyzer::ProcessSample(_In_ const ComPtr<IMFSample>& sample)
 {
-    if (InterlockedExchange(&_processingSample, true))
+    auto lock = _samplingLock.LockExclusive();
+
+    if (!_IsSampled(sample))
     {
-        // Ignore current sample if still processing the previous one
+        InterlockedIncrement64(&_skippedCount);
         return;
     }
 
-    // Run async to reduce impact on video stream
-    ThreadPool::RunAsync(ref new WorkItemHandler([this, sample](IAsyncAction^)
+    PendingSample pending = { sample, LatencyHistogram::Now(), _generation };
+    if (!_analyzing)
+    {
+        _analyzing = true;
+        _RunAnalysis(pending);
+    }
+    else if (_pendingSamples.size() < _samplingQueueSize)
+    {
+        _pendingSamples.push_back(pending);
+    }
+    else if ((_samplingPolicy != SamplingPolicy::BoundedQueue) && !_pendingSamples.empty())
     {
-        auto lock = _analyzerLock.LockExclusive();
-        Logger.LumiaAnalyzer_ProcessStart((void*)this);
+        // Mailbox: the newest frame replaces the one waiting
+        _pendingSamples.front() = pending;
+        InterlockedIncrement64(&_droppedCount);
+    }
+    else
+    {
+        // Busy (or queue full): drop the frame
+        InterlockedIncrement64(&_droppedCount);
+    }
+}
 
+// Called with _samplingLock held
+bool LumiaAnalyzer::_IsSampled(_In_ const ComPtr<IMFSample>& sample)
+{
+    switch (_samplingPolicy)
+    {
+    case SamplingPolicy::Interval:
+    {
         long long time = 0;
-        (void)sample->GetSampleTime(&time);
-
-        ComPtr<IMFMediaBuffer> inputBuffer;
-        CHK(sample->GetBufferByIndex(0, &inputBuffer));
-        ComPtr<IMFMediaBuffer> outputBuffer = _ConvertBuffer(inputBuffer);
-
-        // Create IBuffer wrappers
-        ComPtr<WinRTBufferOnMF2DBuffer> outputWinRTBuffer;
-        CHK(MakeAndInitialize<WinRTBufferOnMF2DBuffer>(&outputWinRTBuffer, outputBuffer, MF2DBuffer_LockFlags_Read, _inputDefaultStride));
-
-        // Create bitmap wrappers
-        Size outputSize = { (float)_outputWidth, (float)_outputHeight };
-        Bitmap^ outputBitmap;
-        switch (_colorMode)
+        if (FAILED(sample->GetSampleTime(&time)))
         {
-        case ColorMode::Bgra8888:
-            outputBitmap = ref new Bitmap(outputSize, ColorMode::Bgra8888, outputWinRTBuffer->GetStride(), outputWinRTBuffer->GetIBuffer());
-            break;
+            return true;
+        }
 
-        case ColorMode::Yuv420Sp:
+        // Skip frames before the next sampling time, unless time jumped backward (seek)
+        if (_hasNextSampleTime && (time < _nextSampleTime) && (time >= _nextSampleTime - _samplingInterval))
         {
-            ComPtr<WinRTBufferView> outputWinRTBufferY;
-            ComPtr<WinRTBufferView> outputWinRTBufferUV;
-            CHK(MakeAndInitialize<WinRTBufferView>(&outputWinRTBufferY, outputWinRTBuffer, 0));
-            CHK(MakeAndInitialize<WinRTBufferView>(&outputWinRTBufferUV, outputWinRTBuffer, outputWinRTBuffer->GetStride() * _outputHeight));
-            outputBitmap = ref new Bitmap(
-                outputSize, 
-                ColorMode::Yuv420Sp, 
-                ref new Array<unsigned int>{ outputWinRTBuffer->GetStride(), outputWinRTBuffer->GetStride() }, 
-                ref new Array<IBuffer^>{ outputWinRTBufferY->GetIBuffer(), outputWinRTBufferUV->GetIBuffer() }
-            );
+            return false;
         }
-            break;
 
-        case ColorMode::Gray8:
-            outputBitmap = ref new Bitmap(outputSize, ColorMode::Gray8, outputWinRTBuffer->GetStride(), outputWinRTBuffer->GetIBuffer());
-            break;
+        // Stay on the cadence unless time jumped past the next sampling time (seek, gap in the stream)
+        bool onCadence = _hasNextSampleTime && (time >= _nextSampleTime) && (time < _nextSampleTime + _samplingInterval);
+        _nextSampleTime = (onCadence ? _nextSampleTime : time) + _samplingInterval;
+        _hasNextSampleTime = true;
+        return true;
+    }
+
+    case SamplingPolicy::EveryNthFrame:
+        return (_frameIndex++ % _samplingStride) == 0;
 
-        default:
-            throw ref new InvalidArgumentException(L"Unexpected color mode");
+    default:
+        return true;
+    }
+}
+
+// Called with _samplingLock held and _analyzing set: runs the analyzer on the thread pool (to reduce
+// impact on the video stream) until no frame is left waiting
+void LumiaAnalyzer::_RunAnalysis(_In_ const PendingSample& pending)
+{
+    // Keep the analyzer alive until the work item completes
+    ComPtr<IMFTransform> self(static_cast<IMFTransform*>(this));
+
+    ThreadPool::RunAsync(ref new WorkItemHandler([this, self, pending](IAsyncAction^)
+    {
+        PendingSample current = pending;
+        for (;;)
+        {
+            _lagLatency.Record(LatencyHistogram::Elapsed(current.ArrivalTime));
+
+            // Frames queued before a format change and failed analyses count as dropped
+            bool analyzed = false;
+            (void)ExceptionBoundary([this, &current, &analyzed]()
+            {
+                auto lock = _analyzerLock.LockExclusive();
+                if (current.Generation == _generation)
+                {
+                    _AnalyzeSample(current.Sample);
+                    analyzed = true;
+                }
+            });
+            InterlockedIncrement64(analyzed ? &_analyzedCount : &_droppedCount);
+            current.Sample = nullptr;
+
+            auto lock = _samplingLock.LockExclusive();
+            if (_pendingSamples.empty())
+            {
+                _analyzing = false;
+                return;
+            }
+            current = _pendingSamples.front();
+            _pendingSamples.pop_front();
         }
+    }));
+}
+
+// Called with _analyzerLock held
+void LumiaAnalyzer::_AnalyzeSample(_In_ const ComPtr<IMFSample>& sample)
+{
+    Logger.LumiaAnalyzer_ProcessStart((void*)this);
 
-        Logger.LumiaAnalyzer_AnalyzeStart((void*)this);
-        _analyzer(outputBitmap, TimeSpan{ time });
-        Logger.LumiaAnalyzer_AnalyzeStop((void*)this);
+    long long time = 0;
+    (void)sample->GetSampleTime(&time);
 
-        // Force MF buffer unlocking
-        outputWinRTBuffer->Close();
+    ComPtr<IMFMediaBuffer> inputBuffer;
+    CHK(sample->GetBufferByIndex(0, &inputBuffer));
 
-        // Done with this sample, can process the next
+    Size outputSize = { (float)_outputWidth, (float)_outputHeight };
+    if (_lumaOnly && _CanReadLuma(inputBuffer))
+    {
+        _AnalyzeLuma(inputBuffer, outputSize, TimeSpan{ time });
         Logger.LumiaAnalyzer_ProcessStop((void*)this);
-        InterlockedExchange(&_processingSample, false);
-    }));
+        return;
+    }
+
+    if (!_processorTypesSet)
+    {
+        _SetProcessor();
+    }
+
+    ComPtr<IMFSample> outputSample = _ConvertBuffer(inputBuffer);
+    ComPtr<IMFMediaBuffer> outputBuffer;
+    CHK(outputSample->GetBufferByIndex(0, &outputBuffer));
+
+    // Get an IBuffer wrapper, with the top-down stride of the output type for 1D buffers
+    long outputDefaultStride = (long)(_colorMode == ColorMode::Bgra8888 ? 4 * _outputWidth : _outputWidth);
+    ComPtr<WinRTBufferOnMF2DBuffer> outputWinRTBuffer = _bufferPool.Open(outputBuffer, MF2DBuffer_LockFlags_Read, outputDefaultStride);
+    if (outputWinRTBuffer->IsBottomUp())
+    {
+        CHK(OriginateError(E_UNEXPECTED, L"Bottom-up analyzer bitmap"));
+    }
+
+    // Create bitmap wrappers
+    Bitmap^ outputBitmap;
+    switch (_colorMode)
+    {
+    case ColorMode::Bgra8888:
+        outputBitmap = ref new Bitmap(outputSize, ColorMode::Bgra8888, outputWinRTBuffer->GetPitch(), outputWinRTBuffer->GetIBuffer());
+        break;
+
+    case ColorMode::Yuv420Sp:
+    {
+        ComPtr<WinRTBufferView> outputWinRTBufferY;
+        ComPtr<WinRTBufferView> outputWinRTBufferUV;
+        CHK(MakeAndInitialize<WinRTBufferView>(&outputWinRTBufferY, outputWinRTBuffer, 0));
+        CHK(MakeAndInitialize<WinRTBufferView>(&outputWinRTBufferUV, outputWinRTBuffer, outputWinRTBuffer->GetPitch() * _outputHeight));
+        outputBitmap = ref new Bitmap(
+            outputSize, 
+            ColorMode::Yuv420Sp, 
+            ref new Array<unsigned int>{ outputWinRTBuffer->GetPitch(), outputWinRTBuffer->GetPitch() }, 
+            ref new Array<IBuffer^>{ outputWinRTBufferY->GetIBuffer(), outputWinRTBufferUV->GetIBuffer() }
+        );
+    }
+        break;
+
+    case ColorMode::Gray8:
+        outputBitmap = ref new Bitmap(outputSize, ColorMode::Gray8, outputWinRTBuffer->GetPitch(), outputWinRTBuffer->GetIBuffer());
+        break;
+
+    default:
+        throw ref new InvalidArgumentException(L"Unexpected color mode");
+    }
+
+    Logger.LumiaAnalyzer_AnalyzeStart((void*)this);
+    _analyzer(outputBitmap, TimeSpan{ time });
+    Logger.LumiaAnalyzer_AnalyzeStop((void*)this);
+
+    // Force MF buffer unlocking
+    _bufferPool.Close(outputWinRTBuffer);
+
+    Logger.LumiaAnalyzer_ProcessStop((void*)this);
+}
+
+// The Y plane is read in place from system-memory buffers only: GPU buffers would be copied back to the CPU
+// on each lock, and 1D buffers need a known default stride (420O has none, see VideoFormat.h)
+bool LumiaAnalyzer::_CanReadLuma(_In_ const ComPtr<IMFMediaBuffer>& buffer) const
+{
+    ComPtr<IMFDXGIBuffer> bufferDXGI;
+    if (SUCCEEDED(buffer.As(&bufferDXGI)))
+    {
+        return false;
+    }
+
+    ComPtr<IMF2DBuffer> buffer2D;
+    return SUCCEEDED(buffer.As(&buffer2D)) || (_inputDefaultStride != 0);
+}
+
+// Called with _analyzerLock held
+void LumiaAnalyzer::_AnalyzeLuma(_In_ const ComPtr<IMFMediaBuffer>& inputBuffer, _In_ Size outputSize, _In_ TimeSpan time)
+{
+    ComPtr<WinRTBufferOnMF2DBuffer> inputWinRTBuffer = _bufferPool.Open(inputBuffer, MF2DBuffer_LockFlags_Read, (long)_inputDefaultStride);
+
+    Bitmap^ outputBitmap;
+    if (_lumaBuffer == nullptr)
+    {
+        // Zero copy: the Y plane starts the buffer
+        ComPtr<WinRTBufferView> inputWinRTBufferY;
+        CHK(MakeAndInitialize<WinRTBufferView>(&inputWinRTBufferY, inputWinRTBuffer, 0));
+        outputBitmap = ref new Bitmap(outputSize, ColorMode::Gray8, inputWinRTBuffer->GetPitch(), inputWinRTBufferY->GetIBuffer());
+    }
+    else
+    {
+        // The input buffer can be unlocked before analysis
+        _lumaScaler.Scale(GetData(_lumaBuffer), _outputWidth, GetData(inputWinRTBuffer->GetIBuffer()), (long)inputWinRTBuffer->GetPitch());
+        _bufferPool.Close(inputWinRTBuffer);
+        inputWinRTBuffer = nullptr;
+        outputBitmap = ref new Bitmap(outputSize, ColorMode::Gray8, _outputWidth, _lumaBuffer);
+    }
+
+    Logger.LumiaAnalyzer_AnalyzeStart((void*)this);
+    _analyzer(outputBitmap, time);
+    Logger.LumiaAnalyzer_AnalyzeStop((void*)this);
+
+    // Force MF buffer unlocking
+    if (inputWinRTBuffer != nullptr)
+    {
+        _bufferPool.Close(inputWinRTBuffer);
+    }
+}
+
+void LumiaAnalyzer::PublishStatistics(_In_ const ComPtr<IMFAttributes>& attributes) const
+{
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_CREATED, _bufferPool.GetCreatedCount()));
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_BUFFER_WRAPPERS_REUSED, _bufferPool.GetReusedCount()));
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_ANALYZER_FRAMES_ANALYZED, (unsigned long long)_analyzedCount));
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_ANALYZER_FRAMES_DROPPED, (unsigned long long)_droppedCount));
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_ANALYZER_FRAMES_SKIPPED, (unsigned long long)_skippedCount));
+
+    LatencyHistogram::Summary lag = _lagLatency.GetSummary();
+    CHK(attributes->SetBlob(VE_STATISTICS_LUMIA_ANALYZER_LAG, reinterpret_cast<const UINT8*>(&lag), sizeof(lag)));
 }
 
-ComPtr<IMFMediaBuffer> LumiaAnalyzer::_ConvertBuffer(
+// Called with _analyzerLock held
+ComPtr<IMFSample> LumiaAnalyzer::_ConvertBuffer(
     _In_ const ComPtr<IMFMediaBuffer>& inputBuffer
-    ) const
+    )
 {
     Logger.LumiaAnalyzer_ConvertStart((void*)this, _processor.Get());
 
-    // Create the input MF sample
-    ComPtr<IMFSample> inputSample;
-    CHK(MFCreateSample(&inputSample));
-    CHK(inputSample->AddBuffer(inputBuffer.Get()));
-    CHK(inputSample->SetSampleTime(0));
-    CHK(inputSample->SetSampleDuration(10000000));
+    // Bind the input buffer to the input MF sample
+    CHK(_processorInputSample->RemoveAllBuffers());
+    CHK(_processorInputSample->AddBuffer(inputBuffer.Get()));
 
-    // Create the output MF sample
-    // In SW mode, we allocate the output buffer
-    // In HW mode, the video proc allocates
+    // Get the output MF sample (returned to the pool when released)
     ComPtr<IMFSample> outputSample;
-    MFT_OUTPUT_STREAM_INFO outputStreamInfo;
-    CHK(_processor->GetOutputStreamInfo(0, &outputStreamInfo));
-    if (!(outputStreamInfo.dwFlags & MFT_OUTPUT_STREAM_PROVIDES_SAMPLES))
+    if (_processorOutputAllocator != nullptr)
     {
-        ComPtr<IMFMediaBuffer> buffer1D;
-        CHK(MFCreate2DMediaBuffer(_outputWidth, _outputHeight, _outputSubtype.Data1, false, &buffer1D));
-
-        CHK(MFCreateSample(&outputSample));
-        CHK(outputSample->AddBuffer(buffer1D.Get()));
-        CHK(outputSample->SetSampleTime(0));
-        CHK(outputSample->SetSampleDuration(10000000));
+        CHK(_processorOutputAllocator->AllocateSample(&outputSample));
     }
 
-    // Process data
+    // Process data, only flushing if the previous frame did not go through
     DWORD status;
     MftOutputDataBuffer output(outputSample);
-    CHK(_processor->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0));
-    CHK(_processor->ProcessInput(0, inputSample.Get(), 0));
+    if (_processorFlushNeeded)
+    {
+        CHK(_processor->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0));
+    }
+    _processorFlushNeeded = true; // Until the frame goes through
+    CHK(_processor->ProcessInput(0, _processorInputSample.Get(), 0));
     CHK(_processor->ProcessOutput(0, 1, &output, &status));
+    _processorFlushNeeded = false;
 
-    // Get the output buffer
-    ComPtr<IMFMediaBuffer> outputBuffer;
-    CHK(output.pSample->GetBufferByIndex(0, &outputBuffer));
+    // Do not hold on to the pipeline buffer
+    CHK(_processorInputSample->RemoveAllBuffers());
 
     Logger.LumiaAnalyzer_ConvertStop((void*)this);
-    return outputBuffer;
+    return output.pSample;
 }
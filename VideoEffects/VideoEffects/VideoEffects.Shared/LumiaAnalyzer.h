@@ -32,26 +32,94 @@ public:
 
     // Data processing
     virtual void StartStreaming(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height) override;
+    virtual void OnFormatChanged(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height) override;
+    virtual void EndStreaming() override;
     virtual void ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& sample) override;
 
+    // Statistics
+    virtual void PublishStatistics(_In_ const Microsoft::WRL::ComPtr<IMFAttributes>& attributes) const override;
+
 private:
 
-    Microsoft::WRL::ComPtr<IMFMediaBuffer> _ConvertBuffer(
+    // Values of the "SamplingPolicy" property: which frames of the stream get analyzed
+    enum class SamplingPolicy
+    {
+        DropWhileBusy,  // Frames arriving during an analysis are dropped
+        Interval,       // One frame per "SamplingInterval" milliseconds of media time
+        EveryNthFrame,  // One frame in "SamplingStride"
+        LatestWins,     // Frames arriving during an analysis replace each other, the last one is analyzed next
+        BoundedQueue    // Frames arriving during an analysis are queued, up to "SamplingQueueSize"
+    };
+
+    // Frame waiting for the analyzer, along with the time it arrived (see LatencyHistogram::Now())
+    struct PendingSample
+    {
+        Microsoft::WRL::ComPtr<IMFSample> Sample;
+        long long ArrivalTime;
+        unsigned int Generation; // See _generation
+    };
+
+    bool _IsSampled(_In_ const Microsoft::WRL::ComPtr<IMFSample>& sample);
+    void _RunAnalysis(_In_ const PendingSample& pending);
+    void _AnalyzeSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& sample);
+    bool _CanReadLuma(_In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer) const;
+    void _AnalyzeLuma(
+        _In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& inputBuffer,
+        _In_ Windows::Foundation::Size outputSize,
+        _In_ Windows::Foundation::TimeSpan time
+        );
+
+    void _SetConversion(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height);
+    void _SetProcessor();
+    void _SetProcessorTypes();
+
+    // Returns the output sample, which goes back to the pool when released
+    Microsoft::WRL::ComPtr<IMFSample> _ConvertBuffer(
         _In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer
-        ) const;
+        );
 
     Lumia::Imaging::ColorMode _colorMode;
     unsigned int _length;
     VideoEffects::BitmapVideoAnalyzer^ _analyzer;
     Microsoft::WRL::ComPtr<IMFTransform> _processor;
+
+    // Video processor session kept across frames: a single input sample rebound to each frame, and output
+    // samples recycled by an allocator in software mode (null when the video processor provides them)
+    Microsoft::WRL::ComPtr<IMFSample> _processorInputSample;
+    std::unique_ptr<SampleAllocatorPool> _processorOutputAllocator;
+    bool _processorFlushNeeded; // Set when a conversion failed midway
+    bool _processorTypesSet; // Not until needed when analyzing the Y plane of the frames
+
+    // Gray8 analyzers of NV12 streams read the Y plane of system-memory frames directly, scaled if needed
+    bool _lumaOnly;
+    ImageScale::Scaler _lumaScaler;
+    Windows::Storage::Streams::Buffer^ _lumaBuffer; // Scaled Y plane, null when the frame size is kept
+    WinRTBufferPool _bufferPool;
     
     GUID _outputSubtype;
     unsigned int _outputWidth;
     unsigned int _outputHeight;
 
-    volatile unsigned int _processingSample;
+    // Sampling, see the "Sampling*" properties
+    SamplingPolicy _samplingPolicy;
+    long long _samplingInterval; // 100ns
+    unsigned int _samplingStride;
+    unsigned int _samplingQueueSize; // Frames held while the analyzer is busy
+    unsigned long long _frameIndex;
+    long long _nextSampleTime;
+    bool _hasNextSampleTime;
+    bool _analyzing; // A thread-pool work item is running the analyzer
+    unsigned int _generation; // Incremented when the media types change, to skip frames queued before
+    std::deque<PendingSample> _pendingSamples;
+
+    // Statistics, updated atomically
+    volatile long long _analyzedCount;
+    volatile long long _droppedCount;
+    volatile long long _skippedCount;
+    LatencyHistogram _lagLatency;
 
     mutable ::Microsoft::WRL::Wrappers::SRWLock _analyzerLock;
+    ::Microsoft::WRL::Wrappers::SRWLock _samplingLock; // Held briefly, never while analyzing
 };
 
 ActivatableClass(LumiaAnalyzer);
\ No newline at end of file
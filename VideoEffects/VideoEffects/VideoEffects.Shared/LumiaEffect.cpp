@@ -1,12 +1,15 @@
 ﻿#include "pch.h"
 #include "FilterChainFactory.h"
 #include "WinRTBufferOnMF2DBuffer.h"
+#include "WinRTBufferView.h"
 #include "Video1in1outEffect.h"
+#include "ImageScale.h"
 #include "LumiaEffect.h"
 
 using namespace concurrency;
 using namespace Microsoft::WRL;
 using namespace Lumia::Imaging;
+using namespace Lumia::Imaging::Transforms;
 using namespace Platform;
 using namespace std;
 using namespace VideoEffects;
@@ -19,18 +22,26 @@ void LumiaEffect::Initialize(_In_ IMap<Platform::String^, Object^>^ props)
 {
     CHKNULL(props);
 
-    // Get the list of filters
+    // Get the list of filters. Filters cannot be shared by renders in flight: the factory is kept
+    // to create one chain per render graph.
     if (props->HasKey(L"FilterChainFactory"))
     {
         Object^ factoryObject = props->Lookup(L"FilterChainFactory");
-        _filters = dynamic_cast<FilterChainFactory^>(factoryObject)();
-        if (_filters == nullptr)
+        auto factory = dynamic_cast<FilterChainFactory^>(factoryObject);
+        if (factory != nullptr)
+        {
+            _filterChainFactory = [factory]() { return factory(); };
+        }
+        else
         {
             auto factoryAcid = safe_cast<String^>(factoryObject);
             ComPtr<IInspectable> factoryInspectable;
             CHK(RoActivateInstance(StringReference(factoryAcid->Data()).GetHSTRING(), &factoryInspectable));
-            _filters = safe_cast<IFilterChainFactory^>(reinterpret_cast<Object^>(factoryInspectable.Get()))->Create();
+            auto serializableFactory = safe_cast<IFilterChainFactory^>(reinterpret_cast<Object^>(factoryInspectable.Get()));
+            _filterChainFactory = [serializableFactory]() { return serializableFactory->Create(); };
         }
+        _filters = _filterChainFactory();
+        CHKNULL(_filters);
     }
     else if (props->HasKey(L"AnimatedFilterChainFactory"))
     {
@@ -47,19 +58,60 @@ void LumiaEffect::Initialize(_In_ IMap<Platform::String^, Object^>^ props)
         throw ref new InvalidArgumentException(L"Filter-chain factory key not found");
     }
 
+    // Banded bitmap effects process horizontal bands of each frame in parallel, one band per core
+    // unless specified otherwise
+    _bandedEffect = dynamic_cast<IBandedBitmapVideoEffect^>(_bitmapEffect);
+    _bandCountInit = GetUInt32(props, L"BitmapEffectBands", 0);
+
+    // Filter chains read bottom-up RGB buffers in place, bitmap effects need top-down 2D buffers
+    _inPlaceRgbInput = (_bitmapEffect == nullptr);
+
+    // Filter chains can also render NV12 frames directly (Yuv420Sp bitmaps), which saves the color conversions
+    // around the effect in decoder and camera pipelines. Opt-in as not all filters support Yuv420Sp input.
+    // Bitmap effects are handed Bgra8888 bitmaps.
+    unsigned int nv12 = GetUInt32(props, L"Nv12", 0);
+    if (nv12 > 1)
+    {
+        throw ref new InvalidArgumentException(L"Nv12");
+    }
+    _nv12 = (nv12 != 0) && (_bitmapEffect == nullptr);
+    _supportedFormats = GetSupportedFormats();
+
+    // When the input and output resolutions differ, filter chains can leave resizing to the built-in
+    // polyphase scaler, run before the chain (cheaper when downscaling) or after it. Bitmap effects get
+    // both bitmaps and resize frames themselves.
+    unsigned int scaleMode = GetUInt32(props, L"Scaler", (unsigned int)ScaleMode::None);
+    if (scaleMode > (unsigned int)ScaleMode::AfterChain)
+    {
+        throw ref new InvalidArgumentException(L"Scaler");
+    }
+    unsigned int scaleFilter = GetUInt32(props, L"ScalerFilter", (unsigned int)ImageScale::Filter::Bicubic);
+    if (scaleFilter > (unsigned int)ImageScale::Filter::Area)
+    {
+        throw ref new InvalidArgumentException(L"ScalerFilter");
+    }
+    _scaleModeInit = (_bitmapEffect == nullptr) ? (ScaleMode)scaleMode : ScaleMode::None;
+    _scaleFilter = (ImageScale::Filter)scaleFilter;
+
     // Get the input/output resolution (0x0 if not specified, in which case the values from the pipeline are used)
     _inputWidthInit = GetUInt32(props, L"InputWidth", 0);
     _inputHeightInit = GetUInt32(props, L"InputHeight", 0);
     _outputWidthInit = GetUInt32(props, L"OutputWidth", 0);
     _outputHeightInit = GetUInt32(props, L"OutputHeight", 0);
 
-    Trace("Override resolutions: input %ix%i, output %ix%i", _inputWidthInit, _inputHeightInit, _outputWidthInit, _outputHeightInit);
+    Trace("Override resolutions: input %ix%i, output %ix%i, NV12: %i", _inputWidthInit, _inputHeightInit, _outputWidthInit, _outputHeightInit, _nv12);
 }
 
 vector<unsigned long> LumiaEffect::GetSupportedFormats() const
 {
     vector<unsigned long> formats;
 
+    // NV12 first: it is what decoders and cameras produce
+    if (_nv12)
+    {
+        formats.push_back(MFVideoFormat_NV12.Data1);
+    }
+
     // Imaging SDK really uses ARGB32, but most Phone 8.1 devices are lacking a DX VPBlit ARGB32 -> NV12
     // and only provide RGB32 -> NV12. On Phone 8.1 MediaComposition only uses VPBlit for color conversion
     // (no software fallback).
@@ -249,14 +301,48 @@ _Ret_maybenull_ ComPtr<IMFMediaType> LumiaEffect::_CreatePartialType(
     return type;
 }
 
-void LumiaEffect::StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/)
+void LumiaEffect::StartStreaming(_In_ unsigned long format, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/)
 {
+    _format = format;
+
     // Update input/output width/height
     CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &_inputWidth, &_inputHeight));
     CHK(MFGetAttributeSize(_outputType.Get(), MF_MT_FRAME_SIZE, &_outputWidth, &_outputHeight));
+
+    // Bands map input rows to output rows: only used without resizing. Bands are kept at least 16 rows
+    // high so the per-band overhead stays small compared to the processing.
+    unsigned int bandCount = 0;
+    if ((_bandedEffect != nullptr) && (_inputWidth == _outputWidth) && (_inputHeight == _outputHeight))
+    {
+        bandCount = _bandCountInit;
+        if (bandCount == 0)
+        {
+            SYSTEM_INFO info;
+            GetNativeSystemInfo(&info);
+            bandCount = info.dwNumberOfProcessors;
+        }
+        bandCount = max(1u, min(bandCount, _outputHeight / 16));
+    }
+    _bandCount = (long)bandCount;
+    Trace("Bitmap effect bands: %u", bandCount);
+
+    _scaleMode = ((_inputWidth != _outputWidth) || (_inputHeight != _outputHeight)) ? _scaleModeInit : ScaleMode::None;
+
+    // Render graphs are built on the first frames, once the buffer layout is known
+    _ClearRenderGraphs();
+}
+
+void LumiaEffect::EndStreaming()
+{
+    _ClearRenderGraphs();
 }
 
 bool LumiaEffect::ProcessSample(_In_ const ComPtr<IMFSample>& inputSample, _In_ const ComPtr<IMFSample>& outputSample)
+{
+    return ProcessSampleAsync(inputSample, outputSample).get(); // Blocks for the duration of processing (must be called in MTA)
+}
+
+task<bool> LumiaEffect::ProcessSampleAsync(_In_ const ComPtr<IMFSample>& inputSample, _In_ const ComPtr<IMFSample>& outputSample)
 {
     // Get the input/output buffers
     ComPtr<IMFMediaBuffer> outputBuffer;
@@ -278,40 +364,455 @@ bool LumiaEffect::ProcessSample(_In_ const ComPtr<IMFSample>& inputSample, _In_
     CHK(outputBuffer->GetMaxLength(&length));
     CHK(outputBuffer->SetCurrentLength(length));
 
-    // Create input/output IBuffer wrappers
-    ComPtr<WinRTBufferOnMF2DBuffer> outputWinRTBuffer;
-    ComPtr<WinRTBufferOnMF2DBuffer> inputWinRTBuffer;
-    CHK(MakeAndInitialize<WinRTBufferOnMF2DBuffer>(&outputWinRTBuffer, outputBuffer, MF2DBuffer_LockFlags_Write, _inputDefaultStride));
-    CHK(MakeAndInitialize<WinRTBufferOnMF2DBuffer>(&inputWinRTBuffer, inputBuffer, MF2DBuffer_LockFlags_Read, _inputDefaultStride));
-
-    // Create input/output bitmap wrappers
-    Size outputSize = { (float)_outputWidth, (float)_outputHeight };
-    Size inputSize = { (float)_inputWidth, (float)_inputHeight };
-    auto outputBitmap = ref new Bitmap(outputSize, ColorMode::Bgra8888, outputWinRTBuffer->GetStride(), outputWinRTBuffer->GetIBuffer());
-    auto inputBitmap = ref new Bitmap(inputSize, ColorMode::Bgra8888, inputWinRTBuffer->GetStride(), inputWinRTBuffer->GetIBuffer());
+    // Bind the render graph to the input/output buffers (1D input buffers are read in place, bottom-up or not)
+    // The lease keeps the graph and the locked buffers until rendering completes
+    auto lease = make_shared<RenderGraphLease>(*this);
+    RenderGraph& graph = lease->Get();
+    graph.OutputBuffer->Open(outputBuffer, MF2DBuffer_LockFlags_Write, (long)_outputDefaultStride);
+    graph.InputBuffer->Open(inputBuffer, MF2DBuffer_LockFlags_Read, _GetInputBufferStride());
+    _BindRenderGraph(graph);
 
     if (_bitmapEffect != nullptr)
     {
-        _bitmapEffect->Process(inputBitmap, outputBitmap, TimeSpan{ time });
+        // Bitmap effects expect upright bitmaps: bottom-up buffers go through flipped copies
+        if (graph.InputBottomUp)
+        {
+            _CopyFlipped(GetData(graph.InputFlipBuffer), GetData(graph.InputBuffer->GetIBuffer()), graph.InputPitch, _inputWidth, _inputHeight);
+        }
+
+        if (!graph.Bands.empty())
+        {
+            // Bands only share read-only input rows: let the ConcRT work-stealing scheduler spread them over the cores
+            TimeSpan frameTime = { time };
+            parallel_for(size_t(0), graph.Bands.size(), [this, &graph, frameTime](size_t n)
+            {
+                const RenderBand& band = graph.Bands[n];
+                _bandedEffect->ProcessBand(band.Input, band.Output, band.Row, band.InputRowOffset, frameTime);
+            });
+        }
+        else
+        {
+            _bitmapEffect->Process(
+                graph.InputBottomUp ? graph.InputFlipBitmap : graph.InputBitmap,
+                graph.OutputBottomUp ? graph.OutputFlipBitmap : graph.OutputBitmap,
+                TimeSpan{ time }
+                );
+        }
+
+        if (graph.OutputBottomUp)
+        {
+            _CopyFlipped(GetData(graph.OutputBuffer->GetIBuffer()), GetData(graph.OutputFlipBuffer), graph.OutputPitch, _outputWidth, _outputHeight);
+        }
+
+        return task_from_result(true); // Always produces data
     }
     else
     {
         if (_animatedFilters != nullptr)
         {
             _animatedFilters->UpdateTime(TimeSpan{ time });
+            _SetRenderGraphFilters(graph, _animatedFilters->Filters);
+        }
+        else if (!graph.FiltersSet)
+        {
+            _SetRenderGraphFilters(graph, graph.StaticFilters);
+        }
+
+        graph.Scale = _scaleMode;
+        graph.ScaleNv12 = (_format == MFVideoFormat_NV12.Data1);
+        graph.ScaleInputHeight = _inputHeight;
+        graph.ScaleOutputHeight = _outputHeight;
+        if (graph.Scale == ScaleMode::BeforeChain)
+        {
+            _ScaleFrame(graph);
         }
 
         // Process the bitmap
-        FilterEffect^ effect = ref new FilterEffect();
-        effect->Filters = _filters != nullptr ? _filters : _animatedFilters->Filters;
-        effect->Source = ref new BitmapImageSource(inputBitmap);
-        auto renderer = ref new BitmapRenderer(effect, outputBitmap);
-        create_task(renderer->RenderAsync()).get(); // Blocks for the duration of processing (must be called in MTA)
+        IAsyncOperation<Bitmap^>^ operation = graph.Renderer->RenderAsync();
+        long rendersInFlight = InterlockedIncrement(&_rendersInFlight);
+        long rendersInFlightMax = _rendersInFlightMax;
+        while ((rendersInFlight > rendersInFlightMax) && (InterlockedCompareExchange(&_rendersInFlightMax, rendersInFlight, rendersInFlightMax) != rendersInFlightMax))
+        {
+            rendersInFlightMax = _rendersInFlightMax;
+        }
+
+        auto render = create_task(operation).then([this, lease](task<Bitmap^> rendered) mutable
+        {
+            // Scale the chain output once rendered (rendering errors are rethrown below)
+            HRESULT hr = S_OK;
+            if (lease->Get().Scale == ScaleMode::AfterChain)
+            {
+                hr = ExceptionBoundary([&]()
+                {
+                    (void)rendered.get();
+                    _ScaleFrame(lease->Get());
+                });
+            }
+
+            // Force MF buffer unlocking (race-condition refcount leak in effects? xVP cannot always lock the buffer afterward)
+            lease.reset();
+            InterlockedDecrement(&_rendersInFlight);
+
+            (void)rendered.get(); // Rethrows rendering errors
+            CHK(hr);
+            return true; // Always produces data
+        }, task_continuation_context::use_arbitrary());
+
+        // Animated chains update their filters for each frame: one render in flight at a time
+        if (!SupportsConcurrentProcessing())
+        {
+            return task_from_result(render.get());
+        }
+        return render;
     }
+}
 
-    // Force MF buffer unlocking (race-condition refcount leak in effects? xVP cannot always lock the buffer afterward)
-    outputWinRTBuffer->Close();
-    inputWinRTBuffer->Close();
+unique_ptr<LumiaEffect::RenderGraph> LumiaEffect::_AcquireRenderGraph()
+{
+    unsigned int generation;
+    {
+        auto lock = _renderGraphLock.LockExclusive();
+        generation = _renderGraphGeneration;
+        if (!_renderGraphs.empty())
+        {
+            unique_ptr<RenderGraph> graph = move(_renderGraphs.back());
+            _renderGraphs.pop_back();
+            return graph;
+        }
+    }
+
+    // Buffer wrappers start closed and get opened on each frame
+    unique_ptr<RenderGraph> graph(new RenderGraph());
+    graph->Generation = generation;
+    graph->InputBuffer = Make<WinRTBufferOnMF2DBuffer>();
+    graph->OutputBuffer = Make<WinRTBufferOnMF2DBuffer>();
+    CHKOOM(graph->InputBuffer);
+    CHKOOM(graph->OutputBuffer);
+    InterlockedExchangeAdd64(&_renderObjectCount, 2);
+
+    // Static filter chains: the chain created at initialization goes to the first graph, the factory
+    // provides the others
+    if (_filterChainFactory != nullptr)
+    {
+        {
+            auto lock = _renderGraphLock.LockExclusive();
+            graph->StaticFilters = _filters;
+            _filters = nullptr;
+        }
+        if (graph->StaticFilters == nullptr)
+        {
+            graph->StaticFilters = _filterChainFactory();
+            CHKNULL(graph->StaticFilters);
+        }
+    }
+
+    return graph;
+}
 
-    return true; // Always produces data
+void LumiaEffect::_ReleaseRenderGraph(_In_ unique_ptr<RenderGraph> graph)
+{
+    // Graphs still rendering when streaming ended are dropped
+    auto lock = _renderGraphLock.LockExclusive();
+    if (graph->Generation == _renderGraphGeneration)
+    {
+        _renderGraphs.push_back(move(graph));
+    }
+}
+
+void LumiaEffect::_ClearRenderGraphs()
+{
+    auto lock = _renderGraphLock.LockExclusive();
+    _renderGraphs.clear();
+    _renderGraphGeneration++;
+}
+
+void LumiaEffect::_BindRenderGraph(_Inout_ RenderGraph& graph)
+{
+    unsigned int inputPitch = graph.InputBuffer->GetPitch();
+    unsigned int outputPitch = graph.OutputBuffer->GetPitch();
+    bool inputBottomUp = graph.InputBuffer->IsBottomUp();
+    bool outputBottomUp = graph.OutputBuffer->IsBottomUp();
+    if ((graph.InputBitmap != nullptr) &&
+        (inputPitch == graph.InputPitch) && (outputPitch == graph.OutputPitch) &&
+        (inputBottomUp == graph.InputBottomUp) && (outputBottomUp == graph.OutputBottomUp))
+    {
+        return;
+    }
+
+    // First frame or new buffer layout: create the bitmaps and what depends on them
+    Size outputSize = { (float)_outputWidth, (float)_outputHeight };
+    Size inputSize = { (float)_inputWidth, (float)_inputHeight };
+    graph.OutputBitmap = _CreateBitmap(graph.OutputBuffer, outputSize, outputPitch);
+    graph.InputBitmap = _CreateBitmap(graph.InputBuffer, inputSize, inputPitch);
+    graph.InputPitch = inputPitch;
+    graph.OutputPitch = outputPitch;
+    graph.InputBottomUp = inputBottomUp;
+    graph.OutputBottomUp = outputBottomUp;
+
+    if (_bitmapEffect != nullptr)
+    {
+        graph.InputFlipBitmap = inputBottomUp ? _GetFlipBitmap(&graph.InputFlipBuffer, inputSize, inputPitch) : nullptr;
+        graph.OutputFlipBitmap = outputBottomUp ? _GetFlipBitmap(&graph.OutputFlipBuffer, outputSize, outputPitch) : nullptr;
+        _CreateRenderGraphBands(graph);
+    }
+    else
+    {
+        // With the built-in scaler, the chain reads or writes the scratch frame instead of the MF buffer
+        Bitmap^ source = graph.InputBitmap;
+        Bitmap^ target = graph.OutputBitmap;
+        if (_scaleMode == ScaleMode::BeforeChain)
+        {
+            source = _CreateScaleBitmap(graph, outputSize);
+        }
+        else if (_scaleMode == ScaleMode::AfterChain)
+        {
+            target = _CreateScaleBitmap(graph, inputSize);
+        }
+
+        graph.Effect = ref new FilterEffect();
+        graph.Effect->Source = ref new BitmapImageSource(source);
+        graph.Renderer = ref new BitmapRenderer(graph.Effect, target);
+        graph.Filters.clear(); // Filter chain set by _SetRenderGraphFilters()
+        graph.FiltersSet = false;
+        InterlockedExchangeAdd64(&_renderObjectCount, 3);
+    }
+
+    InterlockedIncrement64(&_renderGraphCount);
+}
+
+void LumiaEffect::_SetRenderGraphFilters(_Inout_ RenderGraph& graph, _In_ IIterable<IFilter^>^ filters)
+{
+    // Animated chains usually update the properties of their filters: only set the chain up again
+    // when the filters themselves change
+    if (graph.FiltersSet)
+    {
+        bool same = true;
+        unsigned int index = 0;
+        for (IFilter^ filter : filters)
+        {
+            if ((index >= graph.Filters.size()) || (graph.Filters[index] != filter))
+            {
+                same = false;
+                break;
+            }
+            index++;
+        }
+        if (same && (index == graph.Filters.size()))
+        {
+            return;
+        }
+    }
+
+    vector<IFilter^> filterList;
+    for (IFilter^ filter : filters)
+    {
+        filterList.push_back(filter);
+    }
+
+    // Bottom-up buffers are read and written in place, vertical flips in the filter chain
+    // turn the images upright for the filters. Scaler scratch frames are already upright.
+    auto effectFilters = ref new Platform::Collections::Vector<IFilter^>();
+    unsigned int objectCount = 1;
+    if (graph.InputBottomUp && (_scaleMode != ScaleMode::BeforeChain))
+    {
+        effectFilters->Append(ref new FlipFilter(FlipMode::Vertical));
+        objectCount++;
+    }
+    for (IFilter^ filter : filterList)
+    {
+        effectFilters->Append(filter);
+    }
+    if (graph.OutputBottomUp && (_scaleMode != ScaleMode::AfterChain))
+    {
+        effectFilters->Append(ref new FlipFilter(FlipMode::Vertical));
+        objectCount++;
+    }
+
+    graph.Effect->Filters = effectFilters;
+    graph.Filters = move(filterList);
+    graph.FiltersSet = true;
+    InterlockedExchangeAdd64(&_renderObjectCount, objectCount);
+}
+
+void LumiaEffect::_CreateRenderGraphBands(_Inout_ RenderGraph& graph)
+{
+    graph.Bands.clear();
+    unsigned int bandCount = (unsigned int)_bandCount;
+    if (bandCount == 0)
+    {
+        return;
+    }
+
+    // Bands read and write the upright buffers: the MF buffers or their flipped copies
+    ComPtr<ABI::Windows::Storage::Streams::IBuffer> input;
+    ComPtr<ABI::Windows::Storage::Streams::IBuffer> output;
+    if (graph.InputBottomUp)
+    {
+        input = As<ABI::Windows::Storage::Streams::IBuffer>(graph.InputFlipBuffer);
+    }
+    else
+    {
+        input = graph.InputBuffer;
+    }
+    if (graph.OutputBottomUp)
+    {
+        output = As<ABI::Windows::Storage::Streams::IBuffer>(graph.OutputFlipBuffer);
+    }
+    else
+    {
+        output = graph.OutputBuffer;
+    }
+
+    unsigned int halo = _bandedEffect->HaloRows;
+    for (unsigned int n = 0; n < bandCount; n++)
+    {
+        unsigned int row = n * _outputHeight / bandCount;
+        unsigned int rowEnd = (n + 1) * _outputHeight / bandCount;
+        unsigned int inputRow = row > halo ? row - halo : 0;
+        unsigned int inputRowEnd = min(rowEnd + halo, _inputHeight);
+
+        RenderBand band;
+        band.Input = _CreateBandBitmap(input, _inputWidth, graph.InputPitch, inputRow, inputRowEnd - inputRow);
+        band.Output = _CreateBandBitmap(output, _outputWidth, graph.OutputPitch, row, rowEnd - row);
+        band.Row = row;
+        band.InputRowOffset = row - inputRow;
+        graph.Bands.push_back(band);
+    }
+}
+
+Bitmap^ LumiaEffect::_CreateScaleBitmap(_Inout_ RenderGraph& graph, _In_ Size size)
+{
+    bool nv12 = (_format == MFVideoFormat_NV12.Data1);
+    unsigned int width = (unsigned int)size.Width;
+    unsigned int height = (unsigned int)size.Height;
+    unsigned int pitch = nv12 ? width : 4 * width;
+    unsigned int capacity = nv12 ? pitch * height * 3 / 2 : pitch * height;
+    if ((graph.ScaleBuffer == nullptr) || (graph.ScaleBuffer->Capacity < capacity))
+    {
+        graph.ScaleBuffer = ref new Buffer(capacity);
+        InterlockedIncrement64(&_renderObjectCount);
+    }
+    graph.ScaleBuffer->Length = capacity;
+    graph.ScalePitch = pitch;
+
+    // Scalers hold the filter taps for the stream resolutions: RGB32 as one 4-channel plane,
+    // NV12 as a luma plane and a half-resolution 2-channel chroma plane
+    if (nv12)
+    {
+        graph.Scalers[0].Initialize(_inputWidth, _inputHeight, _outputWidth, _outputHeight, 1, _scaleFilter);
+        graph.Scalers[1].Initialize(_inputWidth / 2, _inputHeight / 2, _outputWidth / 2, _outputHeight / 2, 2, _scaleFilter);
+    }
+    else
+    {
+        graph.Scalers[0].Initialize(_inputWidth, _inputHeight, _outputWidth, _outputHeight, 4, _scaleFilter);
+    }
+
+    return _CreateBitmap(As<ABI::Windows::Storage::Streams::IBuffer>(graph.ScaleBuffer), size, pitch);
+}
+
+// Only reads the state copied into the graph: called from render continuations
+void LumiaEffect::_ScaleFrame(_Inout_ RenderGraph& graph)
+{
+    // Bottom-up RGB32 buffers are scaled from or to their last row with a negative stride,
+    // which keeps the scratch frame upright
+    const unsigned char *src;
+    unsigned char *dst;
+    long srcStride;
+    long dstStride;
+    if (graph.Scale == ScaleMode::BeforeChain)
+    {
+        srcStride = graph.InputBottomUp ? -(long)graph.InputPitch : (long)graph.InputPitch;
+        src = GetData(graph.InputBuffer->GetIBuffer()) + (graph.InputBottomUp ? graph.InputPitch * (graph.ScaleInputHeight - 1) : 0);
+        dstStride = (long)graph.ScalePitch;
+        dst = GetData(graph.ScaleBuffer);
+    }
+    else
+    {
+        srcStride = (long)graph.ScalePitch;
+        src = GetData(graph.ScaleBuffer);
+        dstStride = graph.OutputBottomUp ? -(long)graph.OutputPitch : (long)graph.OutputPitch;
+        dst = GetData(graph.OutputBuffer->GetIBuffer()) + (graph.OutputBottomUp ? graph.OutputPitch * (graph.ScaleOutputHeight - 1) : 0);
+    }
+
+    graph.Scalers[0].Scale(dst, dstStride, src, srcStride);
+    if (graph.ScaleNv12)
+    {
+        // UV plane right after the Y plane, same pitch (NV12 buffers are never bottom-up)
+        graph.Scalers[1].Scale(dst + dstStride * (long)graph.ScaleOutputHeight, dstStride, src + srcStride * (long)graph.ScaleInputHeight, srcStride);
+    }
+}
+
+void LumiaEffect::PublishStatistics(_In_ const ComPtr<IMFAttributes>& attributes) const
+{
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_RENDER_GRAPHS, (unsigned long long)_renderGraphCount));
+    CHK(attributes->SetUINT64(VE_STATISTICS_LUMIA_RENDER_OBJECTS, (unsigned long long)_renderObjectCount));
+    CHK(attributes->SetUINT32(VE_STATISTICS_LUMIA_RENDERS_IN_FLIGHT_MAX, (unsigned int)_rendersInFlightMax));
+    CHK(attributes->SetUINT32(VE_STATISTICS_LUMIA_BITMAP_EFFECT_BANDS, (unsigned int)_bandCount));
+}
+
+Bitmap^ LumiaEffect::_CreateBitmap(_In_ const ComPtr<ABI::Windows::Storage::Streams::IBuffer>& buffer, _In_ Size size, _In_ unsigned int pitch)
+{
+    if (_format != MFVideoFormat_NV12.Data1)
+    {
+        InterlockedIncrement64(&_renderObjectCount);
+        return ref new Bitmap(size, ColorMode::Bgra8888, pitch, reinterpret_cast<IBuffer^>(buffer.Get()));
+    }
+
+    // Y plane followed by the interleaved UV plane, with the same pitch. The views read the wrapper bytes
+    // on each access, so they follow the buffer the wrapper is bound to.
+    ComPtr<WinRTBufferView> bufferY;
+    ComPtr<WinRTBufferView> bufferUV;
+    CHK(MakeAndInitialize<WinRTBufferView>(&bufferY, buffer, 0));
+    CHK(MakeAndInitialize<WinRTBufferView>(&bufferUV, buffer, pitch * (unsigned int)size.Height));
+    InterlockedExchangeAdd64(&_renderObjectCount, 3);
+
+    return ref new Bitmap(
+        size,
+        ColorMode::Yuv420Sp,
+        ref new Array<unsigned int>{ pitch, pitch },
+        ref new Array<IBuffer^>{ bufferY->GetIBuffer(), bufferUV->GetIBuffer() }
+        );
+}
+
+Bitmap^ LumiaEffect::_CreateBandBitmap(
+    _In_ const ComPtr<ABI::Windows::Storage::Streams::IBuffer>& buffer,
+    _In_ unsigned int width,
+    _In_ unsigned int pitch,
+    _In_ unsigned int row,
+    _In_ unsigned int rowCount
+    )
+{
+    // Same as the NV12 planes: the view follows the buffer the wrapper is bound to
+    ComPtr<WinRTBufferView> view;
+    CHK(MakeAndInitialize<WinRTBufferView>(&view, buffer, pitch * row));
+    InterlockedExchangeAdd64(&_renderObjectCount, 2);
+
+    Size size = { (float)width, (float)rowCount };
+    return ref new Bitmap(size, ColorMode::Bgra8888, pitch, view->GetIBuffer());
+}
+
+Bitmap^ LumiaEffect::_GetFlipBitmap(_Inout_ Buffer^* buffer, _In_ Size size, _In_ unsigned int pitch)
+{
+    unsigned int capacity = pitch * (unsigned int)size.Height;
+    if ((*buffer == nullptr) || ((*buffer)->Capacity < capacity))
+    {
+        *buffer = ref new Buffer(capacity);
+        InterlockedIncrement64(&_renderObjectCount);
+    }
+    (*buffer)->Length = capacity;
+
+    InterlockedIncrement64(&_renderObjectCount);
+    return ref new Bitmap(size, ColorMode::Bgra8888, pitch, *buffer);
+}
+
+void LumiaEffect::_CopyFlipped(
+    _Out_ unsigned char *dst,
+    _In_ const unsigned char *src,
+    _In_ unsigned int pitch,
+    _In_ unsigned int width,
+    _In_ unsigned int height
+    )
+{
+    ImageCopy::CopyRows(dst, pitch, src + pitch * (height - 1), -(long)pitch, 4 * width, height);
+    _RecordCopy(4ull * width * height);
 }
@@ -27,6 +27,18 @@ public:
         , _inputHeight(0)
         , _outputWidth(0)
         , _outputHeight(0)
+        , _format(0)
+        , _nv12(false)
+        , _bandCountInit(0)
+        , _scaleModeInit(ScaleMode::None)
+        , _scaleFilter(ImageScale::Filter::Bicubic)
+        , _scaleMode(ScaleMode::None)
+        , _bandCount(0)
+        , _renderGraphCount(0)
+        , _renderObjectCount(0)
+        , _renderGraphGeneration(0)
+        , _rendersInFlight(0)
+        , _rendersInFlightMax(0)
     {
     }
 
@@ -46,10 +58,144 @@ public:
 
     // Data processing
     virtual void StartStreaming(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height) override;
+    virtual void EndStreaming() override;
     virtual bool ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample) override;
 
+    // Static filter chains return as soon as rendering is submitted, so asynchronous mode keeps several renders in flight
+    virtual concurrency::task<bool> ProcessSampleAsync(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample) override;
+
+    // Static filter chains render with one chain per render graph, animated chains and bitmap effects carry per-frame state
+    virtual bool SupportsConcurrentProcessing() const override
+    {
+        return _filterChainFactory != nullptr;
+    }
+
+    // Statistics
+    virtual void PublishStatistics(_In_ const Microsoft::WRL::ComPtr<IMFAttributes>& attributes) const override;
+
 private:
 
+    // Values of the "Scaler" property
+    enum class ScaleMode
+    {
+        None,        // The filter chain resizes frames
+        BeforeChain, // The chain runs on the output resolution
+        AfterChain   // The chain runs on the input resolution
+    };
+
+    // Horizontal band of a frame processed by a banded bitmap effect: views over the rows of the frame bitmaps
+    struct RenderBand
+    {
+        Lumia::Imaging::Bitmap^ Input; // Band plus halo rows
+        Lumia::Imaging::Bitmap^ Output;
+        unsigned int Row;
+        unsigned int InputRowOffset;
+    };
+
+    // Lumia objects rendering the frames of a stream, reused from one frame to the next: only the MF buffers
+    // under the bitmaps change. One graph per frame in flight.
+    struct RenderGraph
+    {
+        RenderGraph()
+            : Generation(0)
+            , InputPitch(0)
+            , OutputPitch(0)
+            , InputBottomUp(false)
+            , OutputBottomUp(false)
+            , FiltersSet(false)
+            , Scale(ScaleMode::None)
+            , ScaleNv12(false)
+            , ScaleInputHeight(0)
+            , ScaleOutputHeight(0)
+            , ScalePitch(0)
+        {
+        }
+
+        unsigned int Generation; // See _renderGraphGeneration
+        Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer> InputBuffer;
+        Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer> OutputBuffer;
+
+        // Buffer layout the bitmaps were created for
+        unsigned int InputPitch;
+        unsigned int OutputPitch;
+        bool InputBottomUp;
+        bool OutputBottomUp;
+
+        // The bitmaps of bottom-up buffers hold the image upside down
+        Lumia::Imaging::Bitmap^ InputBitmap;
+        Lumia::Imaging::Bitmap^ OutputBitmap;
+
+        // Filter chains: the filters the effect was last set up with, vertical flips excluded. Static chains
+        // are owned by the graph, filters not being safe to share among concurrent renders.
+        Windows::Foundation::Collections::IIterable<Lumia::Imaging::IFilter^>^ StaticFilters;
+        std::vector<Lumia::Imaging::IFilter^> Filters;
+        bool FiltersSet;
+        Lumia::Imaging::FilterEffect^ Effect;
+        Lumia::Imaging::BitmapRenderer^ Renderer;
+
+        // Bitmap effects: upright scratch bitmaps for bottom-up buffers (null for top-down ones)
+        Windows::Storage::Streams::Buffer^ InputFlipBuffer;
+        Windows::Storage::Streams::Buffer^ OutputFlipBuffer;
+        Lumia::Imaging::Bitmap^ InputFlipBitmap;
+        Lumia::Imaging::Bitmap^ OutputFlipBitmap;
+
+        // Banded bitmap effects: bands over the upright bitmaps, top to bottom
+        std::vector<RenderBand> Bands;
+
+        // Built-in scaler: stream state copied when the frame is submitted, as scaling after the chain runs
+        // once rendering completes, possibly after streaming restarted
+        ScaleMode Scale;
+        bool ScaleNv12;
+        unsigned int ScaleInputHeight;
+        unsigned int ScaleOutputHeight;
+
+        // Built-in scaler: upright scratch frame on the filter-chain side of the scaler, one scaler per plane
+        Windows::Storage::Streams::Buffer^ ScaleBuffer;
+        unsigned int ScalePitch;
+        ImageScale::Scaler Scalers[2];
+    };
+
+    // Takes a render graph from the cache for the duration of a frame, closes its buffers and returns it afterward
+    class RenderGraphLease
+    {
+    public:
+
+        explicit RenderGraphLease(_In_ LumiaEffect& effect)
+            : _effect(effect)
+            , _graph(effect._AcquireRenderGraph())
+        {
+        }
+
+        ~RenderGraphLease()
+        {
+            _graph->OutputBuffer->Close();
+            _graph->InputBuffer->Close();
+            _effect._ReleaseRenderGraph(std::move(_graph));
+        }
+
+        RenderGraph& Get()
+        {
+            return *_graph;
+        }
+
+    private:
+
+        RenderGraphLease(const RenderGraphLease&);
+        RenderGraphLease& operator=(const RenderGraphLease&);
+
+        LumiaEffect& _effect;
+        std::unique_ptr<RenderGraph> _graph;
+    };
+
+    std::unique_ptr<RenderGraph> _AcquireRenderGraph();
+    void _ReleaseRenderGraph(_In_ std::unique_ptr<RenderGraph> graph);
+    void _ClearRenderGraphs();
+    void _BindRenderGraph(_Inout_ RenderGraph& graph);
+    void _SetRenderGraphFilters(_Inout_ RenderGraph& graph, _In_ Windows::Foundation::Collections::IIterable<Lumia::Imaging::IFilter^>^ filters);
+    void _CreateRenderGraphBands(_Inout_ RenderGraph& graph);
+    Lumia::Imaging::Bitmap^ _CreateScaleBitmap(_Inout_ RenderGraph& graph, _In_ Windows::Foundation::Size size);
+    void _ScaleFrame(_Inout_ RenderGraph& graph);
+
     bool _IsValidType(
         _In_ const Microsoft::WRL::ComPtr<IMFMediaType> &type,
         unsigned int width,
@@ -66,6 +212,36 @@ private:
         unsigned int framerateDenom // 0 if no framerate
         ) const;
 
+    // Bgra8888 bitmap for RGB32 streams, Yuv420Sp bitmap over Y/UV views for NV12 streams
+    Lumia::Imaging::Bitmap^ _CreateBitmap(
+        _In_ const Microsoft::WRL::ComPtr<ABI::Windows::Storage::Streams::IBuffer>& buffer,
+        _In_ Windows::Foundation::Size size,
+        _In_ unsigned int pitch
+        );
+
+    // Bgra8888 bitmap over rows of a buffer
+    Lumia::Imaging::Bitmap^ _CreateBandBitmap(
+        _In_ const Microsoft::WRL::ComPtr<ABI::Windows::Storage::Streams::IBuffer>& buffer,
+        _In_ unsigned int width,
+        _In_ unsigned int pitch,
+        _In_ unsigned int row,
+        _In_ unsigned int rowCount
+        );
+
+    // Upright scratch bitmaps for bitmap effects processing bottom-up buffers
+    Lumia::Imaging::Bitmap^ _GetFlipBitmap(
+        _Inout_ Windows::Storage::Streams::Buffer^* buffer,
+        _In_ Windows::Foundation::Size size,
+        _In_ unsigned int pitch
+        );
+    void _CopyFlipped(
+        _Out_ unsigned char *dst,
+        _In_ const unsigned char *src,
+        _In_ unsigned int pitch,
+        _In_ unsigned int width,
+        _In_ unsigned int height
+        );
+
     unsigned int _inputWidthInit;
     unsigned int _inputHeightInit;
     unsigned int _outputWidthInit;
@@ -74,10 +250,30 @@ private:
     unsigned int _inputHeight;
     unsigned int _outputWidth;
     unsigned int _outputHeight;
+    unsigned long _format; // Subtype of the current stream (Data1)
+    bool _nv12; // NV12 offered during negotiation, see the "Nv12" property
 
-    Windows::Foundation::Collections::IIterable<Lumia::Imaging::IFilter^>^ _filters;
+    std::function<Windows::Foundation::Collections::IIterable<Lumia::Imaging::IFilter^>^()> _filterChainFactory; // Static chains
+    Windows::Foundation::Collections::IIterable<Lumia::Imaging::IFilter^>^ _filters; // Created at initialization, until taken by a render graph
     VideoEffects::IAnimatedFilterChain^ _animatedFilters;
     VideoEffects::IBitmapVideoEffect^ _bitmapEffect;
+    VideoEffects::IBandedBitmapVideoEffect^ _bandedEffect; // Same object as _bitmapEffect if it supports bands
+    unsigned int _bandCountInit; // See the "BitmapEffectBands" property
+    ScaleMode _scaleModeInit;
+    ImageScale::Filter _scaleFilter;
+    ScaleMode _scaleMode; // None when the stream does not change the resolution
+
+    // Render graphs not in use, see RenderGraph
+    std::vector<std::unique_ptr<RenderGraph>> _renderGraphs;
+    Microsoft::WRL::Wrappers::SRWLock _renderGraphLock;
+    unsigned int _renderGraphGeneration; // Incremented when the cache is cleared
+
+    // Statistics, updated atomically
+    volatile long long _renderGraphCount;
+    volatile long long _renderObjectCount;
+    volatile long _rendersInFlight;
+    volatile long _rendersInFlightMax;
+    volatile long _bandCount; // Bands per frame in the current stream, 0 if not banded
 };
 
 ActivatableClass(LumiaEffect);
\ No newline at end of file
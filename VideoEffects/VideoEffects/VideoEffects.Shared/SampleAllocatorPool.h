@@ -0,0 +1,168 @@
+#pragma once
+
+//
+// A video sample allocator which keeps track of the number of samples in use
+//
+// The count is incremented when samples are allocated and decremented when IMFVideoSampleAllocatorNotify
+// reports them returned to the pool. The high-water mark of samples in use lets the owner size the next
+// pool to the actual demand instead of a worst-case guess.
+//
+// To shrink a pool, create a new one and delete the old one: samples still in use keep the old
+// allocator alive until they are returned, at which point it releases all its samples.
+//
+// A pool created small can be grown on the thread pool with PrewarmAsync(), which keeps sample creation
+// (and D3D texture creation) off the streaming thread.
+//
+class SampleAllocatorPool
+{
+public:
+
+    SampleAllocatorPool(_In_opt_ const Microsoft::WRL::ComPtr<IMFDXGIDeviceManager>& deviceManager)
+        : _maxSize(0)
+    {
+        CHK(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&_allocator)));
+        if (deviceManager != nullptr)
+        {
+            CHK(_allocator->SetDirectXManager(deviceManager.Get()));
+        }
+
+        _counter = Microsoft::WRL::Make<Counter>();
+        CHKOOM(_counter);
+        CHK(_allocator.As(&_allocatorCallback));
+        CHK(_allocatorCallback->SetCallback(_counter.Get()));
+    }
+
+    // Returns an error without throwing so callers can retry with different attributes
+    HRESULT Initialize(
+        _In_ unsigned int initialSize,
+        _In_ unsigned int maxSize,
+        _In_opt_ IMFAttributes *attributes,
+        _In_ IMFMediaType *type
+        )
+    {
+        HRESULT hr = _allocator->InitializeSampleAllocatorEx(initialSize, maxSize, attributes, type);
+        if (SUCCEEDED(hr))
+        {
+            _maxSize = maxSize;
+        }
+        return hr;
+    }
+
+    HRESULT AllocateSample(_COM_Outptr_ IMFSample **sample)
+    {
+        HRESULT hr = _allocator->AllocateSample(sample);
+        if (SUCCEEDED(hr))
+        {
+            _counter->OnAllocate();
+        }
+        return hr;
+    }
+
+    // Allocates and returns up to 'count' samples on the thread pool so they are ready when needed.
+    // 'reservedCount' samples are left for the streaming thread to allocate while prewarming: the
+    // prewarm is skipped when the pool has no room beyond them.
+    // Prewarmed samples do not count towards the in-use high-water mark.
+    void PrewarmAsync(_In_ unsigned int count, _In_ unsigned int reservedCount)
+    {
+        count = (_maxSize > reservedCount) ? min(count, _maxSize - reservedCount) : 0;
+        if (count == 0)
+        {
+            return;
+        }
+
+        Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> allocator = _allocator;
+        Microsoft::WRL::ComPtr<Counter> counter = _counter;
+        Windows::System::Threading::ThreadPool::RunAsync(ref new Windows::System::Threading::WorkItemHandler(
+            [allocator, counter, count](Windows::Foundation::IAsyncAction^)
+        {
+            std::vector<Microsoft::WRL::ComPtr<IMFSample>> samples;
+            samples.reserve(count);
+            for (unsigned int n = 0; n < count; n++)
+            {
+                Microsoft::WRL::ComPtr<IMFSample> sample;
+                InterlockedIncrement(&counter->PrewarmCount);
+                if (FAILED(allocator->AllocateSample(&sample)))
+                {
+                    InterlockedDecrement(&counter->PrewarmCount);
+                    break; // Pool exhausted by the streaming thread, or shut down
+                }
+                InterlockedIncrement(&counter->InUseCount);
+                samples.push_back(sample);
+            }
+
+            long prewarmed = (long)samples.size();
+            samples.clear(); // Returned to the pool, NotifyRelease() decrements InUseCount
+            InterlockedExchangeAdd(&counter->PrewarmCount, -prewarmed);
+        }));
+    }
+
+    unsigned int GetInUseCount() const
+    {
+        return (unsigned int)_counter->InUseCount;
+    }
+
+    unsigned int GetInUseCountMax() const
+    {
+        return (unsigned int)_counter->InUseCountMax;
+    }
+
+    unsigned int GetFreeCount() const
+    {
+        long count = 0;
+        return SUCCEEDED(_allocatorCallback->GetFreeSampleCount(&count)) ? (unsigned int)count : 0;
+    }
+
+    unsigned int GetMaxSize() const
+    {
+        return _maxSize;
+    }
+
+private:
+
+    SampleAllocatorPool(const SampleAllocatorPool&);
+    SampleAllocatorPool& operator=(const SampleAllocatorPool&);
+
+    // Separate object held by the allocator, so the allocator does not keep the pool alive
+    class Counter WrlSealed : public Microsoft::WRL::RuntimeClass<
+        Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::ClassicCom>,
+        IMFVideoSampleAllocatorNotify,
+        Microsoft::WRL::FtmBase
+        >
+    {
+    public:
+
+        Counter()
+            : InUseCount(0)
+            , InUseCountMax(0)
+            , PrewarmCount(0)
+        {
+        }
+
+        void OnAllocate()
+        {
+            long inUseCount = InterlockedIncrement(&InUseCount) - PrewarmCount;
+
+            long inUseCountMax = InUseCountMax;
+            while ((inUseCount > inUseCountMax) &&
+                (InterlockedCompareExchange(&InUseCountMax, inUseCount, inUseCountMax) != inUseCountMax))
+            {
+                inUseCountMax = InUseCountMax;
+            }
+        }
+
+        IFACEMETHOD(NotifyRelease)() override
+        {
+            InterlockedDecrement(&InUseCount);
+            return S_OK;
+        }
+
+        volatile long InUseCount;
+        volatile long InUseCountMax;
+        volatile long PrewarmCount; // Samples held by PrewarmAsync()
+    };
+
+    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> _allocator;
+    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorCallback> _allocatorCallback;
+    Microsoft::WRL::ComPtr<Counter> _counter;
+    unsigned int _maxSize;
+};
@@ -70,6 +70,7 @@ HRESULT ShaderEffect::UpdateShaders(_In_ IBuffer^ bufferShader0, _In_opt_ IBuffe
     return ExceptionBoundary([=]()
     {
         auto lock = _lock.LockExclusive();
+        auto processingLock = _processingLock.LockExclusive(); // Not while ProcessSample() runs on a worker thread
 
         Trace("@%p shader buffers: @%p, @%p", this, (void*)bufferShader0, (void*)bufferShader1);
 
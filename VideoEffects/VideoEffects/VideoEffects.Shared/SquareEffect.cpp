@@ -28,6 +28,8 @@ vector<unsigned long> SquareEffect::GetSupportedFormats() const
     formats.push_back(MFVideoFormat_420O.Data1);
     formats.push_back(MFVideoFormat_YUY2.Data1);
     formats.push_back(MFVideoFormat_YV12.Data1);
+    formats.push_back(MFVideoFormat_I420.Data1);
+    formats.push_back(MFVideoFormat_IYUV.Data1);
     formats.push_back(MFVideoFormat_RGB32.Data1);
     formats.push_back(MFVideoFormat_ARGB32.Data1);
 
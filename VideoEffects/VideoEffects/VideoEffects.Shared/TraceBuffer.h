@@ -0,0 +1,176 @@
+#pragma once
+
+//
+// Per-thread ring buffers of binary trace records, for per-frame events
+//
+// Writing a record costs a QueryPerformanceCounter() call and a few stores: no formatting, no lock.
+// Each thread owns its ring (allocated on first use and never freed) so writers never contend.
+// Recording is off by default since each thread writing records keeps its 40 KB ring for the life of the
+// process. Write() and WriteSample() record once SetEnabled() turns recording on for the whole process;
+// Append() and AppendSample() always record, for callers with their own switch (the "FrameTracing" effect property).
+// The rings are chained in a global list which can be walked from a memory dump, or copied by
+// TraceBuffer::Collect(). Records are decoded offline using the TraceEvent values below.
+//
+
+enum class TraceEvent : unsigned int
+{
+    None = 0,
+    ProcessInput,   // Object: effect, Value0: sample time, Value1: sample duration
+    ProcessOutput,  // Object: effect, Value0: sample time, Value1: sample duration
+    InputRejected,  // Object: effect, Value0: sample time, Value1: sample duration
+    FrameDropped,   // Object: effect, Value0: sample time, Value1: sample duration
+};
+
+struct TraceRecord
+{
+    long long Timestamp; // QueryPerformanceCounter() ticks
+    const void *Object;
+    long long Value0;
+    long long Value1;
+    TraceEvent Event;
+    unsigned int ThreadId;
+};
+
+class TraceBuffer
+{
+public:
+
+    static const unsigned int RecordCount = 1024; // Per thread, power of 2
+
+    struct Ring
+    {
+        Ring *Next;
+        unsigned int ThreadId;
+        unsigned int WriteCount;
+        TraceRecord Records[RecordCount];
+    };
+
+    static bool IsEnabled()
+    {
+        return *_GetEnabled() != 0;
+    }
+
+    static void SetEnabled(_In_ bool enabled)
+    {
+        InterlockedExchange(_GetEnabled(), enabled ? 1 : 0);
+    }
+
+    static void Write(_In_ TraceEvent event, _In_opt_ const void *object, _In_ long long value0, _In_ long long value1)
+    {
+        if (IsEnabled())
+        {
+            Append(event, object, value0, value1);
+        }
+    }
+
+    static void WriteSample(_In_ TraceEvent event, _In_opt_ const void *object, _In_opt_ IMFSample *sample)
+    {
+        if (IsEnabled())
+        {
+            AppendSample(event, object, sample);
+        }
+    }
+
+    static void Append(_In_ TraceEvent event, _In_opt_ const void *object, _In_ long long value0, _In_ long long value1)
+    {
+        Ring *ring = *_GetCurrentRing();
+        if (ring == nullptr)
+        {
+            ring = _CreateRing();
+            if (ring == nullptr)
+            {
+                return;
+            }
+        }
+
+        LARGE_INTEGER timestamp;
+        (void)QueryPerformanceCounter(&timestamp);
+
+        TraceRecord& record = ring->Records[ring->WriteCount & (RecordCount - 1)];
+        record.Timestamp = timestamp.QuadPart;
+        record.Object = object;
+        record.Value0 = value0;
+        record.Value1 = value1;
+        record.Event = event;
+        record.ThreadId = ring->ThreadId;
+
+        ring->WriteCount++;
+    }
+
+    static void AppendSample(_In_ TraceEvent event, _In_opt_ const void *object, _In_opt_ IMFSample *sample)
+    {
+        long long time = -1;
+        long long duration = -1;
+        if (sample != nullptr)
+        {
+            (void)sample->GetSampleTime(&time);
+            (void)sample->GetSampleDuration(&duration);
+        }
+
+        Append(event, object, time, duration);
+    }
+
+    // Copies the records of all the threads, oldest first per thread.
+    // Records being written during the copy may be inconsistent.
+    static std::vector<TraceRecord> Collect()
+    {
+        std::vector<TraceRecord> records;
+
+        for (Ring *ring = *_GetRings(); ring != nullptr; ring = ring->Next)
+        {
+            unsigned int writeCount = ring->WriteCount;
+            unsigned int count = min(writeCount, RecordCount);
+            for (unsigned int n = writeCount - count; n != writeCount; n++)
+            {
+                records.push_back(ring->Records[n & (RecordCount - 1)]);
+            }
+        }
+
+        return records;
+    }
+
+private:
+
+    // Function-local statics in inline functions have a single instance across translation units.
+    // They are constant-initialized, so no thread-safe initialization is needed.
+
+    static volatile long* _GetEnabled()
+    {
+        static volatile long s_enabled = 0;
+        return &s_enabled;
+    }
+
+    static Ring* volatile* _GetRings()
+    {
+        static Ring* volatile s_rings = nullptr;
+        return &s_rings;
+    }
+
+    static Ring** _GetCurrentRing()
+    {
+        __declspec(thread) static Ring* t_ring = nullptr;
+        return &t_ring;
+    }
+
+    static Ring* _CreateRing()
+    {
+        Ring *ring = new (std::nothrow) Ring();
+        if (ring == nullptr)
+        {
+            return nullptr;
+        }
+        ring->ThreadId = GetCurrentThreadId();
+
+        // Lock-free push to the head of the global list
+        Ring* volatile* rings = _GetRings();
+        Ring *head;
+        do
+        {
+            head = *rings;
+            ring->Next = head;
+        } while (InterlockedCompareExchangePointer(reinterpret_cast<void* volatile*>(rings), ring, head) != head);
+
+        *_GetCurrentRing() = ring;
+        return ring;
+    }
+};
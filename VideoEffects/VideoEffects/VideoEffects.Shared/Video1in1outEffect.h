@@ -24,6 +24,7 @@
 //        // Optional overrides - data processing
 //        virtual void StartStreaming(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height);
 //        virtual void EndStreaming();
+//        virtual void OnFormatChanged(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height); // Media types changed while streaming
 //
 //        // Optional overrides - format management
 //        virtual _Ret_maybenull_ Microsoft::WRL::ComPtr<IMFMediaType> CreateInputAvailableType(_In_ unsigned int typeIndex) const;
@@ -33,11 +34,92 @@
 //        virtual bool IsFormatSupported(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height) const;
 //        virtual void ValidateDeviceManager(_In_ const Microsoft::WRL::ComPtr<IMFDXGIDeviceManager>& deviceManager) const; // for D3DAware effects to check DX device caps
 //
+//        // Optional overrides - asynchronous mode
+//        virtual bool SupportsConcurrentProcessing() const; // true if ProcessSample() can run on several threads at once
+//        virtual concurrency::task<bool> ProcessSampleAsync(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample); // ProcessSample() completing in the background
+//
+//        // Optional overrides - QoS
+//        virtual bool ProcessSampleReducedQuality(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample); // Cheaper ProcessSample() for late frames
+//
+//        // Optional overrides - statistics
+//        virtual void PublishStatistics(_In_ const Microsoft::WRL::ComPtr<IMFAttributes>& attributes) const; // Effect-specific statistics, see EffectStatistics.h
+//
 //    };
 //
 //ActivatableClass(PluginEffect);
 //
-// Note: when the derived methods are called, the base-class lock is taken.
+// Note: when the derived methods are called, base-class locks are taken. There are three of them, always taken in
+// this order:
+//    _streamingLock: sample queues, held by ProcessInput(), ProcessOutput(), and ProcessMessage().
+//    _lock: media types and other state read by queries, which only take it shared. The state is only written
+//        with both _streamingLock and _lock held exclusively, so the streaming path reads it without taking _lock.
+//    _processingLock: held while ProcessSample(), StartStreaming(), or EndStreaming() run.
+// _typeCacheLock is a leaf lock protecting the media-type negotiation cache, never held while calling derived methods.
+// In asynchronous mode ProcessSample() runs on a worker thread holding only _processingLock.
+//
+// The following properties are read by the base class from the property set passed to SetProperties():
+//
+//    "InputQueueSize" (UInt32, default 1): number of input samples accepted before output must be pulled.
+//        Output is ready as soon as a sample is queued, so larger values absorb bursts from the upstream
+//        component without delaying frames.
+//    "AsyncFramesInFlight" (UInt32, default 0): when non-zero the effect runs as an asynchronous MFT
+//        (MF_TRANSFORM_ASYNC) with ProcessSample() called on the thread pool and up to that many frames
+//        in flight. Output order always matches input order. Effects whose processing completes in the background
+//        (see ProcessSampleAsync()) keep that many frames in flight without blocking a thread per frame.
+//    "SampleAllocatorInitialSize" (UInt32, default 1): minimum number of samples allocated when streaming starts.
+//        Pools start larger when more samples are expected in flight (queue size, async frames) or were seen
+//        in use during a previous streaming session.
+//    "SampleAllocatorMaxSize" (UInt32, default 50): maximum number of samples in each of the input and output pools.
+//        It must cover the samples held at once by the effect: queued and in-flight frames, plus one more frame
+//        when deinterlacing (two when motion-adaptive). The default is raised to that number if needed.
+//    "QosPolicy" (UInt32, default 0): what to do with frames which cannot be processed within the latency budget.
+//        0: process all the frames, 1: drop late frames, 2: pass late frames through unprocessed (falls back to
+//        dropping when input and output formats differ), 3: call ProcessSampleReducedQuality() on late frames.
+//        The output following dropped frames is marked with MFSampleExtension_Discontinuity.
+//    "QosLatencyBudget" (UInt32, default 100): latency budget in milliseconds. A frame is late when processing
+//        starts more than that after its presentation time, as extrapolated from the arrival time of the first
+//        sample (the effect does not see the presentation clock). Only meant for real-time sources like MediaCapture:
+//        in transcodes slower than real time every frame would be late.
+//    "Deinterlace" (UInt32, default 0): what to do with interlaced NV12, YUY2, and UYVY content. 0: reject it,
+//        1: bob (rebuild the rows of one field from the other), 2: motion adaptive (weave static areas, bob moving ones).
+//        Deinterlacing happens in ProcessInput(), so ProcessSample() only sees progressive frames, and the output
+//        media type is progressive. One output frame is produced per input frame (no field-rate doubling).
+//        Frames in GPU textures (D3D-aware effects) are passed on still interlaced: reading them back would cost more
+//        than the deinterlacing itself.
+//    "FrameTracing" (UInt32, default 0): per-frame tracing of this effect instance. 0: off, 1: binary records in the
+//        TraceBuffer rings (see TraceBuffer.h), 2: also verbose text traces to the debugger (debug builds only).
+//    "Prewarm" (UInt32, default 0): when to create the streaming resources. 0: on the calling thread when streaming
+//        begins or the first frame arrives, 1: on the thread pool when streaming begins, 2: on the thread pool as soon
+//        as both media types are set.
+//
+// On Windows Phone the pools are recreated with their minimum size when app memory usage becomes high.
+//
+// Input samples are normalized to a single 2D buffer for the formats whose plane layout is described in VideoFormat.h
+// (NV12, I420/IYUV, YV12, YUY2, UYVY, RGB32, ARGB32). Other formats are only accepted by pass-through effects.
+// RGB buffers may be bottom-up (negative MF_MT_DEFAULT_STRIDE or 2D buffers with a negative pitch). Effects which set
+// _inPlaceRgbInput receive RGB input buffers as they come, 1D or 2D, and read them in place using signed strides
+// (see _GetInputBufferStride() and WinRTBufferOnMF2DBuffer), which saves the normalization copy of 1D buffers.
+//
+// Media-type negotiation is memoized: the results of CreateInputAvailableType(), CreateOutputAvailableType(),
+// IsValidInputType(), and IsValidOutputType() are cached until a media type is set or SetProperties() is called.
+// Effects whose negotiation depends on other state must call _InvalidateTypeCache() when that state changes.
+//
+// Media types changed while streaming (resolution switches of adaptive streams for instance) do not restart the effect
+// when the subtype stays the same. Sample pools are kept if their frames still fit, otherwise replaced by small pools grown
+// on the thread pool. If the output type no longer matches, ProcessOutput() returns MF_E_TRANSFORM_STREAM_CHANGE until
+// the client sets a new one. The effect then gets OnFormatChanged(), which defaults to EndStreaming() + StartStreaming().
+//
+// Streaming resources (sample pools and whatever StartStreaming() creates) can be built on the thread pool when
+// MFT_MESSAGE_NOTIFY_BEGIN_STREAMING is received, or as soon as both media types are set (opt-in, see the "Prewarm" property).
+// The work item holds the streaming lock, so the first frame waits for it rather than starting streaming a second time.
+//
+// Each effect instance records latency histograms (see LatencyHistogram.h) for input normalization, sample allocation,
+// ProcessSample(), lock waits, and the time frames wait in the effect, along with the number of frame copies and the
+// bytes they moved. Effects report the copies they make themselves via _RecordCopy(). The results are published with
+// the other statistics (see EffectStatistics.h). A JSON dump of the histograms is published in VE_STATISTICS_LATENCY_JSON
+// when streaming ends.
+//
+// Effects also implement IVideoEffectStage, which lets CompositeEffect run several of them inside a single MFT.
 //
 // The following XML snippet needs to be added to Package.appxmanifest:
 //
@@ -54,8 +136,14 @@
 #pragma warning(push)
 #pragma warning(disable:4127) // Warning: C4127 "conditional expression is constant".
 
+#include "EffectStatistics.h"
+#include "Deinterlace.h"
+#include "ImageCopy.h"
+#include "LatencyHistogram.h"
 #include "MediaTypeFormatter.h"
+#include "SampleAllocatorPool.h"
 #include "SampleFormatter.h"
+#include "VideoFormat.h"
 
 // Bring definitions from d3d11.h when app does not use D3D
 #ifndef __d3d11_h__
@@ -81,12 +169,29 @@ typedef enum D3D11_BIND_FLAG
 } D3D11_BIND_FLAG; 
 #endif
 
+// Lets CompositeEffect drive an effect as one of its stages: the effect processes samples provided by the composite,
+// bypassing its own sample queues, sample allocators, and input normalization.
+// The composite sets the stage media types via IMFTransform before calling StartStage().
+MIDL_INTERFACE("{B88E807B-36BD-4162-BC1C-A7B7725B18EB}")
+IVideoEffectStage : public IUnknown
+{
+    // Pass-through stages only read the samples, ProcessStage() ignores their output sample
+    IFACEMETHOD_(bool, IsPassThroughStage)() = 0;
+
+    IFACEMETHOD(StartStage)(_In_opt_ IMFDXGIDeviceManager *deviceManager) = 0;
+    IFACEMETHOD(ProcessStage)(_In_ IMFSample *inputSample, _In_opt_ IMFSample *outputSample, _Out_ bool *producedData) = 0;
+    IFACEMETHOD(EndStage)() = 0;
+};
+
 // Note: this base MFT is always D3D aware because on Phone 8.1 MediaComposition 
 // requires all effects to be D3D aware
 class Video1in1outEffect : public Microsoft::WRL::Implements<
     Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::RuntimeClassType::WinRtClassicComMix>,
     ABI::Windows::Media::IMediaExtension,
     Microsoft::WRL::CloakedIid<IMFTransform>,
+    Microsoft::WRL::CloakedIid<IMFMediaEventGenerator>,
+    Microsoft::WRL::CloakedIid<IMFShutdown>,
+    Microsoft::WRL::CloakedIid<IVideoEffectStage>,
     Microsoft::WRL::FtmBase
     >
 {
@@ -97,10 +202,74 @@ public:
         : _streaming(false)
         , _inputProgressive(false)
         , _inputDefaultStride(0)
+        , _inputBottomUp(false)
         , _inputDefaultSize(0)
         , _outputDefaultStride(0)
         , _outputDefaultSize(0)
         , _passthrough(false)
+        , _inPlaceRgbInput(false)
+        , _stage(false)
+        , _draining(false)
+        , _inputQueueSize(1)
+        , _inputQueueDepthMax(0)
+        , _inputSampleCount(0)
+        , _inputSampleRejectedCount(0)
+        , _outputSampleCount(0)
+        , _asyncFramesInFlight(0)
+        , _asyncStarted(false)
+        , _inputRequestCount(0)
+        , _processingGeneration(0)
+        , _shutdown(false)
+        , _asyncFramesInFlightMax(0)
+        , _stateLockContentionCount(0)
+        , _streamingLockContentionCount(0)
+        , _typeCacheHitCount(0)
+        , _typeCacheMissCount(0)
+        , _allocatorInitialSize(1)
+        , _allocatorMaxSize(50)
+        , _inputAllocatorInUseMax(0)
+        , _outputAllocatorInUseMax(0)
+        , _allocatorTrimCount(0)
+        , _memoryPressure(false)
+        , _normalizeNoneCount(0)
+        , _normalizeZeroCopyCount(0)
+        , _normalizeGatherCount(0)
+        , _normalizeContiguousCount(0)
+        , _normalize1DTo2DCount(0)
+        , _normalizeTextureCopyCount(0)
+        , _qosPolicy(QosPolicy::None)
+        , _qosLatencyBudget(0)
+        , _qosCanPassThrough(false)
+        , _qosClockValid(false)
+        , _qosClockSystemTime(0)
+        , _qosClockSampleTime(0)
+        , _qosDiscontinuity(false)
+        , _qosProcessedCount(0)
+        , _qosDroppedCount(0)
+        , _qosPassedThroughCount(0)
+        , _qosReducedQualityCount(0)
+        , _qosLatenessMax(0)
+        , _deinterlaceMode(DeinterlaceMode::None)
+        , _inputInterlaceMode(MFVideoInterlace_Progressive)
+        , _deinterlacing(false)
+        , _deinterlacePreviousBottomFieldFirst(false)
+        , _deinterlaceFrameCount(0)
+        , _deinterlaceTime(0)
+        , _formatChangePending(false)
+        , _formatChangeCount(0)
+        , _formatChangeAllocatorReuseCount(0)
+        , _prewarmMode(PrewarmMode::None)
+        , _prewarmGeneration(0)
+        , _prewarmCount(0)
+        , _firstFrameStartTime(0)
+        , _firstFrameOutput(false)
+        , _traceRecords(false)
+        , _traceVerbose(false)
+        , _firstFrameLatency(0)
+        , _streamingStartTime(0)
+        , _copyCount(0)
+        , _copyBytes(0)
+        , _latencyRecordCount(-1)
     {
     }
 
@@ -127,10 +296,93 @@ public:
     {
         return ExceptionBoundary([this, propertySet]()
         {
-            Initialize(
-                safe_cast<Windows::Foundation::Collections::IMap<Platform::String^, Platform::Object^>^>(
+            auto props = safe_cast<Windows::Foundation::Collections::IMap<Platform::String^, Platform::Object^>^>(
                 reinterpret_cast<Platform::Object^>(propertySet)
-                ));
+                );
+
+            if (props != nullptr)
+            {
+                auto streamingLock = _LockStreaming();
+                auto lock = _LockState();
+
+                _inputQueueSize = GetUInt32(props, L"InputQueueSize", 1);
+                if (_inputQueueSize == 0)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"InputQueueSize");
+                }
+
+                _asyncFramesInFlight = GetUInt32(props, L"AsyncFramesInFlight", 0);
+                if (_asyncFramesInFlight != 0)
+                {
+                    CHK(_attributes->SetUINT32(MF_TRANSFORM_ASYNC, true));
+                    CHK(_attributes->SetUINT32(MFT_SUPPORT_DYNAMIC_FORMAT_CHANGE, true));
+                    if (_eventQueue == nullptr)
+                    {
+                        CHK(MFCreateEventQueue(&_eventQueue));
+                    }
+                }
+                else
+                {
+                    // Back to synchronous mode: stop advertising async processing
+                    CHK(_attributes->DeleteItem(MF_TRANSFORM_ASYNC));
+                    CHK(_attributes->DeleteItem(MFT_SUPPORT_DYNAMIC_FORMAT_CHANGE));
+                }
+
+                unsigned int qosPolicy = GetUInt32(props, L"QosPolicy", (unsigned int)QosPolicy::None);
+                if (qosPolicy > (unsigned int)QosPolicy::ReducedQuality)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"QosPolicy");
+                }
+                _qosPolicy = (QosPolicy)qosPolicy;
+                unsigned int qosLatencyBudget = GetUInt32(props, L"QosLatencyBudget", 100);
+                if (qosLatencyBudget == 0)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"QosLatencyBudget");
+                }
+                _qosLatencyBudget = 10000ll * qosLatencyBudget; // ms to 100ns
+
+                unsigned int deinterlaceMode = GetUInt32(props, L"Deinterlace", (unsigned int)DeinterlaceMode::None);
+                if (deinterlaceMode > (unsigned int)DeinterlaceMode::MotionAdaptive)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"Deinterlace");
+                }
+                _deinterlaceMode = (DeinterlaceMode)deinterlaceMode;
+
+                // Pools must hold the samples the streaming path keeps at once, or allocations fail mid-stream
+                unsigned int samplesNeeded = max(_GetInputSamplesNeeded(), _GetOutputSamplesNeeded());
+                _allocatorMaxSize = GetUInt32(props, L"SampleAllocatorMaxSize", max(50u, samplesNeeded));
+                if (_allocatorMaxSize < samplesNeeded)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"SampleAllocatorMaxSize");
+                }
+                _allocatorInitialSize = GetUInt32(props, L"SampleAllocatorInitialSize", 1);
+                if ((_allocatorInitialSize == 0) || (_allocatorInitialSize > _allocatorMaxSize))
+                {
+                    throw ref new Platform::InvalidArgumentException(L"SampleAllocatorInitialSize");
+                }
+
+                unsigned int prewarmMode = GetUInt32(props, L"Prewarm", (unsigned int)PrewarmMode::None);
+                if (prewarmMode > (unsigned int)PrewarmMode::TypesSet)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"Prewarm");
+                }
+                _prewarmMode = (PrewarmMode)prewarmMode;
+
+                unsigned int frameTracing = GetUInt32(props, L"FrameTracing", 0);
+                if (frameTracing > 2)
+                {
+                    throw ref new Platform::InvalidArgumentException(L"FrameTracing");
+                }
+                _traceRecords = frameTracing >= 1;
+                _traceVerbose = frameTracing >= 2;
+
+                Trace("Input queue size: %u, async frames in flight: %u, sample allocator size: %u-%u, QoS policy: %u, latency budget: %ums, deinterlace: %u, prewarm: %u", 
+                    _inputQueueSize, _asyncFramesInFlight, _allocatorInitialSize, _allocatorMaxSize, qosPolicy, qosLatencyBudget, deinterlaceMode, prewarmMode);
+            }
+
+            Initialize(props);
+
+            _InvalidateTypeCache();
         });
     }
 
@@ -173,7 +425,7 @@ public:
 
     IFACEMETHOD(GetInputStreamInfo)(_In_ DWORD inputStreamId, _Out_ MFT_INPUT_STREAM_INFO *streamInfo) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (streamInfo == nullptr)
         {
@@ -198,7 +450,7 @@ public:
 
     IFACEMETHOD(GetOutputStreamInfo)(_In_ DWORD outputStreamId, _Out_ MFT_OUTPUT_STREAM_INFO *streamInfo) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (streamInfo == nullptr)
         {
@@ -223,19 +475,46 @@ public:
 
     IFACEMETHOD(GetAttributes)(__deref_out IMFAttributes **attributes) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (attributes == nullptr)
         {
             return OriginateError(E_POINTER);
         }
 
+        // Queue statistics are only refreshed when that does not mean waiting for ProcessSample() to complete
+        HRESULT hr = S_OK;
+        auto streamingLock = _streamingLock.TryLockShared();
+        if (streamingLock.IsLocked())
+        {
+            hr = _PublishStatistics();
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLockStatistics();
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLatencyStatistics();
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = ExceptionBoundary([this]()
+            {
+                PublishStatistics(_attributes);
+            });
+        }
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
         return _attributes.CopyTo(attributes);
     }
 
     IFACEMETHOD(GetInputStreamAttributes)(_In_ DWORD streamId, __deref_out IMFAttributes **attributes) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (attributes == nullptr)
         {
@@ -253,7 +532,7 @@ public:
 
     IFACEMETHOD(GetOutputStreamAttributes)(_In_ DWORD streamId, __deref_out IMFAttributes **attributes) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (attributes == nullptr)
         {
@@ -283,7 +562,7 @@ public:
     {
         HRESULT hr = ExceptionBoundary([this, streamId, typeIndex, type]()
         {
-            auto lock = _lock.LockExclusive();
+            auto lock = _LockStateShared();
 
             CHKNULL(type);
             *type = nullptr;
@@ -293,7 +572,10 @@ public:
                 CHK(MF_E_INVALIDSTREAMNUMBER);
             }
 
-            *type = CreateInputAvailableType(typeIndex).Detach();
+            *type = _GetAvailableType(_inputTypeCache, typeIndex, [this, typeIndex]()
+            {
+                return CreateInputAvailableType(typeIndex);
+            }).Detach();
         });
         return FAILED(hr) ? hr : (*type == nullptr) ? MF_E_NO_MORE_TYPES : S_OK;
     }
@@ -302,7 +584,7 @@ public:
     {
         HRESULT hr = ExceptionBoundary([this, streamId, typeIndex, type]()
         {
-            auto lock = _lock.LockExclusive();
+            auto lock = _LockStateShared();
 
             CHKNULL(type);
             *type = nullptr;
@@ -312,7 +594,10 @@ public:
                 CHK(MF_E_INVALIDSTREAMNUMBER);
             }
 
-            *type = CreateOutputAvailableType(typeIndex).Detach();
+            *type = _GetAvailableType(_outputTypeCache, typeIndex, [this, typeIndex]()
+            {
+                return CreateOutputAvailableType(typeIndex);
+            }).Detach();
         });
         return FAILED(hr) ? hr : (*type == nullptr) ? MF_E_NO_MORE_TYPES : S_OK;
     }
@@ -322,7 +607,8 @@ public:
         bool invalidType = false;
         HRESULT hr = ExceptionBoundary([this, &invalidType, streamId, type, flags]()
         {
-            auto lock = _lock.LockExclusive();
+            auto streamingLock = _LockStreaming();
+            auto lock = _LockState();
 
             if (flags & ~MFT_SET_TYPE_TEST_ONLY)
             {
@@ -332,20 +618,38 @@ public:
             {
                 CHK(MF_E_INVALIDSTREAMNUMBER);
             }
-            if (_sample != nullptr)
+            if (_HasPendingSamples())
             {
                 CHK(MF_E_TRANSFORM_CANNOT_CHANGE_MEDIATYPE_WHILE_PROCESSING);
             }
 
-            if ((type != nullptr) && !IsValidInputType(type))
+            if ((type != nullptr) && !_IsValidTypeCached(_inputTypeCache, type, [this, type]()
+            {
+                return IsValidInputType(type);
+            }))
             {
                 invalidType = true;
             }
             else if (!(flags & MFT_SET_TYPE_TEST_ONLY))
             {
-                _SetStreamingState(false);
-                _GetFormatInfo(type, &_inputDefaultStride, &_inputDefaultSize, &_inputProgressive);
+                Microsoft::WRL::ComPtr<IMFMediaType> previousType = _inputType;
+                bool changeInPlace = _CanChangeFormatInPlace(previousType, type);
+                if (!changeInPlace)
+                {
+                    _SetStreamingState(false);
+                }
+                _GetFormatInfo(type, &_inputDefaultStride, &_inputDefaultSize, &_inputProgressive, &_inputBottomUp);
+                _inputInterlaceMode = type != nullptr ? MFGetAttributeUINT32(type, MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive) : MFVideoInterlace_Progressive;
                 _inputType = type;
+                _InvalidateTypeCache();
+                if (changeInPlace)
+                {
+                    _ChangeInputFormat(previousType);
+                }
+                else if (_prewarmMode == PrewarmMode::TypesSet)
+                {
+                    _PrewarmAsync();
+                }
             }
         });
         hr = FAILED(hr) ? hr : invalidType ? MF_E_INVALIDMEDIATYPE : S_OK;
@@ -367,7 +671,8 @@ public:
         bool invalidType = false;
         HRESULT hr = ExceptionBoundary([this, &invalidType, streamId, type, flags]()
         {
-            auto lock = _lock.LockExclusive();
+            auto streamingLock = _LockStreaming();
+            auto lock = _LockState();
 
             if (flags & ~MFT_SET_TYPE_TEST_ONLY)
             {
@@ -377,20 +682,37 @@ public:
             {
                 CHK(MF_E_INVALIDSTREAMNUMBER);
             }
-            if (_sample != nullptr)
+            if (_HasPendingSamples() && !_formatChangePending)
             {
                 CHK(MF_E_TRANSFORM_CANNOT_CHANGE_MEDIATYPE_WHILE_PROCESSING);
             }
 
-            if ((type != nullptr) && !IsValidOutputType(type))
+            if ((type != nullptr) && !_IsValidTypeCached(_outputTypeCache, type, [this, type]()
+            {
+                return IsValidOutputType(type);
+            }))
             {
                 invalidType = true;
             }
             else if (!(flags & MFT_SET_TYPE_TEST_ONLY))
             {
-                _SetStreamingState(false);
+                Microsoft::WRL::ComPtr<IMFMediaType> previousType = _outputType;
+                bool changeInPlace = _CanChangeFormatInPlace(previousType, type);
+                if (!changeInPlace)
+                {
+                    _SetStreamingState(false);
+                }
                 _GetFormatInfo(type, &_outputDefaultStride, &_outputDefaultSize);
                 _outputType = type;
+                _InvalidateTypeCache();
+                if (changeInPlace)
+                {
+                    _ChangeOutputFormat(previousType);
+                }
+                else if (_prewarmMode == PrewarmMode::TypesSet)
+                {
+                    _PrewarmAsync();
+                }
             }
         });
         hr = FAILED(hr) ? hr : invalidType ? MF_E_INVALIDMEDIATYPE : S_OK;
@@ -409,7 +731,7 @@ public:
 
     IFACEMETHOD(GetInputCurrentType)(_In_ DWORD streamId, _COM_Outptr_ IMFMediaType **type) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (type == nullptr)
         {
@@ -429,7 +751,7 @@ public:
 
     IFACEMETHOD(GetOutputCurrentType)(_In_ DWORD streamId, _COM_Outptr_ IMFMediaType **type) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStateShared();
 
         if (type == nullptr)
         {
@@ -449,7 +771,7 @@ public:
 
     IFACEMETHOD(GetInputStatus)(_In_ DWORD streamId, _Out_ DWORD *flags) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStreamingShared();
 
         if (flags == nullptr)
         {
@@ -460,21 +782,21 @@ public:
             return OriginateError(MF_E_INVALIDSTREAMNUMBER);
         }
 
-        *flags = _sample == nullptr ? MFT_INPUT_STATUS_ACCEPT_DATA : 0;
+        *flags = _CanAcceptInput() ? MFT_INPUT_STATUS_ACCEPT_DATA : 0;
 
         return S_OK;
     }
 
     IFACEMETHOD(GetOutputStatus)(_Out_ DWORD *flags) override
     {
-        auto lock = _lock.LockExclusive();
+        auto lock = _LockStreamingShared();
 
         if (flags == nullptr)
         {
             return OriginateError(E_POINTER);
         }
 
-        *flags = _sample != nullptr ? MFT_OUTPUT_STATUS_SAMPLE_READY : 0;
+        *flags = _HasOutputReady() ? MFT_OUTPUT_STATUS_SAMPLE_READY : 0;
 
         return S_OK;
     }
@@ -495,15 +817,42 @@ public:
 
         return ExceptionBoundary([this, message, param]()
         {
-            auto lock = _lock.LockExclusive();
+            auto streamingLock = _LockStreaming();
+
+            _CheckAsyncUnlocked();
 
             switch (message)
             {
             case MFT_MESSAGE_COMMAND_FLUSH:
-                _sample = nullptr;
+                _samples.clear();
+                _sampleQueueTimes.clear();
+                _draining = false;
+                _qosClockValid = false; // Usually a seek
+                _qosDiscontinuity = false;
+                _deinterlacePrevious = nullptr;
+                if (_IsAsync())
+                {
+                    // Frames still being processed are dropped when they complete
+                    InterlockedIncrement(&_processingGeneration);
+                    _framesInFlight.clear();
+                    _outputsReady.clear();
+                    _inputRequestCount = 0;
+                    _asyncStarted = false; // No input requested until MFT_MESSAGE_NOTIFY_START_OF_STREAM
+                }
                 break;
 
             case MFT_MESSAGE_COMMAND_DRAIN:
+                if (_IsAsync())
+                {
+                    // Stop requesting input and signal METransformDrainComplete once all the frames are returned
+                    _draining = true;
+                    _CompleteAsyncDrain();
+                }
+                else
+                {
+                    // Queued samples are all returned by ProcessOutput() before new input is accepted
+                    _draining = !_samples.empty();
+                }
                 break;
 
             case MFT_MESSAGE_SET_D3D_MANAGER:
@@ -516,6 +865,8 @@ public:
 
                 Trace("Device manager @%p", deviceManager.Get());
 
+                auto lock = _LockState();
+
                 // MediaElement sends the same device manager multiple times, so ignore duplicate calls
                 if (deviceManager != _deviceManager)
                 {
@@ -535,17 +886,46 @@ public:
                 break;
 
             case MFT_MESSAGE_NOTIFY_BEGIN_STREAMING:
-                _SetStreamingState(true);
+                _firstFrameStartTime = MFGetSystemTime();
+                _firstFrameOutput = false;
+                if (_prewarmMode == PrewarmMode::None)
+                {
+                    _StartStreamingIfNeeded();
+                }
+                else
+                {
+                    auto lock = _LockState();
+                    _PrewarmAsync();
+                }
                 break;
 
             case MFT_MESSAGE_NOTIFY_END_STREAMING:
+            {
+                auto lock = _LockState();
                 _SetStreamingState(false);
+                _firstFrameStartTime = 0;
+                _firstFrameOutput = false;
+                CHK(_PublishLatencyJson());
+            }
                 break;
 
             case MFT_MESSAGE_NOTIFY_END_OF_STREAM:
+                // No more input coming: release the queued samples without waiting for a full queue
+                if (!_IsAsync())
+                {
+                    _draining = !_samples.empty();
+                }
                 break;
 
             case MFT_MESSAGE_NOTIFY_START_OF_STREAM:
+                _draining = false;
+                _qosClockValid = false;
+                _deinterlacePrevious = nullptr;
+                if (_IsAsync())
+                {
+                    _asyncStarted = true;
+                    _RequestAsyncInputs();
+                }
                 break;
             }
         });
@@ -553,12 +933,14 @@ public:
 
     IFACEMETHOD(ProcessInput)(_In_ DWORD streamID, _In_ IMFSample *sample, _In_ DWORD flags) override
     {
-        Trace("Input sample: %s", SampleFormatter::Format(sample).c_str());
+        TraceVerbose(_traceVerbose, "Input sample: %s", SampleFormatter::Format(sample).c_str());
 
         bool notAccepting = false;
         HRESULT hr = ExceptionBoundary([this, streamID, sample, flags, &notAccepting]()
         {
-            auto lock = _lock.LockExclusive();
+            auto streamingLock = _LockStreaming();
+
+            _CheckAsyncUnlocked();
 
             if (sample == nullptr)
             {
@@ -573,27 +955,93 @@ public:
                 CHK(OriginateError(MF_E_INVALIDSTREAMNUMBER));
             }
 
-            _SetStreamingState(true);
+            if (_firstFrameStartTime == 0)
+            {
+                _firstFrameStartTime = MFGetSystemTime(); // No MFT_MESSAGE_NOTIFY_BEGIN_STREAMING
+            }
+
+            _StartStreamingIfNeeded();
 
-            if ((_inputType == nullptr) || (_outputType == nullptr) || (_sample != nullptr))
+            // Asynchronous frames are dispatched right away, so they wait for the output type to be updated
+            if ((_inputType == nullptr) || (_outputType == nullptr) || (_formatChangePending && _IsAsync()) ||
+                !(_IsAsync() ? _CanAcceptAsyncInput() : _CanAcceptInput()))
             {
+                _inputSampleRejectedCount++;
                 notAccepting = true;
                 return;
             }
 
-            if (!_passthrough)
+            bool interlaced = false;
+            bool bottomFieldFirst = false;
+            if (!_passthrough && !_inputProgressive)
             {
-                if (!_inputProgressive && MFGetAttributeUINT32(sample, MFSampleExtension_Interlaced, false))
+                bool fieldInterleaved = (_inputInterlaceMode == MFVideoInterlace_FieldInterleavedUpperFirst) ||
+                    (_inputInterlaceMode == MFVideoInterlace_FieldInterleavedLowerFirst);
+                interlaced = !!MFGetAttributeUINT32(sample, MFSampleExtension_Interlaced, fieldInterleaved);
+                if (interlaced && !_deinterlacing)
                 {
                     CHK(OriginateError(E_INVALIDARG, L"Interlaced content not supported"));
                 }
+                bottomFieldFirst = !!MFGetAttributeUINT32(sample, MFSampleExtension_BottomFieldFirst, 
+                    _inputInterlaceMode == MFVideoInterlace_FieldInterleavedLowerFirst);
+            }
+
+            _UpdateQosClock(sample);
+
+            ::Microsoft::WRL::ComPtr<IMFSample> input = sample;
+            if (!_passthrough)
+            {
+                {
+                    LatencyHistogram::Scope normalize(_normalizeLatency);
+                    input = _NormalizeSample(sample);
+                }
+                if (interlaced && _HasDXGIBuffer(input))
+                {
+                    TraceVerbose(_traceVerbose, "Interlaced texture passed on without deinterlacing");
+                    interlaced = false;
+                }
+                if (interlaced)
+                {
+                    input = _DeinterlaceSample(input, bottomFieldFirst);
+                }
+                else
+                {
+                    _deinterlacePrevious = nullptr;
+                }
+            }
+
+            if (_IsAsync())
+            {
+                auto frame = std::make_shared<AsyncFrame>();
+                frame->Input = input;
+                if (!_passthrough)
+                {
+                    frame->Output = _AllocateSample(_outputAllocator);
+                }
+                frame->Generation = _processingGeneration;
+                frame->Deadline = _GetQosDeadline(sample);
+                frame->QueueTime = LatencyHistogram::Now();
+
+                _framesInFlight.push_back(frame);
+                _inputRequestCount--;
+                _inputSampleCount++;
+                _asyncFramesInFlightMax = max(_asyncFramesInFlightMax, _GetAsyncFrameCount());
+
+                _DispatchAsyncFrame(frame);
+                return;
             }
 
-            _sample = _passthrough ? sample : _NormalizeSample(sample);
+            _samples.push_back(input);
+            _sampleQueueTimes.push_back(LatencyHistogram::Now());
+
+            _inputSampleCount++;
+            _inputQueueDepthMax = max(_inputQueueDepthMax, (unsigned int)_samples.size());
         });
 
         hr = FAILED(hr) ? hr : notAccepting ? MF_E_NOTACCEPTING : S_OK;
 
+        TraceSample(_traceRecords, SUCCEEDED(hr) ? TraceEvent::ProcessInput : TraceEvent::InputRejected, this, sample);
+
         if (FAILED(hr))
         {
             Trace("Failed hr=%08X", hr);
@@ -605,9 +1053,12 @@ public:
     IFACEMETHOD(ProcessOutput)(_In_ DWORD flags, _In_ DWORD outputBufferCount, _Inout_ MFT_OUTPUT_DATA_BUFFER  *outputSamples, _Out_ DWORD *status) override
     {
         bool needMoreInput = false;
-        HRESULT hr = ExceptionBoundary([this, flags, outputBufferCount, outputSamples, status, &needMoreInput]()
+        bool streamChange = false;
+        HRESULT hr = ExceptionBoundary([this, flags, outputBufferCount, outputSamples, status, &needMoreInput, &streamChange]()
         {
-            auto lock = _lock.LockExclusive();
+            auto streamingLock = _LockStreaming();
+
+            _CheckAsyncUnlocked();
 
             if ((outputSamples == nullptr) || (status == nullptr))
             {
@@ -625,27 +1076,93 @@ public:
                 CHK(OriginateError(E_INVALIDARG));
             }
 
-            _SetStreamingState(true);
+            _StartStreamingIfNeeded();
+
+            if (_formatChangePending)
+            {
+                // The client needs to call GetOutputAvailableType() and SetOutputType() before getting more output
+                Trace("Signaling output stream change");
+                outputSamples[0].dwStatus = MFT_OUTPUT_DATA_BUFFER_FORMAT_CHANGE;
+                streamChange = true;
+                return;
+            }
+
+            if (_IsAsync())
+            {
+                // Frames are returned in input order (see _CompleteAsyncFrames())
+                if (_outputsReady.empty())
+                {
+                    needMoreInput = true;
+                    return;
+                }
+
+                _MarkQosDiscontinuity(_outputsReady.front());
+                outputSamples[0].pSample = _outputsReady.front().Detach();
+                _outputsReady.pop_front();
+                _RecordOutputSample();
+                _CheckMemoryPressure();
+
+                _RequestAsyncInputs();
+                _CompleteAsyncDrain();
+                return;
+            }
 
-            if (_sample == nullptr)
+            if (!_HasOutputReady())
             {
                 needMoreInput = true;
                 return;
             }
 
+            auto processingLock = _processingLock.LockExclusive();
+
+            // Samples are only dequeued once processed, so they are not lost if ProcessSample() throws
             if (_passthrough)
             {
-                ProcessSample(_sample);
-                outputSamples[0].pSample = _sample.Detach();
+                _RecordQueueWait();
+                {
+                    LatencyHistogram::Scope process(_processLatency);
+                    ProcessSample(_samples.front());
+                }
+                outputSamples[0].pSample = _samples.front().Detach();
+                _PopSample();
+                _RecordOutputSample();
             }
             else
             {
+                // Samples without output (dropped late, or consumed by ProcessSample()) are skipped while more are ready
                 Microsoft::WRL::ComPtr<IMFSample> outputSample;
-                CHK(_outputAllocator->AllocateSample(&outputSample));
+                bool producedData = false;
+                while (!producedData && _HasOutputReady())
+                {
+                    _RecordQueueWait();
 
-                bool producedData = ProcessSample(_sample, outputSample);
+                    long long lateness;
+                    QosAction action = _GetQosAction(_GetQosDeadline(_samples.front()), &lateness);
+                    switch (action)
+                    {
+                    case QosAction::Drop:
+                        TraceSample(_traceRecords, TraceEvent::FrameDropped, this, _samples.front().Get());
+                        break;
+
+                    case QosAction::PassThrough:
+                        outputSample = _samples.front();
+                        producedData = true;
+                        break;
+
+                    default:
+                    {
+                        outputSample = _AllocateSample(_outputAllocator);
+                        LatencyHistogram::Scope process(_processLatency);
+                        producedData = (action == QosAction::ReduceQuality) ?
+                            ProcessSampleReducedQuality(_samples.front(), outputSample) :
+                            ProcessSample(_samples.front(), outputSample);
+                    }
+                        break;
+                    }
 
-                _sample = nullptr;
+                    _PopSample();
+                    _RecordQosAction(action, lateness);
+                }
 
                 if (!producedData)
                 {
@@ -653,16 +1170,25 @@ public:
                 }
                 else
                 {
+                    _MarkQosDiscontinuity(outputSample);
                     outputSamples[0].pSample = outputSample.Detach();
+                    _RecordOutputSample();
+                    _CheckMemoryPressure();
                 }
             }
+
+            if (_samples.empty())
+            {
+                _draining = false;
+            }
         });
 
-        hr = FAILED(hr) ? hr : needMoreInput ? MF_E_TRANSFORM_NEED_MORE_INPUT : S_OK;
+        hr = FAILED(hr) ? hr : streamChange ? MF_E_TRANSFORM_STREAM_CHANGE : needMoreInput ? MF_E_TRANSFORM_NEED_MORE_INPUT : S_OK;
 
         if (SUCCEEDED(hr))
         {
-            Trace("Output sample: %s", SampleFormatter::Format(outputSamples[0].pSample).c_str());
+            TraceVerbose(_traceVerbose, "Output sample: %s", SampleFormatter::Format(outputSamples[0].pSample).c_str());
+            TraceSample(_traceRecords, TraceEvent::ProcessOutput, this, outputSamples[0].pSample);
         }
         else
         {
@@ -672,145 +1198,1196 @@ public:
         return hr;
     }
 
-protected:
-
-    //
-    // Overrides - misc
-    //
-
-    virtual void Initialize(_In_ Windows::Foundation::Collections::IMap<Platform::String^, Platform::Object^>^ props)
-    {
-    }
-
     //
-    // Overrides - data processing
+    // IMFMediaEventGenerator (asynchronous mode only)
     //
 
-    virtual void StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/)
+    IFACEMETHOD(GetEvent)(_In_ DWORD flags, _COM_Outptr_ IMFMediaEvent **event) override
     {
+        // No lock: the call may block until an event is queued
+        if (_eventQueue == nullptr)
+        {
+            return OriginateError(E_NOTIMPL);
+        }
+        return _eventQueue->GetEvent(flags, event);
     }
 
-    // Called in non-pass-through mode
-    // Returns true if produced data
-    virtual bool ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& /*inputSample*/, _In_ const Microsoft::WRL::ComPtr<IMFSample>& /*outputSample*/)
+    IFACEMETHOD(BeginGetEvent)(_In_ IMFAsyncCallback *callback, _In_opt_ IUnknown *state) override
     {
-        assert(!_passthrough);
-        return false;
+        if (_eventQueue == nullptr)
+        {
+            return OriginateError(E_NOTIMPL);
+        }
+        return _eventQueue->BeginGetEvent(callback, state);
     }
 
-    // Called in pass-through mode
-    virtual void ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& /*sample*/)
+    IFACEMETHOD(EndGetEvent)(_In_ IMFAsyncResult *result, _COM_Outptr_ IMFMediaEvent **event) override
     {
-        assert(_passthrough);
+        if (_eventQueue == nullptr)
+        {
+            return OriginateError(E_NOTIMPL);
+        }
+        return _eventQueue->EndGetEvent(result, event);
     }
 
-    virtual void EndStreaming()
+    IFACEMETHOD(QueueEvent)(_In_ MediaEventType type, _In_ REFGUID extendedType, _In_ HRESULT status, _In_opt_ const PROPVARIANT *value) override
     {
+        if (_eventQueue == nullptr)
+        {
+            return OriginateError(E_NOTIMPL);
+        }
+        return _eventQueue->QueueEventParamVar(type, extendedType, status, value);
     }
 
     //
-    // Overrides - format management
+    // IMFShutdown
     //
 
-    // After initialization, _supportedFormats can be updated directly
-    virtual std::vector<unsigned long> GetSupportedFormats() const
-    {
-        std::vector<unsigned long> formats;
-        formats.push_back(MFVideoFormat_NV12.Data1);
-        return formats;
-    }
-
-    // Returns nullptr if typeIndex out of range
-    // The default implementation assumes input media type same as output media type
-    virtual _Ret_maybenull_ Microsoft::WRL::ComPtr<IMFMediaType> CreateInputAvailableType(_In_ unsigned int typeIndex) const
+    IFACEMETHOD(Shutdown)() override
     {
-        Microsoft::WRL::ComPtr<IMFMediaType> type;
+        Trace("Shutdown");
 
-        if (_outputType == nullptr)
-        {
-            type = _CreatePartialType(typeIndex);
-        }
-        else if (typeIndex == 0)
+        return ExceptionBoundary([this]()
         {
-            // Make a copy of the caller cannot modify the MFT media type
-            CHK(MFCreateMediaType(&type));
-            CHK(_outputType->CopyAllItems(type.Get()));
-        }
+            auto streamingLock = _LockStreaming();
+            auto lock = _LockState();
 
-        return type;
+            _shutdown = true;
+            if (_eventQueue != nullptr)
+            {
+                CHK(_eventQueue->Shutdown());
+            }
+        });
     }
 
-    // Returns nullptr if typeIndex out of range
-    // The default implementation assumes input media type same as output media type
-    virtual _Ret_maybenull_ Microsoft::WRL::ComPtr<IMFMediaType> CreateOutputAvailableType(_In_ unsigned int typeIndex) const
+    IFACEMETHOD(GetShutdownStatus)(_Out_ MFSHUTDOWN_STATUS *status) override
     {
-        Microsoft::WRL::ComPtr<IMFMediaType> type;
+        auto lock = _LockStateShared();
 
-        if (_inputType == nullptr)
+        if (status == nullptr)
         {
-            type = _CreatePartialType(typeIndex);
+            return OriginateError(E_POINTER);
         }
-        else if (typeIndex == 0)
+        if (!_shutdown)
         {
-            // Make a copy of the caller cannot modify the MFT media type
-            CHK(MFCreateMediaType(&type));
-            CHK(_inputType->CopyAllItems(type.Get()));
+            return MF_E_INVALIDREQUEST;
         }
 
-        return type;
+        *status = MFSHUTDOWN_COMPLETED;
+        return S_OK;
     }
 
-    virtual bool IsValidInputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    //
+    // IVideoEffectStage
+    //
+
+    IFACEMETHOD_(bool, IsPassThroughStage)() override
     {
-        if (_outputType != nullptr)
-        {
-            BOOL match = false;
-            return SUCCEEDED(type->Compare(_outputType.Get(), MF_ATTRIBUTES_MATCH_INTERSECTION, &match)) && !!match;
-        }
-        else
-        {
-            return _IsValidType(type);
-        }
+        return _passthrough;
     }
 
-    virtual bool IsValidOutputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    IFACEMETHOD(StartStage)(_In_opt_ IMFDXGIDeviceManager *deviceManager) override
     {
-        if (_inputType != nullptr)
-        {
-            BOOL match = false;
-            return SUCCEEDED(type->Compare(_inputType.Get(), MF_ATTRIBUTES_MATCH_INTERSECTION, &match)) && !!match;
-        }
-        else
+        Trace("Starting stage, device manager @%p", deviceManager);
+
+        return ExceptionBoundary([this, deviceManager]()
         {
-            return _IsValidType(type);
-        }
-    }
+            auto streamingLock = _LockStreaming();
+            auto lock = _LockState();
+
+            if (deviceManager != _deviceManager.Get())
+            {
+                _SetStreamingState(false);
+                if (deviceManager != nullptr)
+                {
+                    ValidateDeviceManager(deviceManager);
+                }
+                _deviceManager = deviceManager;
+            }
+
+            _stage = true;
+            _SetStreamingState(true);
+        });
+    }
+
+    IFACEMETHOD(ProcessStage)(_In_ IMFSample *inputSample, _In_opt_ IMFSample *outputSample, _Out_ bool *producedData) override
+    {
+        return ExceptionBoundary([this, inputSample, outputSample, producedData]()
+        {
+            CHKNULL(inputSample);
+            CHKNULL(producedData);
+            *producedData = false;
+
+            // Like asynchronous mode, only the processing lock is taken
+            auto processingLock = _processingLock.LockExclusive();
+
+            if (!_streaming || !_stage)
+            {
+                CHK(OriginateError(MF_E_INVALIDREQUEST, L"Stage not started"));
+            }
+
+            LatencyHistogram::Scope process(_processLatency);
+            if (_passthrough)
+            {
+                ProcessSample(inputSample);
+                *producedData = true;
+            }
+            else
+            {
+                CHKNULL(outputSample);
+                *producedData = ProcessSample(inputSample, outputSample);
+            }
+        });
+    }
+
+    IFACEMETHOD(EndStage)() override
+    {
+        Trace("Ending stage");
+
+        return ExceptionBoundary([this]()
+        {
+            auto streamingLock = _LockStreaming();
+            auto lock = _LockState();
+
+            _SetStreamingState(false);
+            _stage = false;
+        });
+    }
+
+protected:
+
+    //
+    // Overrides - misc
+    //
+
+    virtual void Initialize(_In_ Windows::Foundation::Collections::IMap<Platform::String^, Platform::Object^>^ props)
+    {
+    }
+
+    //
+    // Overrides - data processing
+    //
+
+    virtual void StartStreaming(_In_ unsigned long /*format*/, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/)
+    {
+    }
+
+    // Called in non-pass-through mode
+    // Returns true if produced data
+    virtual bool ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& /*inputSample*/, _In_ const Microsoft::WRL::ComPtr<IMFSample>& /*outputSample*/)
+    {
+        assert(!_passthrough);
+        return false;
+    }
+
+    // Called in pass-through mode
+    virtual void ProcessSample(_In_ const Microsoft::WRL::ComPtr<IMFSample>& /*sample*/)
+    {
+        assert(_passthrough);
+    }
+
+    // Called instead of ProcessSample() on late frames when "QosPolicy" is 3 (reduced quality)
+    // Returns true if produced data
+    virtual bool ProcessSampleReducedQuality(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample)
+    {
+        return ProcessSample(inputSample, outputSample);
+    }
+
+    // Called instead of ProcessSample() in asynchronous mode. The returned task may complete after the call returns,
+    // in which case the thread pool thread is released while the effect works in the background: this lets effects
+    // built on asynchronous APIs keep several frames in flight. The processing lock only covers the call itself,
+    // so effects which do not support concurrent processing must return completed tasks. Processing still in
+    // flight when streaming ends completes in the background, its output discarded.
+    virtual concurrency::task<bool> ProcessSampleAsync(_In_ const Microsoft::WRL::ComPtr<IMFSample>& inputSample, _In_ const Microsoft::WRL::ComPtr<IMFSample>& outputSample)
+    {
+        return concurrency::task_from_result(ProcessSample(inputSample, outputSample));
+    }
+
+    virtual void EndStreaming()
+    {
+    }
+
+    // Called when the media types change while streaming, once the output type matches the new input type.
+    // Effects with cheaper ways to adapt than a restart can override it.
+    virtual void OnFormatChanged(_In_ unsigned long format, _In_ unsigned int width, _In_ unsigned int height)
+    {
+        EndStreaming();
+        StartStreaming(format, width, height);
+    }
+
+    //
+    // Overrides - format management
+    //
+
+    // After initialization, _supportedFormats can be updated directly
+    virtual std::vector<unsigned long> GetSupportedFormats() const
+    {
+        std::vector<unsigned long> formats;
+        formats.push_back(MFVideoFormat_NV12.Data1);
+        return formats;
+    }
+
+    // Returns nullptr if typeIndex out of range
+    // The default implementation assumes input media type same as output media type
+    virtual _Ret_maybenull_ Microsoft::WRL::ComPtr<IMFMediaType> CreateInputAvailableType(_In_ unsigned int typeIndex) const
+    {
+        Microsoft::WRL::ComPtr<IMFMediaType> type;
+
+        if (_outputType == nullptr)
+        {
+            type = _CreatePartialType(typeIndex);
+        }
+        else if (typeIndex == 0)
+        {
+            // Make a copy of the caller cannot modify the MFT media type
+            CHK(MFCreateMediaType(&type));
+            CHK(_outputType->CopyAllItems(type.Get()));
+        }
+
+        return type;
+    }
+
+    // Returns nullptr if typeIndex out of range
+    // The default implementation assumes input media type same as output media type
+    virtual _Ret_maybenull_ Microsoft::WRL::ComPtr<IMFMediaType> CreateOutputAvailableType(_In_ unsigned int typeIndex) const
+    {
+        Microsoft::WRL::ComPtr<IMFMediaType> type;
+
+        if (_inputType == nullptr)
+        {
+            type = _CreatePartialType(typeIndex);
+        }
+        else if (typeIndex == 0)
+        {
+            // Make a copy of the caller cannot modify the MFT media type
+            CHK(MFCreateMediaType(&type));
+            CHK(_inputType->CopyAllItems(type.Get()));
+            if (_IsDeinterlacedType(_inputType))
+            {
+                CHK(type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
+            }
+        }
+
+        return type;
+    }
+
+    virtual bool IsValidInputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    {
+        // Input types changed in place while streaming are checked on their own: the output type
+        // is renegotiated afterwards (see _ChangeInputFormat())
+        if ((_outputType != nullptr) && !_CanChangeFormatInPlace(_inputType, type.Get()))
+        {
+            BOOL match = false;
+            return SUCCEEDED(_GetDeinterlacedType(type)->Compare(_outputType.Get(), MF_ATTRIBUTES_MATCH_INTERSECTION, &match)) && !!match;
+        }
+        else
+        {
+            return _IsValidType(type);
+        }
+    }
+
+    virtual bool IsValidOutputType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    {
+        // Deinterlacing only happens on the input side
+        if (_IsDeinterlacedType(type))
+        {
+            unsigned int interlacing = MFGetAttributeUINT32(type.Get(), MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+            if ((interlacing == MFVideoInterlace_FieldInterleavedUpperFirst) || (interlacing == MFVideoInterlace_FieldInterleavedLowerFirst))
+            {
+                return false;
+            }
+        }
+
+        if (_inputType != nullptr)
+        {
+            BOOL match = false;
+            return SUCCEEDED(type->Compare(_GetDeinterlacedType(_inputType).Get(), MF_ATTRIBUTES_MATCH_INTERSECTION, &match)) && !!match;
+        }
+        else
+        {
+            return _IsValidType(type);
+        }
+    }
 
     virtual bool IsFormatSupported(_In_ unsigned long /*format*/, _In_ unsigned int /*width*/, _In_ unsigned int /*height*/) const
     {
-        return true;
+        return true;
+    }
+
+    virtual void ValidateDeviceManager(_In_ const Microsoft::WRL::ComPtr<IMFDXGIDeviceManager>& /*deviceManager*/) const
+    {
+    }
+
+    //
+    // Overrides - asynchronous mode
+    //
+
+    // Returns true if ProcessSample() can be called on several threads at the same time.
+    // Otherwise calls are serialized (but still run off the pipeline thread).
+    virtual bool SupportsConcurrentProcessing() const
+    {
+        return false;
+    }
+
+    //
+    // Overrides - statistics
+    //
+
+    // Adds effect-specific statistics to the attribute store returned by GetAttributes(). Called without
+    // _streamingLock, possibly while ProcessSample() runs: the values must be read atomically.
+    virtual void PublishStatistics(_In_ const Microsoft::WRL::ComPtr<IMFAttributes>& /*attributes*/) const
+    {
+    }
+
+    Microsoft::WRL::ComPtr<IMFMediaType> _inputType;
+    Microsoft::WRL::ComPtr<IMFMediaType> _outputType;
+    Microsoft::WRL::ComPtr<IMFDXGIDeviceManager> _deviceManager;
+    std::unique_ptr<SampleAllocatorPool> _inputAllocator;  // null if pass-through
+    std::unique_ptr<SampleAllocatorPool> _outputAllocator; // null if pass-through
+    std::vector<unsigned long> _supportedFormats;
+    unsigned int _inputDefaultStride; // Buffer pitch when receiving 1D buffers (happens sometimes in MediaElement)
+    bool _inputBottomUp; // 1D input buffers store rows bottom-up (RGB)
+    unsigned int _outputDefaultStride;
+    bool _passthrough;
+    bool _inPlaceRgbInput; // ProcessSample() reads RGB input buffers in place, 1D or 2D, bottom-up or top-down
+    bool _stage; // Driven by a CompositeEffect through IVideoEffectStage
+    ::Microsoft::WRL::Wrappers::SRWLock _lock; // State lock, see the lock notes at the top of the file
+    ::Microsoft::WRL::Wrappers::SRWLock _streamingLock;
+    ::Microsoft::WRL::Wrappers::SRWLock _processingLock;
+
+    // Lock helpers counting contentions
+    ::Microsoft::WRL::Wrappers::SRWLock::SyncLockExclusive _LockState()
+    {
+        return _LockExclusive(_lock, &_stateLockContentionCount, _lockWaitLatency);
+    }
+    ::Microsoft::WRL::Wrappers::SRWLock::SyncLockShared _LockStateShared()
+    {
+        return _LockShared(_lock, &_stateLockContentionCount, _lockWaitLatency);
+    }
+    ::Microsoft::WRL::Wrappers::SRWLock::SyncLockExclusive _LockStreaming()
+    {
+        return _LockExclusive(_streamingLock, &_streamingLockContentionCount, _lockWaitLatency);
+    }
+    ::Microsoft::WRL::Wrappers::SRWLock::SyncLockShared _LockStreamingShared()
+    {
+        return _LockShared(_streamingLock, &_streamingLockContentionCount, _lockWaitLatency);
+    }
+
+    // Counts a frame copy made by the effect in the VE_STATISTICS_COPIES/COPY_BYTES statistics. Can be called from any thread.
+    void _RecordCopy(_In_ unsigned long long bytes)
+    {
+        InterlockedIncrement64(&_copyCount);
+        InterlockedExchangeAdd64(&_copyBytes, (long long)bytes);
+    }
+
+    // Signed stride of 1D input buffers: negative if rows are stored bottom-up
+    long _GetInputBufferStride() const
+    {
+        return _inputBottomUp ? -(long)_inputDefaultStride : (long)_inputDefaultStride;
+    }
+
+    // Returns the media type of the frames passed to ProcessSample() for a given input type:
+    // a progressive copy if the effect deinterlaces that type, the type itself otherwise
+    Microsoft::WRL::ComPtr<IMFMediaType> _GetDeinterlacedType(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    {
+        if (!_IsDeinterlacedType(type))
+        {
+            return type;
+        }
+
+        Microsoft::WRL::ComPtr<IMFMediaType> progressiveType;
+        CHK(MFCreateMediaType(&progressiveType));
+        CHK(type->CopyAllItems(progressiveType.Get()));
+        CHK(progressiveType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
+        return progressiveType;
+    }
+
+    // Drops the memoized media-type negotiation results. Called with _lock held exclusively.
+    void _InvalidateTypeCache()
+    {
+        auto lock = _typeCacheLock.LockExclusive();
+        _inputTypeCache.Clear();
+        _outputTypeCache.Clear();
+    }
+
+    ~Video1in1outEffect()
+    {
+    }
+
+private:
+
+    // IsValidXxxType() result for a copy of the type tested, with its attribute hash to skip most comparisons
+    struct ValidType
+    {
+        unsigned long long Hash;
+        ::Microsoft::WRL::ComPtr<IMFMediaType> Type;
+        bool Valid;
+    };
+
+    // Memoized media-type negotiation results for one side of the MFT
+    struct TypeCache
+    {
+        TypeCache()
+            : AvailableTypeCount(UINT_MAX)
+        {
+        }
+
+        void Clear()
+        {
+            AvailableTypes.clear();
+            AvailableTypeCount = UINT_MAX;
+            ValidTypes.clear();
+        }
+
+        std::vector<::Microsoft::WRL::ComPtr<IMFMediaType>> AvailableTypes; // Indexed by type index, null if not created yet
+        unsigned int AvailableTypeCount; // UINT_MAX until the end of the list is reached
+        std::vector<ValidType> ValidTypes; // Oldest first
+    };
+
+    static const unsigned int TypeCacheMaxValidTypes = 32;
+
+    // Only contended acquisitions are timed, uncontended ones stay a single interlocked operation
+    static ::Microsoft::WRL::Wrappers::SRWLock::SyncLockExclusive _LockExclusive(
+        _In_ ::Microsoft::WRL::Wrappers::SRWLock& lock,
+        _Inout_ volatile long* contentionCount,
+        _Inout_ LatencyHistogram& waitLatency
+        )
+    {
+        auto syncLock = lock.TryLockExclusive();
+        if (!syncLock.IsLocked())
+        {
+            InterlockedIncrement(contentionCount);
+            LatencyHistogram::Scope wait(waitLatency);
+            return lock.LockExclusive();
+        }
+        return syncLock;
+    }
+
+    static ::Microsoft::WRL::Wrappers::SRWLock::SyncLockShared _LockShared(
+        _In_ ::Microsoft::WRL::Wrappers::SRWLock& lock,
+        _Inout_ volatile long* contentionCount,
+        _Inout_ LatencyHistogram& waitLatency
+        )
+    {
+        auto syncLock = lock.TryLockShared();
+        if (!syncLock.IsLocked())
+        {
+            InterlockedIncrement(contentionCount);
+            LatencyHistogram::Scope wait(waitLatency);
+            return lock.LockShared();
+        }
+        return syncLock;
+    }
+
+    // Samples the streaming path can hold at once from the input pool: queued and in-flight frames, plus the frame
+    // being deinterlaced and the previous one kept by motion-adaptive deinterlacing
+    unsigned int _GetInputSamplesNeeded() const
+    {
+        unsigned int deinterlaceSamples = (_deinterlaceMode == DeinterlaceMode::MotionAdaptive) ? 2 :
+            (_deinterlaceMode == DeinterlaceMode::Bob) ? 1 : 0;
+        return _inputQueueSize + _asyncFramesInFlight + deinterlaceSamples;
+    }
+
+    // Samples the streaming path can hold at once from the output pool
+    unsigned int _GetOutputSamplesNeeded() const
+    {
+        return _asyncFramesInFlight + 1;
+    }
+
+    // Input is accepted until the queue is full, except while draining
+    bool _CanAcceptInput() const
+    {
+        return !_draining && (_samples.size() < _inputQueueSize);
+    }
+
+    // Output is produced as soon as a sample is queued: the queue only bounds how far upstream runs ahead
+    bool _HasOutputReady() const
+    {
+        return !_samples.empty();
+    }
+
+    // Values of the "QosPolicy" property
+    enum class QosPolicy
+    {
+        None,
+        Drop,
+        PassThrough,
+        ReducedQuality
+    };
+
+    // What to do with a frame, decided when processing starts
+    enum class QosAction
+    {
+        Process,
+        Drop,
+        PassThrough,
+        ReduceQuality
+    };
+
+    // Source lateness beyond the budget after which the QoS clock is resynchronized, in 100ns units
+    static const long long QosResyncLateness = 10000000; // 1s
+
+    // Values of the "Deinterlace" property
+    enum class DeinterlaceMode
+    {
+        None,
+        Bob,
+        MotionAdaptive
+    };
+
+    // Values of the "Prewarm" property
+    enum class PrewarmMode
+    {
+        None,           // Streaming starts with MFT_MESSAGE_NOTIFY_BEGIN_STREAMING or the first frame, on the calling thread
+        BeginStreaming, // Streaming starts on the thread pool when MFT_MESSAGE_NOTIFY_BEGIN_STREAMING is received
+        TypesSet        // Streaming starts on the thread pool as soon as both media types are set
+    };
+
+    // Largest per-byte change between frames treated as noise by motion-adaptive deinterlacing
+    static const unsigned char DeinterlaceMotionThreshold = 12;
+
+    //
+    // Asynchronous mode
+    //
+
+    // A frame dispatched to the thread pool
+    struct AsyncFrame
+    {
+        AsyncFrame()
+            : Generation(0)
+            , Deadline(MAXLONGLONG)
+            , QueueTime(0)
+            , Lateness(0)
+            , Action(QosAction::Process)
+            , Completed(false)
+            , ProducedData(false)
+            , Result(S_OK)
+        {
+        }
+
+        ::Microsoft::WRL::ComPtr<IMFSample> Input;
+        ::Microsoft::WRL::ComPtr<IMFSample> Output; // Same as Input in pass-through mode
+        long Generation;
+        long long Deadline; // See _GetQosDeadline()
+        long long QueueTime; // LatencyHistogram::Now() when dispatched
+        long long Lateness;
+        QosAction Action;
+        bool Completed;
+        bool ProducedData;
+        HRESULT Result;
+    };
+
+    bool _IsAsync() const
+    {
+        return _asyncFramesInFlight != 0;
+    }
+
+    void _CheckAsyncUnlocked() const
+    {
+        if (_IsAsync() && !MFGetAttributeUINT32(_attributes.Get(), MF_TRANSFORM_ASYNC_UNLOCK, false))
+        {
+            CHK(MF_E_TRANSFORM_ASYNC_LOCKED);
+        }
+    }
+
+    // Frames owned by the effect: being processed or waiting for ProcessOutput()
+    unsigned int _GetAsyncFrameCount() const
+    {
+        return (unsigned int)(_framesInFlight.size() + _outputsReady.size());
+    }
+
+    bool _CanAcceptAsyncInput() const
+    {
+        return _inputRequestCount > 0;
+    }
+
+    // Sends METransformNeedInput until the number of frames owned or requested reaches the limit
+    void _RequestAsyncInputs()
+    {
+        if (!_asyncStarted || _draining || _shutdown || _formatChangePending)
+        {
+            return;
+        }
+
+        while (_GetAsyncFrameCount() + _inputRequestCount < _asyncFramesInFlight)
+        {
+            Microsoft::WRL::ComPtr<IMFMediaEvent> event;
+            CHK(MFCreateMediaEvent(METransformNeedInput, GUID_NULL, S_OK, nullptr, &event));
+            CHK(event->SetUINT32(MF_EVENT_MFT_INPUT_STREAM_ID, 0));
+            CHK(_eventQueue->QueueEvent(event.Get()));
+            _inputRequestCount++;
+        }
+    }
+
+    void _CompleteAsyncDrain()
+    {
+        if (!_draining || (_GetAsyncFrameCount() != 0))
+        {
+            return;
+        }
+
+        Trace("Drain complete");
+
+        Microsoft::WRL::ComPtr<IMFMediaEvent> event;
+        CHK(MFCreateMediaEvent(METransformDrainComplete, GUID_NULL, S_OK, nullptr, &event));
+        CHK(event->SetUINT32(MF_EVENT_MFT_INPUT_STREAM_ID, 0));
+        CHK(_eventQueue->QueueEvent(event.Get()));
+
+        _draining = false;
+        _RequestAsyncInputs();
+    }
+
+    void _DispatchAsyncFrame(_In_ const std::shared_ptr<AsyncFrame>& frame)
+    {
+        // Keep the effect alive until the work item completes
+        ::Microsoft::WRL::ComPtr<IMFTransform> self(static_cast<IMFTransform*>(this));
+
+        Windows::System::Threading::ThreadPool::RunAsync(ref new Windows::System::Threading::WorkItemHandler(
+            [this, self, frame](Windows::Foundation::IAsyncAction^)
+        {
+            concurrency::task<void> processing = concurrency::task_from_result();
+            HRESULT hr = ExceptionBoundary([this, &frame, &processing]()
+            {
+                if (SupportsConcurrentProcessing())
+                {
+                    auto processingLock = _processingLock.LockShared();
+                    processing = _ProcessAsyncFrame(frame);
+                }
+                else
+                {
+                    auto processingLock = _processingLock.LockExclusive();
+                    processing = _ProcessAsyncFrame(frame);
+                }
+            });
+
+            // Frames still in flight complete on whichever thread finishes them
+            if (FAILED(hr) || processing.is_done())
+            {
+                _CompleteAsyncFrame(frame, processing, hr);
+            }
+            else
+            {
+                processing.then([this, self, frame](concurrency::task<void> completed)
+                {
+                    _CompleteAsyncFrame(frame, completed, S_OK);
+                }, concurrency::task_continuation_context::use_arbitrary());
+            }
+        }));
+    }
+
+    void _CompleteAsyncFrame(_In_ const std::shared_ptr<AsyncFrame>& frame, _In_ const concurrency::task<void>& processing, _In_ HRESULT hr)
+    {
+        if (SUCCEEDED(hr))
+        {
+            hr = ExceptionBoundary([&processing]()
+            {
+                processing.get();
+            });
+        }
+
+        auto streamingLock = _LockStreaming();
+
+        frame->Result = hr;
+        frame->Completed = true;
+
+        (void)ExceptionBoundary([this]()
+        {
+            _CompleteAsyncFrames();
+        });
+    }
+
+    // Called with _processingLock held, returns the processing still in flight
+    concurrency::task<void> _ProcessAsyncFrame(_In_ const std::shared_ptr<AsyncFrame>& frame)
+    {
+        // Skip frames flushed or whose streaming session ended before they got processed
+        if (frame->Generation != _processingGeneration)
+        {
+            return concurrency::task_from_result();
+        }
+
+        _queueWaitLatency.Record(LatencyHistogram::Elapsed(frame->QueueTime));
+
+        if (_passthrough)
+        {
+            LatencyHistogram::Scope process(_processLatency);
+            ProcessSample(frame->Input);
+            frame->Output = frame->Input;
+            frame->ProducedData = true;
+        }
+        else
+        {
+            frame->Action = _GetQosAction(frame->Deadline, &frame->Lateness);
+            switch (frame->Action)
+            {
+            case QosAction::Drop:
+                TraceSample(_traceRecords, TraceEvent::FrameDropped, this, frame->Input.Get());
+                frame->ProducedData = false;
+                break;
+
+            case QosAction::PassThrough:
+                frame->Output = frame->Input;
+                frame->ProducedData = true;
+                break;
+
+            case QosAction::ReduceQuality:
+            {
+                LatencyHistogram::Scope process(_processLatency);
+                frame->ProducedData = ProcessSampleReducedQuality(frame->Input, frame->Output);
+            }
+                break;
+
+            default:
+            {
+                long long start = LatencyHistogram::Now();
+                concurrency::task<bool> processing = ProcessSampleAsync(frame->Input, frame->Output);
+                if (!processing.is_done())
+                {
+                    return processing.then([this, frame, start](bool producedData)
+                    {
+                        _processLatency.Record(LatencyHistogram::Elapsed(start));
+                        frame->ProducedData = producedData;
+                    }, concurrency::task_continuation_context::use_arbitrary());
+                }
+                frame->ProducedData = processing.get();
+                _processLatency.Record(LatencyHistogram::Elapsed(start));
+            }
+                break;
+            }
+        }
+
+        return concurrency::task_from_result();
     }
 
-    virtual void ValidateDeviceManager(_In_ const Microsoft::WRL::ComPtr<IMFDXGIDeviceManager>& /*deviceManager*/) const
+    // Moves completed frames to the output list, preserving input order
+    void _CompleteAsyncFrames()
     {
+        while (!_framesInFlight.empty() && _framesInFlight.front()->Completed)
+        {
+            std::shared_ptr<AsyncFrame> frame = _framesInFlight.front();
+            _framesInFlight.pop_front();
+
+            if (FAILED(frame->Result))
+            {
+                Trace("Frame processing failed hr=%08X", frame->Result);
+                CHK(_eventQueue->QueueEventParamVar(MEError, GUID_NULL, frame->Result, nullptr));
+                continue;
+            }
+
+            if (!_passthrough)
+            {
+                _RecordQosAction(frame->Action, frame->Lateness);
+            }
+
+            if (frame->ProducedData)
+            {
+                _outputsReady.push_back(frame->Output);
+                CHK(_eventQueue->QueueEventParamVar(METransformHaveOutput, GUID_NULL, S_OK, nullptr));
+            }
+        }
+
+        _RequestAsyncInputs();
+        _CompleteAsyncDrain();
     }
 
-    Microsoft::WRL::ComPtr<IMFMediaType> _inputType;
-    Microsoft::WRL::ComPtr<IMFMediaType> _outputType;
-    Microsoft::WRL::ComPtr<IMFDXGIDeviceManager> _deviceManager;
-    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> _inputAllocator;  // null if pass-through
-    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> _outputAllocator; // null if pass-through
-    std::vector<unsigned long> _supportedFormats;
-    unsigned int _inputDefaultStride; // Buffer stride when receiving 1D buffers (happens sometimes in MediaElement)
-    unsigned int _outputDefaultStride;
-    bool _passthrough;
-    ::Microsoft::WRL::Wrappers::SRWLock _lock;
+    //
+    // QoS
+    //
 
-    ~Video1in1outEffect()
+    // Called with _streamingLock held
+    // Maps sample times to system times, assuming real-time playback from the first sample on
+    void _UpdateQosClock(_In_ IMFSample *sample)
+    {
+        long long sampleTime;
+        if ((_qosPolicy == QosPolicy::None) || _passthrough || FAILED(sample->GetSampleTime(&sampleTime)))
+        {
+            return;
+        }
+
+        long long systemTime = MFGetSystemTime();
+
+        // Resynchronize on seeks and when the source fell far behind on its own (pause, stall)
+        if (_qosClockValid && 
+            !MFGetAttributeUINT32(sample, MFSampleExtension_Discontinuity, false) &&
+            (systemTime - (_qosClockSystemTime + sampleTime - _qosClockSampleTime) < _qosLatencyBudget + QosResyncLateness))
+        {
+            return;
+        }
+
+        TraceVerbose(_traceVerbose, "QoS clock: sample time %I64i at system time %I64i", sampleTime, systemTime);
+        _qosClockValid = true;
+        _qosClockSystemTime = systemTime;
+        _qosClockSampleTime = sampleTime;
+    }
+
+    // Called with _streamingLock held
+    // Returns the system time by which processing must start, MAXLONGLONG if none
+    long long _GetQosDeadline(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample) const
     {
+        long long sampleTime;
+        if ((_qosPolicy == QosPolicy::None) || !_qosClockValid || FAILED(sample->GetSampleTime(&sampleTime)))
+        {
+            return MAXLONGLONG;
+        }
+        return _qosClockSystemTime + (sampleTime - _qosClockSampleTime) + _qosLatencyBudget;
     }
 
-private:
+    // Called right before processing, with _processingLock held
+    QosAction _GetQosAction(_In_ long long deadline, _Out_ long long *lateness) const
+    {
+        *lateness = 0;
+        if (deadline == MAXLONGLONG)
+        {
+            return QosAction::Process;
+        }
+
+        *lateness = MFGetSystemTime() - deadline;
+        if (*lateness <= 0)
+        {
+            return QosAction::Process;
+        }
+
+        switch (_qosPolicy)
+        {
+        case QosPolicy::PassThrough: return _qosCanPassThrough ? QosAction::PassThrough : QosAction::Drop;
+        case QosPolicy::ReducedQuality: return QosAction::ReduceQuality;
+        default: return QosAction::Drop;
+        }
+    }
+
+    // Called with _streamingLock held
+    void _RecordQosAction(_In_ QosAction action, _In_ long long lateness)
+    {
+        if (_qosPolicy == QosPolicy::None)
+        {
+            return;
+        }
+
+        switch (action)
+        {
+        case QosAction::Drop:
+            TraceVerbose(_traceVerbose, "Dropping frame %I64ims late", lateness / 10000);
+            _qosDroppedCount++;
+            _qosDiscontinuity = true;
+            break;
+        case QosAction::PassThrough:
+            _qosPassedThroughCount++;
+            break;
+        case QosAction::ReduceQuality:
+            _qosReducedQualityCount++;
+            break;
+        default:
+            _qosProcessedCount++;
+            break;
+        }
+
+        if ((lateness > 0) && ((unsigned long long)lateness > _qosLatenessMax))
+        {
+            _qosLatenessMax = lateness;
+        }
+    }
+
+    // Called with _streamingLock held
+    // Flags the first output following dropped frames
+    void _MarkQosDiscontinuity(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample)
+    {
+        if (_qosDiscontinuity)
+        {
+            CHK(sample->SetUINT32(MFSampleExtension_Discontinuity, true));
+            _qosDiscontinuity = false;
+        }
+    }
+
+    bool _HasPendingSamples() const
+    {
+        return !_samples.empty() || !_framesInFlight.empty() || !_outputsReady.empty();
+    }
+
+    // Called with _lock held, shared or exclusive. Returns a copy so callers cannot modify the cached type.
+    ::Microsoft::WRL::ComPtr<IMFMediaType> _GetAvailableType(
+        _Inout_ TypeCache& cache,
+        _In_ unsigned int typeIndex,
+        _In_ const std::function<::Microsoft::WRL::ComPtr<IMFMediaType>()>& createType
+        )
+    {
+        ::Microsoft::WRL::ComPtr<IMFMediaType> cachedType;
+        {
+            auto lock = _typeCacheLock.LockShared();
+            if (typeIndex >= cache.AvailableTypeCount)
+            {
+                InterlockedIncrement(&_typeCacheHitCount);
+                return nullptr;
+            }
+            if (typeIndex < cache.AvailableTypes.size())
+            {
+                cachedType = cache.AvailableTypes[typeIndex];
+            }
+        }
+
+        if (cachedType != nullptr)
+        {
+            InterlockedIncrement(&_typeCacheHitCount);
+        }
+        else
+        {
+            InterlockedIncrement(&_typeCacheMissCount);
+
+            // Invalidation requires _lock held exclusively, so the cache cannot be cleared while the type gets created
+            cachedType = createType();
+
+            auto lock = _typeCacheLock.LockExclusive();
+            if (cachedType == nullptr)
+            {
+                cache.AvailableTypeCount = min(cache.AvailableTypeCount, typeIndex);
+                return nullptr;
+            }
+            if (typeIndex >= cache.AvailableTypes.size())
+            {
+                cache.AvailableTypes.resize(typeIndex + 1);
+            }
+            cache.AvailableTypes[typeIndex] = cachedType;
+        }
+
+        ::Microsoft::WRL::ComPtr<IMFMediaType> type;
+        CHK(MFCreateMediaType(&type));
+        CHK(cachedType->CopyAllItems(type.Get()));
+        return type;
+    }
+
+    // Called with _lock held exclusively. Exceptions thrown by isValidType() are not cached.
+    bool _IsValidTypeCached(
+        _Inout_ TypeCache& cache,
+        _In_ IMFMediaType *type,
+        _In_ const std::function<bool()>& isValidType
+        )
+    {
+        // Matching hashes are confirmed by comparing all the attributes
+        unsigned long long hash = _HashType(type);
+        {
+            auto lock = _typeCacheLock.LockShared();
+            for (const auto& entry : cache.ValidTypes)
+            {
+                BOOL match = false;
+                if ((entry.Hash == hash) && SUCCEEDED(entry.Type->Compare(type, MF_ATTRIBUTES_MATCH_ALL_ITEMS, &match)) && match)
+                {
+                    InterlockedIncrement(&_typeCacheHitCount);
+                    return entry.Valid;
+                }
+            }
+        }
+
+        InterlockedIncrement(&_typeCacheMissCount);
+        bool valid = isValidType();
+
+        // The caller may modify its type afterward: keep a copy. The copy also holds references on IUnknown
+        // attributes, which keeps their addresses from being reused by other objects.
+        ValidType entry;
+        entry.Hash = hash;
+        entry.Valid = valid;
+        CHK(MFCreateMediaType(&entry.Type));
+        CHK(type->CopyAllItems(entry.Type.Get()));
+
+        auto lock = _typeCacheLock.LockExclusive();
+        if (cache.ValidTypes.size() >= TypeCacheMaxValidTypes)
+        {
+            cache.ValidTypes.erase(cache.ValidTypes.begin());
+        }
+        cache.ValidTypes.push_back(std::move(entry));
+        return valid;
+    }
+
+    // Hash of all the attributes of a media type, independent of attribute order
+    static unsigned long long _HashType(_In_ IMFMediaType *type)
+    {
+        unsigned int count;
+        CHK(type->GetCount(&count));
+
+        unsigned long long hash = count;
+        for (unsigned int n = 0; n < count; n++)
+        {
+            GUID key;
+            PropVariant value;
+            CHK(type->GetItemByIndex(n, &key, &value));
+
+            unsigned long long itemHash = _HashBytes(14695981039346656037ull, &key, sizeof(key));
+            itemHash = _HashBytes(itemHash, &value.vt, sizeof(value.vt));
+            switch (value.vt)
+            {
+            case VT_UI4:
+                itemHash = _HashBytes(itemHash, &value.ulVal, sizeof(value.ulVal));
+                break;
+            case VT_UI8:
+                itemHash = _HashBytes(itemHash, &value.uhVal, sizeof(value.uhVal));
+                break;
+            case VT_R8:
+                itemHash = _HashBytes(itemHash, &value.dblVal, sizeof(value.dblVal));
+                break;
+            case VT_CLSID:
+                itemHash = _HashBytes(itemHash, value.puuid, sizeof(*value.puuid));
+                break;
+            case VT_LPWSTR:
+                itemHash = _HashBytes(itemHash, value.pwszVal, wcslen(value.pwszVal) * sizeof(wchar_t));
+                break;
+            case VT_VECTOR | VT_UI1:
+                itemHash = _HashBytes(itemHash, value.caub.pElems, value.caub.cElems);
+                break;
+            case VT_UNKNOWN:
+                itemHash = _HashBytes(itemHash, &value.punkVal, sizeof(value.punkVal)); // Object identity, as in IMFAttributes::Compare()
+                break;
+            }
+
+            hash += itemHash;
+        }
+
+        return hash;
+    }
+
+    // FNV-1a
+    static unsigned long long _HashBytes(_In_ unsigned long long hash, _In_reads_bytes_(size) const void *data, _In_ size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    HRESULT _PublishLockStatistics()
+    {
+        HRESULT hr;
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_STATE_LOCK_CONTENTIONS, (unsigned int)_stateLockContentionCount));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_STREAMING_LOCK_CONTENTIONS, (unsigned int)_streamingLockContentionCount));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_TYPE_CACHE_HITS, (unsigned int)_typeCacheHitCount));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_TYPE_CACHE_MISSES, (unsigned int)_typeCacheMissCount));
+        return S_OK;
+    }
+
+    // Histograms and copy counters are updated without locks. The summaries are only rebuilt when something was
+    // recorded since the previous call, which keeps GetAttributes() cheap when polled.
+    HRESULT _PublishLatencyStatistics()
+    {
+        long long recordCount = _GetLatencyRecordCount();
+        if (InterlockedExchange64(&_latencyRecordCount, recordCount) == recordCount)
+        {
+            return S_OK;
+        }
+
+        HRESULT hr = _PublishLatencySummary(VE_STATISTICS_LATENCY_NORMALIZE, _normalizeLatency);
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLatencySummary(VE_STATISTICS_LATENCY_ALLOCATE, _allocateLatency);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLatencySummary(VE_STATISTICS_LATENCY_PROCESS, _processLatency);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLatencySummary(VE_STATISTICS_LATENCY_LOCK_WAIT, _lockWaitLatency);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _PublishLatencySummary(VE_STATISTICS_LATENCY_QUEUE_WAIT, _queueWaitLatency);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _attributes->SetUINT64(VE_STATISTICS_COPIES, (unsigned long long)_copyCount);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = _attributes->SetUINT64(VE_STATISTICS_COPY_BYTES, (unsigned long long)_copyBytes);
+        }
+        if (FAILED(hr))
+        {
+            InterlockedExchange64(&_latencyRecordCount, -1); // Retry on the next call
+        }
+        return hr;
+    }
+
+    // The JSON dump lists every non-empty bucket, so it is only built when streaming ends rather than on each GetAttributes()
+    HRESULT _PublishLatencyJson()
+    {
+        std::wstring json;
+        HRESULT hr;
+        CHK_RETURN(ExceptionBoundary([this, &json]()
+        {
+            json = L"{\"unit\":\"100ns\"";
+            json += L",\"normalize\":";
+            _normalizeLatency.AppendJson(json);
+            json += L",\"allocate\":";
+            _allocateLatency.AppendJson(json);
+            json += L",\"process\":";
+            _processLatency.AppendJson(json);
+            json += L",\"lockWait\":";
+            _lockWaitLatency.AppendJson(json);
+            json += L",\"queueWait\":";
+            _queueWaitLatency.AppendJson(json);
+            json += L",\"copies\":" + std::to_wstring((unsigned long long)_copyCount);
+            json += L",\"copyBytes\":" + std::to_wstring((unsigned long long)_copyBytes);
+            json += L"}";
+        }));
+        CHK_RETURN(_attributes->SetString(VE_STATISTICS_LATENCY_JSON, json.c_str()));
+        return S_OK;
+    }
+
+    // Total number of values recorded in the latency histograms and copy counters
+    long long _GetLatencyRecordCount() const
+    {
+        return (long long)(
+            _normalizeLatency.GetCount() +
+            _allocateLatency.GetCount() +
+            _processLatency.GetCount() +
+            _lockWaitLatency.GetCount() +
+            _queueWaitLatency.GetCount()
+            ) + _copyCount;
+    }
+
+    HRESULT _PublishLatencySummary(_In_ REFGUID key, _In_ const LatencyHistogram& histogram)
+    {
+        LatencyHistogram::Summary summary = histogram.GetSummary();
+        return _attributes->SetBlob(key, reinterpret_cast<const UINT8*>(&summary), sizeof(summary));
+    }
+
+    // Called with _streamingLock held
+    HRESULT _PublishStatistics()
+    {
+        HRESULT hr;
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_QUEUE_DEPTH, (unsigned int)_samples.size()));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_QUEUE_DEPTH_MAX, _inputQueueDepthMax));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_QUEUE_CAPACITY, _inputQueueSize));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_INPUT_SAMPLES, _inputSampleCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_INPUT_SAMPLES_REJECTED, _inputSampleRejectedCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_OUTPUT_SAMPLES, _outputSampleCount));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_ASYNC_FRAMES_IN_FLIGHT, _GetAsyncFrameCount()));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_ASYNC_FRAMES_IN_FLIGHT_MAX, _asyncFramesInFlightMax));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_ALLOCATOR_IN_USE, _inputAllocator != nullptr ? _inputAllocator->GetInUseCount() : 0));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_ALLOCATOR_IN_USE_MAX, max(_inputAllocatorInUseMax, _inputAllocator != nullptr ? _inputAllocator->GetInUseCountMax() : 0)));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_INPUT_ALLOCATOR_FREE, _inputAllocator != nullptr ? _inputAllocator->GetFreeCount() : 0));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_OUTPUT_ALLOCATOR_IN_USE, _outputAllocator != nullptr ? _outputAllocator->GetInUseCount() : 0));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_OUTPUT_ALLOCATOR_IN_USE_MAX, max(_outputAllocatorInUseMax, _outputAllocator != nullptr ? _outputAllocator->GetInUseCountMax() : 0)));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_OUTPUT_ALLOCATOR_FREE, _outputAllocator != nullptr ? _outputAllocator->GetFreeCount() : 0));
+        CHK_RETURN(_attributes->SetUINT32(VE_STATISTICS_ALLOCATOR_TRIMS, _allocatorTrimCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_NONE, _normalizeNoneCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_ZERO_COPY, _normalizeZeroCopyCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_GATHER, _normalizeGatherCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_CONTIGUOUS, _normalizeContiguousCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_1D_TO_2D, _normalize1DTo2DCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_NORMALIZE_TEXTURE_COPY, _normalizeTextureCopyCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_QOS_FRAMES_PROCESSED, _qosProcessedCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_QOS_FRAMES_DROPPED, _qosDroppedCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_QOS_FRAMES_PASSED_THROUGH, _qosPassedThroughCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_QOS_FRAMES_REDUCED_QUALITY, _qosReducedQualityCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_QOS_LATENESS_MAX, _qosLatenessMax));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_DEINTERLACE_FRAMES, _deinterlaceFrameCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_DEINTERLACE_TIME, _deinterlaceTime));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_FORMAT_CHANGES, _formatChangeCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_FORMAT_CHANGE_ALLOCATORS_REUSED, _formatChangeAllocatorReuseCount));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_FIRST_FRAME_LATENCY, _firstFrameLatency));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_STREAMING_START_TIME, _streamingStartTime));
+        CHK_RETURN(_attributes->SetUINT64(VE_STATISTICS_PREWARM_COUNT, _prewarmCount));
+        return S_OK;
+    }
 
     _Ret_maybenull_ ::Microsoft::WRL::ComPtr<IMFMediaType> _CreatePartialType(_In_ DWORD typeIndex) const
     {
@@ -861,10 +2438,10 @@ private:
         }
 
         unsigned int interlacing = MFGetAttributeUINT32(type.Get(), MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
-        if ((interlacing == MFVideoInterlace_FieldInterleavedUpperFirst) ||
-            (interlacing == MFVideoInterlace_FieldInterleavedLowerFirst) ||
-            (interlacing == MFVideoInterlace_FieldSingleUpper) ||
-            (interlacing == MFVideoInterlace_FieldSingleLower))
+        if ((interlacing == MFVideoInterlace_FieldSingleUpper) ||
+            (interlacing == MFVideoInterlace_FieldSingleLower) ||
+            (((interlacing == MFVideoInterlace_FieldInterleavedUpperFirst) || (interlacing == MFVideoInterlace_FieldInterleavedLowerFirst)) && 
+                !_IsDeinterlacedType(type)))
         {
             // Note: MFVideoInterlace_MixedInterlaceOrProgressive is allowed here and interlacing checked via MFSampleExtension_Interlaced 
             // on samples themselves
@@ -887,7 +2464,8 @@ private:
         _In_opt_ const Microsoft::WRL::ComPtr<IMFMediaType>& type, 
         _Out_ unsigned int *defaultStride,
         _Out_ unsigned int *defaultSize,
-        _Out_opt_ bool *progressive = nullptr
+        _Out_opt_ bool *progressive = nullptr,
+        _Out_opt_ bool *bottomUp = nullptr
         )
     {
         if (type == nullptr)
@@ -898,45 +2476,51 @@ private:
             {
                 *progressive = false;
             }
+            if (bottomUp != nullptr)
+            {
+                *bottomUp = false;
+            }
             return;
         }
 
         unsigned int stride;
-        if (FAILED(type->GetUINT32(MF_MT_DEFAULT_STRIDE, &stride)))
+        bool hasStride = SUCCEEDED(type->GetUINT32(MF_MT_DEFAULT_STRIDE, &stride));
+        if (!hasStride)
         {
             stride = 0;
         }
 
-        if ((int)stride < 0)
-        {
-            CHK(OriginateError(E_INVALIDARG, L"Negative stride not supported"));
-        }
-
         GUID subtype;
         unsigned int width;
         unsigned int height;
         CHK(type->GetGUID(MF_MT_SUBTYPE, &subtype));
         CHK(MFGetAttributeSize(type.Get(), MF_MT_FRAME_SIZE, &width, &height));
 
+        // Formats with an opaque layout (420O for instance) can only be handled by pass-through effects,
+        // which never look at the content of buffers
         unsigned int size = 0;
-        if (subtype == MFVideoFormat_NV12)
-        {
-            stride = stride != 0 ? stride : width;
-            size = (3 * stride * height) / 2;
-        }
-        else if ((subtype == MFVideoFormat_YUY2) || (subtype == MFVideoFormat_UYVY))
+        const VideoFormat::FormatInfo *format = VideoFormat::Find(subtype.Data1);
+
+        // RGB rows are stored bottom-up unless the stride says otherwise
+        bool isBottomUp = (format != nullptr) && format->BottomUp && (!hasStride || ((int)stride < 0));
+        if ((int)stride < 0)
         {
-            stride = stride != 0 ? stride : ((2 * width) + 3) & ~3; // DWORD aligned
-            size = stride * height;
+            if ((format != nullptr) && !format->BottomUp)
+            {
+                CHK(OriginateError(E_INVALIDARG, L"Negative stride only supported for RGB"));
+            }
+            stride = (unsigned int)(-(int)stride);
         }
-        else if ((subtype == MFVideoFormat_ARGB32) || (subtype == MFVideoFormat_RGB32))
+
+        if (format != nullptr)
         {
-            stride = stride != 0 ? stride : 4 * width;
-            size = stride * height;
+            stride = stride != 0 ? stride : VideoFormat::GetDefaultPitch(*format, width);
+            size = VideoFormat::GetFrameSize(*format, stride, height);
         }
         else
         {
-            CHK(OriginateError(E_INVALIDARG, L"Unknown format"));
+            Trace("Unknown layout for format %08X", subtype.Data1);
+            stride = 0;
         }
 
         if (progressive != nullptr)
@@ -946,14 +2530,36 @@ private:
                 (interlacedMode == MFVideoInterlace_Progressive);
         }
 
+        if (bottomUp != nullptr)
+        {
+            *bottomUp = isBottomUp;
+        }
+
         *defaultStride = stride;
         *defaultSize = size;
     }
 
-    // Enforce the input sample contains a single 2D buffer, making copies as necessary
+    // True if ProcessSample() reads the input buffers in place whatever their layout
+    bool _IsInPlaceInput() const
+    {
+        if (!_inPlaceRgbInput)
+        {
+            return false;
+        }
+
+        GUID subtype;
+        CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
+        const VideoFormat::FormatInfo *format = VideoFormat::Find(subtype.Data1);
+        return (format != nullptr) && format->BottomUp;
+    }
+
+    // Enforce the input sample contains a single 2D buffer, making copies as necessary.
+    // 1D RGB buffers are left as they are for effects reading them in place.
+    // Each sample is counted once, in the statistic of the last normalization step applied to it.
     ::Microsoft::WRL::ComPtr<IMFSample> _NormalizeSample(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample)
     {
         ::Microsoft::WRL::ComPtr<IMFSample> normalizedSample;
+        unsigned long long *normalizeCount = &_normalizeNoneCount;
 
         // Merge multiple buffers to get a single one
         ::Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer1D;
@@ -965,17 +2571,73 @@ private:
         }
         else
         {
-            Trace("%i buffers, calling ConvertToContiguousBuffer() to normalize", bufferCount);
-            CHK(sample->ConvertToContiguousBuffer(&buffer1D));
+            unsigned long nonEmptyBufferCount = 0;
+            bool hasDXGIBuffers = false;
+            ::Microsoft::WRL::ComPtr<IMFMediaBuffer> frameBuffer; // First buffer holding a whole frame on its own
+            for (unsigned long n = 0; n < bufferCount; n++)
+            {
+                ::Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer;
+                ::Microsoft::WRL::ComPtr<IMFDXGIBuffer> bufferDXGI;
+                ::Microsoft::WRL::ComPtr<IMF2DBuffer> buffer2D;
+                unsigned long length;
+                CHK(sample->GetBufferByIndex(n, &buffer));
+                CHK(buffer->GetCurrentLength(&length));
+                bool isDXGI = SUCCEEDED(buffer.As(&bufferDXGI));
+                hasDXGIBuffers = hasDXGIBuffers || isDXGI;
+                if (length != 0)
+                {
+                    nonEmptyBufferCount++;
+                    buffer1D = buffer;
+
+                    // Textures and 2D buffers always hold whole frames, 1D buffers do if large enough
+                    if ((frameBuffer == nullptr) &&
+                        (isDXGI || SUCCEEDED(buffer.As(&buffer2D)) || ((_inputDefaultSize != 0) && (length >= _inputDefaultSize))))
+                    {
+                        frameBuffer = buffer;
+                    }
+                }
+            }
+
+            if (nonEmptyBufferCount == 1)
+            {
+                // Only one buffer has data: use it directly
+                TraceVerbose(_traceVerbose, "%i buffers, using the only non-empty one", bufferCount);
+                normalizeCount = &_normalizeZeroCopyCount;
+            }
+            else if (frameBuffer != nullptr)
+            {
+                // The frame is already laid out in one buffer, the others only hold trailing data
+                TraceVerbose(_traceVerbose, "%i buffers, using the first one holding a whole frame", bufferCount);
+                buffer1D = frameBuffer;
+                normalizeCount = &_normalizeZeroCopyCount;
+            }
+            else if (!hasDXGIBuffers && (_inputDefaultSize != 0))
+            {
+                TraceVerbose(_traceVerbose, "%i buffers, gathering into a 2D buffer", bufferCount);
+                _normalizeGatherCount++;
+                _RecordCopy(_inputDefaultSize);
+                return _GatherBuffers(sample, bufferCount);
+            }
+            else
+            {
+                TraceVerbose(_traceVerbose, "%i buffers, calling ConvertToContiguousBuffer() to normalize", bufferCount);
+                normalizeCount = &_normalizeContiguousCount;
+                CHK(sample->ConvertToContiguousBuffer(&buffer1D));
+
+                unsigned long length;
+                CHK(buffer1D->GetCurrentLength(&length));
+                _RecordCopy(length);
+            }
         }
 
-        // Convert 1D CPU buffers to 2D CPU buffers
+        // Convert 1D CPU buffers to 2D CPU buffers, unless the effect reads them in place
         ::Microsoft::WRL::ComPtr<IMF2DBuffer2> buffer2D;
-        if (FAILED(buffer1D.As(&buffer2D)))
+        if (FAILED(buffer1D.As(&buffer2D)) && !_IsInPlaceInput())
         {
-            Trace("Converting 1D buffer to 2D CPU buffer");
+            TraceVerbose(_traceVerbose, "Converting 1D buffer to 2D CPU buffer");
+            normalizeCount = &_normalize1DTo2DCount;
 
-            CHK(_inputAllocator->AllocateSample(&normalizedSample));
+            normalizedSample = _AllocateSample(_inputAllocator);
 
             ::Microsoft::WRL::ComPtr<IMFMediaBuffer> normalizedBuffer1D;
             ::Microsoft::WRL::ComPtr<IMF2DBuffer2> normalizedBuffer2D;
@@ -985,8 +2647,8 @@ private:
             GUID subtype;
             unsigned int width;
             unsigned int height;
-            CHK(_outputType->GetGUID(MF_MT_SUBTYPE, &subtype));
-            CHK(MFGetAttributeSize(_outputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+            CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
+            CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
 
             // Copy the buffer
             unsigned long capacity;
@@ -994,9 +2656,11 @@ private:
             unsigned char* pBuffer = nullptr;
             CHK(buffer1D->Lock(&pBuffer, &capacity, &length));
             Buffer1DUnlocker buffer1DUnlocker(buffer1D);
-            if ((subtype == MFVideoFormat_ARGB32) || (subtype == MFVideoFormat_RGB32))
+            _RecordCopy(length);
+            const VideoFormat::FormatInfo *format = VideoFormat::Find(subtype.Data1);
+            if ((format != nullptr) && format->BottomUp && _inputBottomUp)
             {
-                // RGB in system memory in bottom-up and ContiguousCopyFrom() does not handle the vertical flipping needed
+                // RGB in system memory is usually bottom-up and ContiguousCopyFrom() does not handle the vertical flipping needed
                 // so do a custom copy here
 
                 unsigned long normalizedCapacity;
@@ -1017,14 +2681,14 @@ private:
                     CHK(OriginateError(MF_E_BUFFERTOOSMALL));
                 }
 
-                CHK(MFCopyImage(
+                ImageCopy::CopyRows(
                     pNormalizedScanline0,
                     normalizedStride,
                     pBuffer + _inputDefaultStride * (height - 1),
-                    -(int)_inputDefaultStride,
-                    4 * width,
+                    -(long)_inputDefaultStride,
+                    format->BytesPerPixel * width,
                     height
-                    ));
+                    );
             }
             else
             {
@@ -1033,6 +2697,24 @@ private:
 
             _CopySampleProperties(sample, normalizedSample);
         }
+        else if (bufferCount != 1)
+        {
+            // Wrap the single buffer in a new sample
+            CHK(MFCreateSample(&normalizedSample));
+            CHK(normalizedSample->AddBuffer(buffer1D.Get()));
+
+            long long time;
+            if (SUCCEEDED(sample->GetSampleTime(&time)))
+            {
+                CHK(normalizedSample->SetSampleTime(time));
+            }
+            long long duration;
+            if (SUCCEEDED(sample->GetSampleDuration(&duration)))
+            {
+                CHK(normalizedSample->SetSampleDuration(duration));
+            }
+            CHK(sample->CopyAllItems(normalizedSample.Get()));
+        }
 
         // Ensure DXGI buffers have D3D11_BIND_SHADER_RESOURCE
         // On Phone 8.1, input textures may only have D3D11_BIND_DECODER
@@ -1049,9 +2731,11 @@ private:
 
             if (!(texDesc.BindFlags & D3D11_BIND_SHADER_RESOURCE))
             {
-                Trace("Copying DX texture to enable D3D11_BIND_SHADER_RESOURCE");
+                TraceVerbose(_traceVerbose, "Copying DX texture to enable D3D11_BIND_SHADER_RESOURCE");
+                normalizeCount = &_normalizeTextureCopyCount;
+                _RecordCopy(_inputDefaultSize);
 
-                CHK(_inputAllocator->AllocateSample(&normalizedSample));
+                normalizedSample = _AllocateSample(_inputAllocator);
 
                 ::Microsoft::WRL::ComPtr<IMFMediaBuffer> normalizedBuffer1D;
                 ::Microsoft::WRL::ComPtr<IMFDXGIBuffer> normalizedBufferDXGI;
@@ -1087,9 +2771,271 @@ private:
             }
         }
 
+        (*normalizeCount)++;
+
         return normalizedSample != nullptr ? normalizedSample : sample;
     }
 
+    // Copies the buffers of a multi-buffer CPU sample into a pooled 2D buffer in a single pass,
+    // instead of ConvertToContiguousBuffer() followed by a 1D-to-2D copy.
+    // The buffers hold a packed frame: planes back to back, rows of _inputDefaultStride bytes in the first plane.
+    ::Microsoft::WRL::ComPtr<IMFSample> _GatherBuffers(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample, _In_ unsigned long bufferCount)
+    {
+        GUID subtype;
+        unsigned int width;
+        unsigned int height;
+        CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
+        CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+
+        const VideoFormat::FormatInfo *format = VideoFormat::Find(subtype.Data1);
+        CHKNULL(format);
+
+        ::Microsoft::WRL::ComPtr<IMFSample> normalizedSample;
+        ::Microsoft::WRL::ComPtr<IMFMediaBuffer> normalizedBuffer1D;
+        ::Microsoft::WRL::ComPtr<IMF2DBuffer2> normalizedBuffer2D;
+        normalizedSample = _AllocateSample(_inputAllocator);
+        CHK(normalizedSample->GetBufferByIndex(0, &normalizedBuffer1D));
+        CHK(normalizedBuffer1D.As(&normalizedBuffer2D));
+
+        unsigned long normalizedCapacity;
+        long normalizedStride;
+        unsigned char *pNormalizedScanline0 = nullptr;
+        unsigned char *pNormalizedBuffer = nullptr;
+        CHK(normalizedBuffer2D->Lock2DSize(
+            MF2DBuffer_LockFlags_Write,
+            &pNormalizedScanline0,
+            &normalizedStride,
+            &pNormalizedBuffer,
+            &normalizedCapacity
+            ));
+        Buffer2DUnlocker normalizedBuffer2DUnlocker(normalizedBuffer2D);
+
+        // Walk the rows of the packed frame plane by plane, rows may straddle buffer boundaries.
+        // Only the visible bytes of each row are copied: the input stride may be padded beyond the normalized pitch.
+        unsigned int plane = 0;
+        unsigned char *pNormalizedPlane = pNormalizedScanline0;
+        long normalizedPitch = normalizedStride;
+        unsigned int pitch = _inputDefaultStride;
+        unsigned int frameRowBytes = VideoFormat::GetDefaultPitch(*format, width);
+        unsigned int rowBytes = min(frameRowBytes, (unsigned int)normalizedPitch);
+        unsigned int rowCount = VideoFormat::GetPlaneRowCount(*format, 0, height);
+        unsigned int row = 0;
+        unsigned int rowOffset = 0;
+        for (unsigned long n = 0; (n < bufferCount) && (plane < format->PlaneCount); n++)
+        {
+            ::Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer;
+            CHK(sample->GetBufferByIndex(n, &buffer));
+
+            unsigned long capacity;
+            unsigned long length;
+            unsigned char* pBuffer = nullptr;
+            CHK(buffer->Lock(&pBuffer, &capacity, &length));
+            Buffer1DUnlocker bufferUnlocker(buffer);
+
+            while ((length > 0) && (plane < format->PlaneCount))
+            {
+                unsigned int count = min(length, pitch - rowOffset);
+                if (rowOffset < rowBytes)
+                {
+                    long normalizedRow = _inputBottomUp ? (long)(rowCount - 1 - row) : (long)row;
+                    ImageCopy::CopyRow(pNormalizedPlane + normalizedRow * normalizedPitch + rowOffset, pBuffer, min(count, rowBytes - rowOffset));
+                }
+
+                pBuffer += count;
+                length -= count;
+                rowOffset += count;
+                if (rowOffset == pitch)
+                {
+                    rowOffset = 0;
+                    row++;
+                }
+
+                if (row == rowCount)
+                {
+                    // Next plane, stored right after this one in the 2D buffer too
+                    pNormalizedPlane += normalizedPitch * (long)rowCount;
+                    row = 0;
+                    plane++;
+                    if (plane < format->PlaneCount)
+                    {
+                        normalizedPitch = normalizedStride / (long)format->Planes[plane].PitchDivisor;
+                        pitch = VideoFormat::GetPlanePitch(*format, plane, _inputDefaultStride);
+                        rowBytes = min(VideoFormat::GetPlanePitch(*format, plane, frameRowBytes), (unsigned int)normalizedPitch);
+                        rowCount = VideoFormat::GetPlaneRowCount(*format, plane, height);
+                    }
+                }
+            }
+        }
+
+        if (plane < format->PlaneCount)
+        {
+            CHK(OriginateError(MF_E_BUFFERTOOSMALL));
+        }
+
+        _CopySampleProperties(sample, normalizedSample);
+
+        return normalizedSample;
+    }
+
+    // True if the effect deinterlaces frames of the given type: deinterlacing enabled, interlaced type, 8-bit YUV format
+    bool _IsDeinterlacedType(_In_opt_ const Microsoft::WRL::ComPtr<IMFMediaType>& type) const
+    {
+        if ((_deinterlaceMode == DeinterlaceMode::None) || (type == nullptr))
+        {
+            return false;
+        }
+
+        unsigned int interlacing = MFGetAttributeUINT32(type.Get(), MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+        if ((interlacing != MFVideoInterlace_FieldInterleavedUpperFirst) &&
+            (interlacing != MFVideoInterlace_FieldInterleavedLowerFirst) &&
+            (interlacing != MFVideoInterlace_MixedInterlaceOrProgressive))
+        {
+            return false;
+        }
+
+        GUID subtype;
+        if (FAILED(type->GetGUID(MF_MT_SUBTYPE, &subtype)))
+        {
+            return false;
+        }
+        return (subtype == MFVideoFormat_NV12) || (subtype == MFVideoFormat_YUY2) || (subtype == MFVideoFormat_UYVY);
+    }
+
+    // True if the first buffer of a normalized sample is a texture, which _DeinterlaceSample() cannot read in place
+    static bool _HasDXGIBuffer(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample)
+    {
+        ::Microsoft::WRL::ComPtr<IMFMediaBuffer> buffer;
+        ::Microsoft::WRL::ComPtr<IMFDXGIBuffer> bufferDXGI;
+        CHK(sample->GetBufferByIndex(0, &buffer));
+        return SUCCEEDED(buffer.As(&bufferDXGI));
+    }
+
+    // Called with _streamingLock held. Deinterlaces a normalized system-memory input sample into a pooled sample
+    // in a single pass.
+    ::Microsoft::WRL::ComPtr<IMFSample> _DeinterlaceSample(_In_ const ::Microsoft::WRL::ComPtr<IMFSample>& sample, _In_ bool bottomFieldFirst)
+    {
+        long long start = LatencyHistogram::Now();
+
+        GUID subtype;
+        unsigned int width;
+        unsigned int height;
+        CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
+        CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+        const VideoFormat::FormatInfo *format = VideoFormat::Find(subtype.Data1);
+        CHKNULL(format);
+
+        // Motion detection compares the kept field with the kept field of the previous frame, which must be the same field
+        if ((_deinterlacePrevious != nullptr) &&
+            ((_deinterlacePreviousBottomFieldFirst != bottomFieldFirst) || MFGetAttributeUINT32(sample.Get(), MFSampleExtension_Discontinuity, false)))
+        {
+            _deinterlacePrevious = nullptr;
+        }
+
+        ::Microsoft::WRL::ComPtr<IMFSample> deinterlacedSample;
+        deinterlacedSample = _AllocateSample(_inputAllocator);
+
+        {
+            ::Microsoft::WRL::ComPtr<IMFMediaBuffer> inputBuffer1D;
+            ::Microsoft::WRL::ComPtr<IMF2DBuffer2> inputBuffer2D;
+            CHK(sample->GetBufferByIndex(0, &inputBuffer1D));
+            CHK(inputBuffer1D.As(&inputBuffer2D));
+
+            unsigned long inputCapacity;
+            long inputStride;
+            unsigned char *pInputScanline0 = nullptr;
+            unsigned char *pInputBuffer = nullptr;
+            CHK(inputBuffer2D->Lock2DSize(MF2DBuffer_LockFlags_Read, &pInputScanline0, &inputStride, &pInputBuffer, &inputCapacity));
+            Buffer2DUnlocker inputBuffer2DUnlocker(inputBuffer2D);
+
+            ::Microsoft::WRL::ComPtr<IMFMediaBuffer> outputBuffer1D;
+            ::Microsoft::WRL::ComPtr<IMF2DBuffer2> outputBuffer2D;
+            CHK(deinterlacedSample->GetBufferByIndex(0, &outputBuffer1D));
+            CHK(outputBuffer1D.As(&outputBuffer2D));
+
+            unsigned long outputCapacity;
+            long outputStride;
+            unsigned char *pOutputScanline0 = nullptr;
+            unsigned char *pOutputBuffer = nullptr;
+            CHK(outputBuffer2D->Lock2DSize(MF2DBuffer_LockFlags_Write, &pOutputScanline0, &outputStride, &pOutputBuffer, &outputCapacity));
+            Buffer2DUnlocker outputBuffer2DUnlocker(outputBuffer2D);
+
+            long previousStride = 0;
+            unsigned char *pPreviousScanline0 = nullptr;
+            std::unique_ptr<Buffer2DUnlocker> previousBuffer2DUnlocker;
+            if (_deinterlacePrevious != nullptr)
+            {
+                ::Microsoft::WRL::ComPtr<IMFMediaBuffer> previousBuffer1D;
+                ::Microsoft::WRL::ComPtr<IMF2DBuffer2> previousBuffer2D;
+                CHK(_deinterlacePrevious->GetBufferByIndex(0, &previousBuffer1D));
+                CHK(previousBuffer1D.As(&previousBuffer2D));
+
+                unsigned long previousCapacity;
+                unsigned char *pPreviousBuffer = nullptr;
+                CHK(previousBuffer2D->Lock2DSize(MF2DBuffer_LockFlags_Read, &pPreviousScanline0, &previousStride, &pPreviousBuffer, &previousCapacity));
+                previousBuffer2DUnlocker.reset(new Buffer2DUnlocker(previousBuffer2D));
+            }
+
+            Deinterlace::Mode mode = _deinterlaceMode == DeinterlaceMode::MotionAdaptive ? Deinterlace::Mode::MotionAdaptive : Deinterlace::Mode::Bob;
+            unsigned int rowLength = format->BytesPerPixel * width;
+            for (unsigned int plane = 0; plane < format->PlaneCount; plane++)
+            {
+                long divisor = (long)format->Planes[plane].PitchDivisor;
+                unsigned int rowCount = VideoFormat::GetPlaneRowCount(*format, plane, height);
+
+                Deinterlace::ProcessPlane(
+                    pOutputScanline0,
+                    outputStride / divisor,
+                    pInputScanline0,
+                    inputStride / divisor,
+                    pPreviousScanline0,
+                    previousStride / divisor,
+                    rowLength / divisor,
+                    rowCount,
+                    bottomFieldFirst,
+                    mode,
+                    DeinterlaceMotionThreshold
+                    );
+
+                // Planes are stored one after the other
+                pOutputScanline0 += (outputStride / divisor) * (long)rowCount;
+                pInputScanline0 += (inputStride / divisor) * (long)rowCount;
+                if (pPreviousScanline0 != nullptr)
+                {
+                    pPreviousScanline0 += (previousStride / divisor) * (long)rowCount;
+                }
+            }
+        }
+
+        _CopySampleProperties(sample, deinterlacedSample);
+        CHK(deinterlacedSample->SetUINT32(MFSampleExtension_Interlaced, false));
+        (void)deinterlacedSample->DeleteItem(MFSampleExtension_BottomFieldFirst);
+        (void)deinterlacedSample->DeleteItem(MFSampleExtension_RepeatFirstField);
+
+        // Only motion-adaptive deinterlacing looks at the previous frame
+        if (_deinterlaceMode == DeinterlaceMode::MotionAdaptive)
+        {
+            _deinterlacePrevious = deinterlacedSample;
+            _deinterlacePreviousBottomFieldFirst = bottomFieldFirst;
+        }
+
+        _deinterlaceFrameCount++;
+        _RecordCopy(_inputDefaultSize);
+        _deinterlaceTime += LatencyHistogram::Elapsed(start);
+
+        return deinterlacedSample;
+    }
+
+    // Called with _streamingLock held: only takes the state lock on the first call
+    void _StartStreamingIfNeeded()
+    {
+        if (!_streaming)
+        {
+            auto lock = _LockState();
+            _SetStreamingState(true);
+        }
+    }
+
+    // Called with _streamingLock and _lock held
     void _SetStreamingState(bool streaming)
     {
         if (streaming && !_streaming)
@@ -1101,81 +3047,377 @@ private:
                 CHK(OriginateError(MF_E_INVALIDREQUEST, L"Streaming started without an input media type"));
             }
 
-            // Create the sample allocators
-            if (!_passthrough)
-            {
-                if (_deviceManager == nullptr)
-                {
-                    // Input allocator
-                    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> inputAllocator;
-                    CHK(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&inputAllocator)));
-                    CHK(inputAllocator->InitializeSampleAllocatorEx(1, 50, nullptr, _inputType.Get()));
-
-                    // Output allocator
-                    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> outputAllocator;
-                    CHK(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&outputAllocator)));
-                    CHK(outputAllocator->InitializeSampleAllocatorEx(1, 50, nullptr, _outputType.Get()));
-
-                    _inputAllocator = inputAllocator;
-                    _outputAllocator = outputAllocator;
-                }
-                else
-                {
-                    // Input allocator -- only needs D3D11_BIND_SHADER_RESOURCE
-                    Microsoft::WRL::ComPtr<IMFAttributes> inputAttr;
-                    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> inputAllocator;
-                    CHK(MFCreateAttributes(&inputAttr, 3));
-                    CHK(inputAttr->SetUINT32(MF_SA_BUFFERS_PER_SAMPLE, 1));
-                    CHK(inputAttr->SetUINT32(MF_SA_D3D11_USAGE, D3D11_USAGE_DEFAULT));
-                    CHK(inputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, D3D11_BIND_SHADER_RESOURCE));
-                    CHK(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&inputAllocator)));
-                    CHK(inputAllocator->SetDirectXManager(_deviceManager.Get()));
-                    CHK(inputAllocator->InitializeSampleAllocatorEx(1, 50, inputAttr.Get(), _inputType.Get()));
-
-                    // Output allocator -- if possible respect bind flags requested by downstream component via GetOutputStreamAttributes()
-                    Microsoft::WRL::ComPtr<IMFAttributes> outputAttr;
-                    Microsoft::WRL::ComPtr<IMFVideoSampleAllocatorEx> outputAllocator;
-                    CHK(MFCreateAttributes(&outputAttr, 3));
-                    CHK(outputAttr->SetUINT32(MF_SA_BUFFERS_PER_SAMPLE, 1));
-                    CHK(outputAttr->SetUINT32(MF_SA_D3D11_USAGE, D3D11_USAGE_DEFAULT));
-                    unsigned int outputBindFlags = MFGetAttributeUINT32(_outputAttributes.Get(), MF_SA_D3D11_BINDFLAGS, D3D11_BIND_RENDER_TARGET);
-                    outputBindFlags |= D3D11_BIND_RENDER_TARGET; // D3D11_BIND_RENDER_TARGET required, D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_VIDEO_ENCODER optional
-                    CHK(outputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, outputBindFlags));
-                    CHK(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&outputAllocator)));
-                    CHK(outputAllocator->SetDirectXManager(_deviceManager.Get()));
-
-                    if (FAILED(outputAllocator->InitializeSampleAllocatorEx(1, 50, outputAttr.Get(), _outputType.Get())))
-                    {
-                        // Try again with only D3D11_BIND_RENDER_TARGET (downstream component will have to make a copy)
-                        CHK(outputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, D3D11_BIND_RENDER_TARGET));
-                        CHK(outputAllocator->InitializeSampleAllocatorEx(1, 50, outputAttr.Get(), _outputType.Get()));
-                    }
+            long long startTime = MFGetSystemTime();
 
-                    _inputAllocator = inputAllocator;
-                    _outputAllocator = outputAllocator;
-                }
+            // Stages get their samples from the composite effect
+            if (!_passthrough && !_stage)
+            {
+                _CreateSampleAllocators(false);
             }
 
+            _UpdateQosCanPassThrough();
+            _qosClockValid = false;
+
+            _deinterlacing = _IsDeinterlacedType(_inputType);
+
             GUID subtype;
             unsigned int width;
             unsigned int height;
             CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
             CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
 
+            auto processingLock = _processingLock.LockExclusive();
             StartStreaming(subtype.Data1, width, height);
+
+            _streamingStartTime = (unsigned long long)(MFGetSystemTime() - startTime);
         }
         else if (!streaming && _streaming)
         {
             Trace("Ending streaming");
 
+            // Wait for the ProcessSample() calls in progress to return and drop frames not yet processed.
+            // Processing still in flight in the background (see ProcessSampleAsync()) completes later, its output discarded.
+            auto processingLock = _processingLock.LockExclusive();
+            InterlockedIncrement(&_processingGeneration);
+            _framesInFlight.clear();
+            _outputsReady.clear();
+            _inputRequestCount = 0;
+
             EndStreaming();
 
-            _inputAllocator = nullptr;
-            _outputAllocator = nullptr;
+            _deinterlacePrevious = nullptr;
+            _formatChangePending = false;
+            _ReleaseSampleAllocators();
+        }
+
+        if (!streaming)
+        {
+            _prewarmGeneration++; // Cancels pending prewarms
+        }
+        if (streaming != _streaming)
+        {
+            _InvalidateTypeCache(); // IsValidInputType() depends on the streaming state
         }
         _streaming = streaming;
     }
 
+    // Called with _streamingLock and _lock held: starts streaming on the thread pool, ahead of the first frame.
+    // The work item holds _streamingLock while starting, which makes ProcessInput()/ProcessOutput() wait for it.
+    void _PrewarmAsync()
+    {
+        if (_streaming || _stage || _shutdown || (_inputType == nullptr) || (_outputType == nullptr))
+        {
+            return;
+        }
+
+        unsigned int generation = ++_prewarmGeneration;
+
+        // Keep the effect alive until the work item completes
+        ::Microsoft::WRL::ComPtr<IMFTransform> self(static_cast<IMFTransform*>(this));
+
+        Windows::System::Threading::ThreadPool::RunAsync(ref new Windows::System::Threading::WorkItemHandler(
+            [this, self, generation](Windows::Foundation::IAsyncAction^)
+        {
+            HRESULT hr = ExceptionBoundary([this, generation]()
+            {
+                auto streamingLock = _LockStreaming();
+                auto lock = _LockState();
+
+                // Types changed, streaming ended, or the first frame got there first
+                if ((generation != _prewarmGeneration) || _streaming || _shutdown)
+                {
+                    return;
+                }
+
+                Trace("Prewarming");
+                _SetStreamingState(true);
+                _prewarmCount++;
+            });
+
+            // Streaming is started again by the first frame, which reports the error
+            if (FAILED(hr))
+            {
+                Trace("Prewarm failed: %08X", hr);
+            }
+        }));
+    }
+
+    // Called with _streamingLock held
+    ::Microsoft::WRL::ComPtr<IMFSample> _AllocateSample(_In_ const std::unique_ptr<SampleAllocatorPool>& allocator)
+    {
+        LatencyHistogram::Scope allocate(_allocateLatency);
+        ::Microsoft::WRL::ComPtr<IMFSample> sample;
+        CHK(allocator->AllocateSample(&sample));
+        return sample;
+    }
+
+    // Called with _streamingLock held, before processing the sample at the front of the queue
+    void _RecordQueueWait()
+    {
+        _queueWaitLatency.Record(LatencyHistogram::Elapsed(_sampleQueueTimes.front()));
+    }
+
+    // Called with _streamingLock held
+    void _PopSample()
+    {
+        _samples.pop_front();
+        _sampleQueueTimes.pop_front();
+    }
+
+    // Called with _streamingLock held
+    void _RecordOutputSample()
+    {
+        _outputSampleCount++;
+
+        if (!_firstFrameOutput && (_firstFrameStartTime != 0))
+        {
+            _firstFrameLatency = (unsigned long long)(MFGetSystemTime() - _firstFrameStartTime);
+            _firstFrameOutput = true;
+            Trace("First frame latency: %ums", (unsigned int)(_firstFrameLatency / 10000));
+        }
+    }
+
+    // Called with _streamingLock and _lock held
+    void _UpdateQosCanPassThrough()
+    {
+        // Late frames can only be passed through if they are valid output samples
+        BOOL sameTypes = false;
+        _qosCanPassThrough = (_outputType != nullptr) &&
+            SUCCEEDED(_inputType->Compare(_outputType.Get(), MF_ATTRIBUTES_MATCH_INTERSECTION, &sameTypes)) && !!sameTypes;
+    }
+
+    // Media types set while streaming are handled without restarting if the subtype does not change
+    bool _CanChangeFormatInPlace(_In_opt_ const Microsoft::WRL::ComPtr<IMFMediaType>& previousType, _In_opt_ IMFMediaType *type) const
+    {
+        if (!_streaming || _stage || (previousType == nullptr) || (type == nullptr))
+        {
+            return false;
+        }
+
+        GUID previousSubtype;
+        GUID subtype;
+        return SUCCEEDED(previousType->GetGUID(MF_MT_SUBTYPE, &previousSubtype)) &&
+            SUCCEEDED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) &&
+            (previousSubtype == subtype);
+    }
+
+    // True if samples allocated for one type fit the other: same subtype, resolution, and stride
+    static bool _HasSameFrameFormat(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type1, _In_ const Microsoft::WRL::ComPtr<IMFMediaType>& type2)
+    {
+        GUID subtype1;
+        GUID subtype2;
+        unsigned long long size1;
+        unsigned long long size2;
+        if (FAILED(type1->GetGUID(MF_MT_SUBTYPE, &subtype1)) || FAILED(type2->GetGUID(MF_MT_SUBTYPE, &subtype2)) ||
+            FAILED(type1->GetUINT64(MF_MT_FRAME_SIZE, &size1)) || FAILED(type2->GetUINT64(MF_MT_FRAME_SIZE, &size2)))
+        {
+            return false;
+        }
+
+        return (subtype1 == subtype2) && (size1 == size2) &&
+            (MFGetAttributeUINT32(type1.Get(), MF_MT_DEFAULT_STRIDE, 0) == MFGetAttributeUINT32(type2.Get(), MF_MT_DEFAULT_STRIDE, 0));
+    }
+
+    // Called with _streamingLock and _lock held, after the input type changed while streaming
+    void _ChangeInputFormat(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& previousType)
+    {
+        Trace("Input type changed while streaming");
+
+        _deinterlacing = _IsDeinterlacedType(_inputType);
+        _deinterlacePrevious = nullptr;
+
+        if (_inputAllocator != nullptr)
+        {
+            if (_HasSameFrameFormat(previousType, _inputType))
+            {
+                _formatChangeAllocatorReuseCount++;
+            }
+            else
+            {
+                _inputAllocatorInUseMax = max(_inputAllocatorInUseMax, _inputAllocator->GetInUseCountMax());
+                _inputAllocator = _CreateInputAllocator(min(_allocatorInitialSize, _allocatorMaxSize));
+                _inputAllocator->PrewarmAsync(max(_inputQueueSize + _asyncFramesInFlight, _inputAllocatorInUseMax), _GetInputSamplesNeeded());
+            }
+        }
+
+        // The output type usually follows the input resolution: if it does not match anymore
+        // the client is asked for a new one by the next ProcessOutput() call
+        if ((_outputType == nullptr) || !_IsValidTypeCached(_outputTypeCache, _outputType.Get(), [this]()
+        {
+            return IsValidOutputType(_outputType);
+        }))
+        {
+            _formatChangePending = true;
+            if (_IsAsync())
+            {
+                CHK(_eventQueue->QueueEventParamVar(METransformHaveOutput, GUID_NULL, S_OK, nullptr));
+            }
+            return;
+        }
+
+        _CompleteFormatChange();
+    }
+
+    // Called with _streamingLock and _lock held, after the output type changed while streaming
+    void _ChangeOutputFormat(_In_ const Microsoft::WRL::ComPtr<IMFMediaType>& previousType)
+    {
+        Trace("Output type changed while streaming");
+
+        if (_outputAllocator != nullptr)
+        {
+            if (_HasSameFrameFormat(previousType, _outputType))
+            {
+                _formatChangeAllocatorReuseCount++;
+            }
+            else
+            {
+                _outputAllocatorInUseMax = max(_outputAllocatorInUseMax, _outputAllocator->GetInUseCountMax());
+                _outputAllocator = _CreateOutputAllocator(min(_allocatorInitialSize, _allocatorMaxSize));
+                _outputAllocator->PrewarmAsync(max(_asyncFramesInFlight + 1, _outputAllocatorInUseMax), _GetOutputSamplesNeeded());
+            }
+        }
+
+        _CompleteFormatChange();
+    }
+
+    // Called with _streamingLock and _lock held, once input and output types match again
+    void _CompleteFormatChange()
+    {
+        _formatChangePending = false;
+        _formatChangeCount++;
+        _UpdateQosCanPassThrough();
+
+        GUID subtype;
+        unsigned int width;
+        unsigned int height;
+        CHK(_inputType->GetGUID(MF_MT_SUBTYPE, &subtype));
+        CHK(MFGetAttributeSize(_inputType.Get(), MF_MT_FRAME_SIZE, &width, &height));
+
+        {
+            auto processingLock = _processingLock.LockExclusive();
+            OnFormatChanged(subtype.Data1, width, height);
+        }
+
+        if (_IsAsync())
+        {
+            _RequestAsyncInputs();
+        }
+    }
+
+    // Called with _streamingLock and _lock held
+    void _CreateSampleAllocators(bool minimumSize)
+    {
+        // Size the pools for the samples expected in flight, or seen in flight during previous streaming sessions
+        unsigned int inputInitialSize = _allocatorInitialSize;
+        unsigned int outputInitialSize = _allocatorInitialSize;
+        if (!minimumSize)
+        {
+            inputInitialSize = max(inputInitialSize, max(_inputQueueSize + _asyncFramesInFlight, _inputAllocatorInUseMax));
+            outputInitialSize = max(outputInitialSize, max(_asyncFramesInFlight + 1, _outputAllocatorInUseMax));
+        }
+        inputInitialSize = min(inputInitialSize, _allocatorMaxSize);
+        outputInitialSize = min(outputInitialSize, _allocatorMaxSize);
+
+        Trace("Sample allocator sizes: input %u-%u, output %u-%u", inputInitialSize, _allocatorMaxSize, outputInitialSize, _allocatorMaxSize);
+
+        std::unique_ptr<SampleAllocatorPool> inputAllocator = _CreateInputAllocator(inputInitialSize);
+        std::unique_ptr<SampleAllocatorPool> outputAllocator = _CreateOutputAllocator(outputInitialSize);
+        _inputAllocator = std::move(inputAllocator);
+        _outputAllocator = std::move(outputAllocator);
+    }
+
+    // Called with _streamingLock and _lock held
+    std::unique_ptr<SampleAllocatorPool> _CreateInputAllocator(_In_ unsigned int initialSize)
+    {
+        std::unique_ptr<SampleAllocatorPool> inputAllocator(new SampleAllocatorPool(_deviceManager));
+        if (_deviceManager == nullptr)
+        {
+            CHK(inputAllocator->Initialize(initialSize, _allocatorMaxSize, nullptr, _inputType.Get()));
+        }
+        else
+        {
+            // Only needs D3D11_BIND_SHADER_RESOURCE
+            Microsoft::WRL::ComPtr<IMFAttributes> inputAttr;
+            CHK(MFCreateAttributes(&inputAttr, 3));
+            CHK(inputAttr->SetUINT32(MF_SA_BUFFERS_PER_SAMPLE, 1));
+            CHK(inputAttr->SetUINT32(MF_SA_D3D11_USAGE, D3D11_USAGE_DEFAULT));
+            CHK(inputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, D3D11_BIND_SHADER_RESOURCE));
+            CHK(inputAllocator->Initialize(initialSize, _allocatorMaxSize, inputAttr.Get(), _inputType.Get()));
+        }
+        return inputAllocator;
+    }
+
+    // Called with _streamingLock and _lock held
+    std::unique_ptr<SampleAllocatorPool> _CreateOutputAllocator(_In_ unsigned int initialSize)
+    {
+        std::unique_ptr<SampleAllocatorPool> outputAllocator(new SampleAllocatorPool(_deviceManager));
+        if (_deviceManager == nullptr)
+        {
+            CHK(outputAllocator->Initialize(initialSize, _allocatorMaxSize, nullptr, _outputType.Get()));
+        }
+        else
+        {
+            // If possible respect bind flags requested by downstream component via GetOutputStreamAttributes()
+            Microsoft::WRL::ComPtr<IMFAttributes> outputAttr;
+            CHK(MFCreateAttributes(&outputAttr, 3));
+            CHK(outputAttr->SetUINT32(MF_SA_BUFFERS_PER_SAMPLE, 1));
+            CHK(outputAttr->SetUINT32(MF_SA_D3D11_USAGE, D3D11_USAGE_DEFAULT));
+            unsigned int outputBindFlags = MFGetAttributeUINT32(_outputAttributes.Get(), MF_SA_D3D11_BINDFLAGS, D3D11_BIND_RENDER_TARGET);
+            outputBindFlags |= D3D11_BIND_RENDER_TARGET; // D3D11_BIND_RENDER_TARGET required, D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_VIDEO_ENCODER optional
+            CHK(outputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, outputBindFlags));
+
+            if (FAILED(outputAllocator->Initialize(initialSize, _allocatorMaxSize, outputAttr.Get(), _outputType.Get())))
+            {
+                // Try again with only D3D11_BIND_RENDER_TARGET (downstream component will have to make a copy)
+                CHK(outputAttr->SetUINT32(MF_SA_D3D11_BINDFLAGS, D3D11_BIND_RENDER_TARGET));
+                CHK(outputAllocator->Initialize(initialSize, _allocatorMaxSize, outputAttr.Get(), _outputType.Get()));
+            }
+        }
+        return outputAllocator;
+    }
+
+    // Called with _streamingLock and _lock held
+    void _ReleaseSampleAllocators()
+    {
+        // Remember the demand for the next pools
+        if (_inputAllocator != nullptr)
+        {
+            _inputAllocatorInUseMax = max(_inputAllocatorInUseMax, _inputAllocator->GetInUseCountMax());
+        }
+        if (_outputAllocator != nullptr)
+        {
+            _outputAllocatorInUseMax = max(_outputAllocatorInUseMax, _outputAllocator->GetInUseCountMax());
+        }
+
+        // Samples still in use keep their allocator alive until they are returned
+        _inputAllocator = nullptr;
+        _outputAllocator = nullptr;
+    }
+
+    // Called with _streamingLock held
+    void _CheckMemoryPressure()
+    {
+#if WINAPI_FAMILY == WINAPI_FAMILY_PHONE_APP
+        // Polled every 30 output samples or so
+        if ((_inputAllocator == nullptr) || ((_outputSampleCount % 30) != 0))
+        {
+            return;
+        }
+
+        bool memoryPressure = (Windows::System::MemoryManager::AppMemoryUsageLevel == Windows::System::AppMemoryUsageLevel::High);
+        if (memoryPressure && !_memoryPressure)
+        {
+            Trace("High memory usage, trimming the sample allocators");
+
+            auto lock = _LockState();
+            _ReleaseSampleAllocators();
+            _CreateSampleAllocators(true);
+            _allocatorTrimCount++;
+        }
+        _memoryPressure = memoryPressure;
+#endif
+    }
+
     void _CopySampleProperties(
         const Microsoft::WRL::ComPtr<IMFSample>& inputSample,
         const Microsoft::WRL::ComPtr<IMFSample>& outputSample
@@ -1241,12 +3483,109 @@ private:
     ::Microsoft::WRL::ComPtr<IMFAttributes> _attributes;
     ::Microsoft::WRL::ComPtr<IMFAttributes> _inputAttributes;
     ::Microsoft::WRL::ComPtr<IMFAttributes> _outputAttributes;
-    ::Microsoft::WRL::ComPtr<IMFSample> _sample;
+    std::deque<::Microsoft::WRL::ComPtr<IMFSample>> _samples; // Normalized input samples waiting for ProcessOutput()
+    std::deque<long long> _sampleQueueTimes; // LatencyHistogram::Now() when each of _samples was queued
 
     bool _streaming; // use _SetStreamingState() to update
     bool _inputProgressive;
+    bool _draining;
     unsigned int _inputDefaultSize;
     unsigned int _outputDefaultSize;
+    unsigned int _inputQueueSize;
+
+    // Statistics
+    unsigned int _inputQueueDepthMax;
+    unsigned long long _inputSampleCount;
+    unsigned long long _inputSampleRejectedCount;
+    unsigned long long _outputSampleCount;
+
+    // Asynchronous mode
+    Microsoft::WRL::ComPtr<IMFMediaEventQueue> _eventQueue; // null in synchronous mode
+    std::deque<std::shared_ptr<AsyncFrame>> _framesInFlight; // In input order
+    std::deque<::Microsoft::WRL::ComPtr<IMFSample>> _outputsReady;
+    unsigned int _asyncFramesInFlight; // 0 in synchronous mode
+    unsigned int _inputRequestCount; // Number of METransformNeedInput sent and not yet answered
+    bool _asyncStarted;
+    bool _shutdown;
+    volatile long _processingGeneration; // Incremented on flush and end of streaming
+    unsigned int _asyncFramesInFlightMax;
+
+    volatile long _stateLockContentionCount;
+    volatile long _streamingLockContentionCount;
+
+    // Media-type negotiation cache
+    ::Microsoft::WRL::Wrappers::SRWLock _typeCacheLock;
+    TypeCache _inputTypeCache;
+    TypeCache _outputTypeCache;
+    volatile long _typeCacheHitCount;
+    volatile long _typeCacheMissCount;
+
+    // Sample allocators
+    unsigned int _allocatorInitialSize;
+    unsigned int _allocatorMaxSize;
+    unsigned int _inputAllocatorInUseMax; // Over previous streaming sessions
+    unsigned int _outputAllocatorInUseMax;
+    unsigned int _allocatorTrimCount;
+    bool _memoryPressure;
+
+    // Input normalization paths taken (see _NormalizeSample())
+    unsigned long long _normalizeNoneCount;
+    unsigned long long _normalizeZeroCopyCount;
+    unsigned long long _normalizeGatherCount;
+    unsigned long long _normalizeContiguousCount;
+    unsigned long long _normalize1DTo2DCount;
+    unsigned long long _normalizeTextureCopyCount;
+
+    // QoS
+    QosPolicy _qosPolicy;
+    long long _qosLatencyBudget; // 100ns units
+    bool _qosCanPassThrough; // Input and output media types match
+    bool _qosClockValid;
+    long long _qosClockSystemTime; // System time at which _qosClockSampleTime was received
+    long long _qosClockSampleTime;
+    bool _qosDiscontinuity; // Frames dropped since the last output
+    unsigned long long _qosProcessedCount;
+    unsigned long long _qosDroppedCount;
+    unsigned long long _qosPassedThroughCount;
+    unsigned long long _qosReducedQualityCount;
+    unsigned long long _qosLatenessMax;
+
+    // Deinterlacing
+    DeinterlaceMode _deinterlaceMode;
+    unsigned int _inputInterlaceMode; // MF_MT_INTERLACE_MODE of the input type
+    bool _deinterlacing; // Input type deinterlaced, set when streaming starts
+    ::Microsoft::WRL::ComPtr<IMFSample> _deinterlacePrevious; // Previous output of motion-adaptive deinterlacing
+    bool _deinterlacePreviousBottomFieldFirst;
+    unsigned long long _deinterlaceFrameCount;
+    unsigned long long _deinterlaceTime; // 100ns units
+
+    // Media-type changes while streaming
+    bool _formatChangePending; // Input type changed, waiting for a matching output type
+    unsigned long long _formatChangeCount;
+    unsigned long long _formatChangeAllocatorReuseCount;
+
+    // Prewarm and first-frame latency
+    PrewarmMode _prewarmMode;
+    unsigned int _prewarmGeneration; // Incremented to cancel pending prewarms
+    unsigned long long _prewarmCount;
+    long long _firstFrameStartTime; // System time of MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0 when not streaming
+    bool _firstFrameOutput;
+    unsigned long long _firstFrameLatency; // 100ns units
+    unsigned long long _streamingStartTime; // 100ns units
+
+    // "FrameTracing" property: per-frame binary records and text traces of this instance
+    bool _traceRecords;
+    bool _traceVerbose;
+
+    // Latency histograms and copy counters, updated without locks
+    LatencyHistogram _normalizeLatency;
+    LatencyHistogram _allocateLatency;
+    LatencyHistogram _processLatency;
+    LatencyHistogram _lockWaitLatency;
+    LatencyHistogram _queueWaitLatency;
+    volatile long long _copyCount;
+    volatile long long _copyBytes;
+    volatile long long _latencyRecordCount; // When the summaries were last published, see _PublishLatencyStatistics()
 };
 
 #pragma warning(pop)
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+//
+// Plane layouts of the uncompressed video formats handled by the effects
+//
+// Formats are identified by the FOURCC/D3DFORMAT value stored in the Data1 field of Media Foundation subtypes.
+// A frame is made of up to three planes stored one after the other. Each plane has a pitch derived from the
+// frame pitch (the pitch of the first plane) and a number of rows derived from the frame height.
+//
+
+namespace VideoFormat
+{
+    struct Plane
+    {
+        unsigned int PitchDivisor;  // Plane pitch: frame pitch / PitchDivisor
+        unsigned int HeightDivisor; // Plane rows: frame height / HeightDivisor, rounded up
+    };
+
+    struct FormatInfo
+    {
+        unsigned long Format;
+        unsigned int BytesPerPixel;  // First plane
+        unsigned int PitchAlignment; // Default pitch alignment in bytes
+        bool BottomUp;               // Rows stored bottom-up in system memory (RGB)
+        unsigned int PlaneCount;
+        Plane Planes[3];
+    };
+
+    namespace Details
+    {
+        inline const FormatInfo* GetFormats(_Out_ unsigned int *count)
+        {
+            static const FormatInfo s_formats[] =
+            {
+                // Format                              Bpp  Align BottomUp Planes
+                { MAKEFOURCC('N', 'V', '1', '2'),      1,   1,    false,   2, { { 1, 1 }, { 1, 2 } } },
+                { MAKEFOURCC('I', '4', '2', '0'),      1,   2,    false,   3, { { 1, 1 }, { 2, 2 }, { 2, 2 } } },
+                { MAKEFOURCC('I', 'Y', 'U', 'V'),      1,   2,    false,   3, { { 1, 1 }, { 2, 2 }, { 2, 2 } } },
+                { MAKEFOURCC('Y', 'V', '1', '2'),      1,   2,    false,   3, { { 1, 1 }, { 2, 2 }, { 2, 2 } } },
+                { MAKEFOURCC('Y', 'U', 'Y', '2'),      2,   4,    false,   1, { { 1, 1 } } },
+                { MAKEFOURCC('U', 'Y', 'V', 'Y'),      2,   4,    false,   1, { { 1, 1 } } },
+                { 21 /*D3DFMT_A8R8G8B8, ARGB32*/,      4,   1,    true,    1, { { 1, 1 } } },
+                { 22 /*D3DFMT_X8R8G8B8, RGB32*/,       4,   1,    true,    1, { { 1, 1 } } },
+            };
+
+            *count = ARRAYSIZE(s_formats);
+            return s_formats;
+        }
+    }
+
+    // Returns nullptr for formats with an unknown layout (compressed or opaque like 420O)
+    inline _Ret_maybenull_ const FormatInfo* Find(_In_ unsigned long format)
+    {
+        unsigned int count;
+        const FormatInfo *formats = Details::GetFormats(&count);
+        for (unsigned int n = 0; n < count; n++)
+        {
+            if (formats[n].Format == format)
+            {
+                return &formats[n];
+            }
+        }
+        return nullptr;
+    }
+
+    inline unsigned int GetDefaultPitch(_In_ const FormatInfo& info, _In_ unsigned int width)
+    {
+        unsigned int alignment = info.PitchAlignment;
+        return (info.BytesPerPixel * width + alignment - 1) / alignment * alignment;
+    }
+
+    inline unsigned int GetPlanePitch(_In_ const FormatInfo& info, _In_ unsigned int plane, _In_ unsigned int pitch)
+    {
+        return pitch / info.Planes[plane].PitchDivisor;
+    }
+
+    inline unsigned int GetPlaneRowCount(_In_ const FormatInfo& info, _In_ unsigned int plane, _In_ unsigned int height)
+    {
+        unsigned int divisor = info.Planes[plane].HeightDivisor;
+        return (height + divisor - 1) / divisor;
+    }
+
+    // Size of a packed frame, planes stored back to back
+    inline unsigned int GetFrameSize(_In_ const FormatInfo& info, _In_ unsigned int pitch, _In_ unsigned int height)
+    {
+        unsigned int size = 0;
+        for (unsigned int plane = 0; plane < info.PlaneCount; plane++)
+        {
+            size += GetPlanePitch(info, plane, pitch) * GetPlaneRowCount(info, plane, height);
+        }
+        return size;
+    }
+
+    // True if all the planes share the frame pitch
+    inline bool HasSinglePitch(_In_ const FormatInfo& info)
+    {
+        for (unsigned int plane = 0; plane < info.PlaneCount; plane++)
+        {
+            if (info.Planes[plane].PitchDivisor != 1)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -1,5 +1,14 @@
 #pragma once
 
+// IBuffer over a locked MF buffer. The IBuffer bytes start at the lowest address of the image:
+// with a negative stride (bottom-up buffer) they hold the image rows in reverse order.
+//
+// The wrapper can be rebound to another MF buffer with Open() once closed, so objects holding on to the IBuffer
+// (Lumia bitmaps for instance) can be reused from one frame to the next. See WinRTBufferPool.h.
+//
+// Only the lifetime transitions (Open() and Close()) are serialized. The accessors read the fields without locks:
+// they do not change while the buffer is open, and the IBuffer must not be used across a Close()/Open().
+
 class WinRTBufferOnMF2DBuffer WrlSealed : public Microsoft::WRL::RuntimeClass <
     Microsoft::WRL::RuntimeClassFlags<Microsoft::WRL::RuntimeClassType::WinRtClassicComMix>,
     ABI::Windows::Storage::Streams::IBuffer,
@@ -13,53 +22,84 @@ public:
 
     WinRTBufferOnMF2DBuffer()
         : _pBuffer(nullptr)
+        , _source(nullptr)
         , _capacity(0)
         , _length(0)
         , _stride(0)
     {
     }
 
-    HRESULT RuntimeClassInitialize(_In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer, _In_ MF2DBuffer_LockFlags lockFlags, _In_ unsigned int defaultStride)
+    HRESULT RuntimeClassInitialize(_In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer, _In_ MF2DBuffer_LockFlags lockFlags, _In_ long defaultStride)
     {
         return ExceptionBoundary([=]()
         {
-            if (SUCCEEDED(buffer.As(&_buffer2D)))
-            {
-                unsigned char *pScanline0 = nullptr;
-                long pitch;
-                CHK(_buffer2D->Lock2DSize(lockFlags, &pScanline0, &pitch, &_pBuffer, &_capacity));
-
-                if (pitch <= 0)
-                {
-                    CHK(OriginateError(E_INVALIDARG, L"Negative stride"));
-                }
+            Open(buffer, lockFlags, defaultStride);
+        });
+    }
 
-                _length = _capacity;
-                _stride = static_cast<unsigned int>(pitch);
-            }
-            else
-            {
-                // When inserted in MediaElement the effect may get 1D buffers (maybe in other cases too)
-                // so support fallback to 1D buffers here
+    // Locks a new MF buffer, unlocking the previous one if still open
+    void Open(_In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer, _In_ MF2DBuffer_LockFlags lockFlags, _In_ long defaultStride)
+    {
+        auto lock = _lock.LockExclusive();
+        _Close();
+        _source = buffer.Get();
 
-                unsigned long capacity;
-                unsigned long length;
-                CHK(buffer->Lock(&_pBuffer, &capacity, &length));
+        Microsoft::WRL::ComPtr<IMF2DBuffer2> buffer2D;
+        if (SUCCEEDED(buffer.As(&buffer2D)))
+        {
+            unsigned char *pScanline0 = nullptr;
+            unsigned char *pBuffer = nullptr;
+            unsigned long capacity = 0;
+            long pitch;
+            CHK(buffer2D->Lock2DSize(lockFlags, &pScanline0, &pitch, &pBuffer, &capacity));
 
-                _buffer1D = buffer;
-                _capacity = capacity;
-                _length = length;
-                _stride = defaultStride;
+            if (pitch == 0)
+            {
+                (void)buffer2D->Unlock2D();
+                CHK(OriginateError(E_INVALIDARG, L"Null stride"));
             }
-        });
+
+            _buffer2D = buffer2D;
+            _pBuffer = pBuffer;
+            _capacity = capacity;
+            _length = capacity;
+            _stride = pitch;
+        }
+        else
+        {
+            // When inserted in MediaElement the effect may get 1D buffers (maybe in other cases too)
+            // so support fallback to 1D buffers here
+
+            unsigned char *pBuffer = nullptr;
+            unsigned long capacity;
+            unsigned long length;
+            CHK(buffer->Lock(&pBuffer, &capacity, &length));
+
+            _buffer1D = buffer;
+            _pBuffer = pBuffer;
+            _capacity = capacity;
+            _length = length;
+            _stride = defaultStride;
+        }
     }
 
-    unsigned int GetStride() const
+    // Signed: negative for bottom-up buffers
+    long GetStride() const
     {
-        auto lock = _lock.LockExclusive();
         return _stride;
     }
 
+    // Distance between rows in the IBuffer, whatever the row order
+    unsigned int GetPitch() const
+    {
+        return static_cast<unsigned int>(_stride >= 0 ? _stride : -_stride);
+    }
+
+    bool IsBottomUp() const
+    {
+        return _stride < 0;
+    }
+
     Windows::Storage::Streams::IBuffer^ GetIBuffer()
     {
         return reinterpret_cast<Windows::Storage::Streams::IBuffer^>(
@@ -73,13 +113,18 @@ public:
         _Close();
     }
 
+    // Identity of the MF buffer last opened, only meant for comparisons (no reference held)
+    const void* GetSource() const
+    {
+        return _source;
+    }
+
     //
     // IBuffer
     //
 
     IFACEMETHODIMP get_Capacity(_Out_ unsigned int *pValue) override
     {
-        auto lock = _lock.LockExclusive();
         if (pValue == nullptr)
         {
             return OriginateError(E_POINTER);
@@ -91,7 +136,6 @@ public:
 
     IFACEMETHODIMP get_Length(_Out_ unsigned int *pValue) override
     {
-        auto lock = _lock.LockExclusive();
         if (pValue == nullptr)
         {
             return OriginateError(E_POINTER);
@@ -103,7 +147,6 @@ public:
 
     IFACEMETHODIMP put_Length(_In_ unsigned int value) override
     {
-        auto lock = _lock.LockExclusive();
         if (value > _capacity)
         {
             return OriginateError(E_INVALIDARG);
@@ -119,7 +162,6 @@ public:
 
     IFACEMETHODIMP Buffer(_Outptr_result_buffer_(_Inexpressible_("size given by different API")) unsigned char **ppValue) override
     {
-        auto lock = _lock.LockExclusive();
         if (ppValue == nullptr)
         {
             return OriginateError(E_POINTER);
@@ -167,12 +209,13 @@ private:
     }
 
     unsigned char *_pBuffer;
+    const void *_source;
     unsigned long _capacity;
     unsigned int _length;
-    unsigned int _stride;
+    long _stride;
 
     Microsoft::WRL::ComPtr<IMF2DBuffer2> _buffer2D;
     Microsoft::WRL::ComPtr<IMFMediaBuffer> _buffer1D;
 
-    mutable Microsoft::WRL::Wrappers::SRWLock _lock;
+    Microsoft::WRL::Wrappers::SRWLock _lock; // Serializes Open() and Close()
 };
@@ -0,0 +1,110 @@
+#pragma once
+
+//
+// Recycles WinRTBufferOnMF2DBuffer wrappers instead of creating one per buffer per frame
+//
+// Open() hands out a wrapper locked on the given MF buffer, preferably the one which last wrapped that buffer:
+// sample allocators recycle their buffers, so the same wrapper keeps coming back for the same buffer and owners
+// can cache objects built on it (bitmaps, views). Close() unlocks the wrapper and returns it to the pool.
+// The pool only holds closed wrappers, which do not reference MF buffers.
+//
+// The pool is thread safe.
+//
+class WinRTBufferPool
+{
+public:
+
+    explicit WinRTBufferPool(_In_ unsigned int maxSize = 8)
+        : _maxSize(maxSize)
+        , _createdCount(0)
+        , _reusedCount(0)
+    {
+    }
+
+    Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer> Open(
+        _In_ const Microsoft::WRL::ComPtr<IMFMediaBuffer>& buffer,
+        _In_ MF2DBuffer_LockFlags lockFlags,
+        _In_ long defaultStride
+        )
+    {
+        Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer> wrapper;
+        {
+            auto lock = _lock.LockExclusive();
+            if (!_wrappers.empty())
+            {
+                // Most recently closed wrapper of that buffer, or the most recently closed one
+                auto match = _wrappers.end() - 1;
+                for (auto it = _wrappers.begin(); it != _wrappers.end(); ++it)
+                {
+                    if ((*it)->GetSource() == buffer.Get())
+                    {
+                        match = it;
+                    }
+                }
+                wrapper = *match;
+                _wrappers.erase(match);
+                _reusedCount++;
+            }
+            else
+            {
+                _createdCount++;
+            }
+        }
+
+        if (wrapper == nullptr)
+        {
+            wrapper = Microsoft::WRL::Make<WinRTBufferOnMF2DBuffer>();
+            CHKOOM(wrapper);
+        }
+
+        wrapper->Open(buffer, lockFlags, defaultStride);
+        return wrapper;
+    }
+
+    // Unlocks the MF buffer. Wrappers beyond the pool size are released.
+    void Close(_In_ const Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer>& wrapper)
+    {
+        wrapper->Close();
+
+        auto lock = _lock.LockExclusive();
+        if (_maxSize == 0)
+        {
+            return;
+        }
+        if (_wrappers.size() >= _maxSize)
+        {
+            _wrappers.erase(_wrappers.begin());
+        }
+        _wrappers.push_back(wrapper);
+    }
+
+    void Clear()
+    {
+        auto lock = _lock.LockExclusive();
+        _wrappers.clear();
+    }
+
+    unsigned long long GetCreatedCount() const
+    {
+        auto lock = _lock.LockExclusive();
+        return _createdCount;
+    }
+
+    unsigned long long GetReusedCount() const
+    {
+        auto lock = _lock.LockExclusive();
+        return _reusedCount;
+    }
+
+private:
+
+    WinRTBufferPool(const WinRTBufferPool&);
+    WinRTBufferPool& operator=(const WinRTBufferPool&);
+
+    std::vector<Microsoft::WRL::ComPtr<WinRTBufferOnMF2DBuffer>> _wrappers; // Closed, least recently closed first
+    unsigned int _maxSize;
+    unsigned long long _createdCount;
+    unsigned long long _reusedCount;
+
+    mutable Microsoft::WRL::Wrappers::SRWLock _lock;
+};
@@ -1,9 +1,12 @@
 ﻿#pragma once
 
 #include <algorithm>
+#include <deque>
+#include <memory>
 #include <sstream>
 
 #include <collection.h>
+#include <ppl.h>
 #include <ppltasks.h>
 
 #include <strsafe.h>
@@ -38,15 +41,56 @@
 
 #include "Events\Logger.h"
 #include "DebuggerLogger.h"
+#include "TraceBuffer.h"
 
+// Traces above VE_TRACE_LEVEL are compiled out, argument evaluation included.
+// Levels match LogLevel: 0 = none, 1 = Critical, 2 = Error, 3 = Warning, 4 = Information, 5 = Verbose.
+#ifndef VE_TRACE_LEVEL
+#ifdef NDEBUG
+#define VE_TRACE_LEVEL 4
+#else
+#define VE_TRACE_LEVEL 5
+#endif
+#endif
+
+#if VE_TRACE_LEVEL >= 4
 #define Trace(format, ...) { \
     if(s_logger.IsEnabled(LogLevel::Information)) { s_logger.Log(__FUNCTION__, LogLevel::Information, format, __VA_ARGS__); } \
     Logger.Info("%s " ## format, __FUNCTION__, __VA_ARGS__); \
 }
+#else
+#define Trace(format, ...)
+#endif
+
+#if VE_TRACE_LEVEL >= 2
 #define TraceError(format, ...) { \
     if(s_logger.IsEnabled(LogLevel::Error)) { s_logger.Log(__FUNCTION__, LogLevel::Error, format, __VA_ARGS__); } \
     Logger.Error("%s " ## format, __FUNCTION__, __VA_ARGS__); \
 }
+#else
+#define TraceError(format, ...)
+#endif
+
+// Per-frame traces take the switch of the object tracing them (see the "FrameTracing" effect property),
+// which is OR'ed with the process-wide one: the Verbose logger level, TraceBuffer::SetEnabled().
+
+// Per-frame text traces: debugger only, arguments evaluated only if enabled
+#if VE_TRACE_LEVEL >= 5
+#define TraceVerbose(enabled, format, ...) { \
+    if(((enabled) && s_logger.IsEnabled(LogLevel::Information)) || s_logger.IsEnabled(LogLevel::Verbose)) { s_logger.Log(__FUNCTION__, LogLevel::Information, format, __VA_ARGS__); } \
+}
+#else
+#define TraceVerbose(enabled, format, ...)
+#endif
+
+// Per-frame binary traces (see TraceBuffer.h)
+#if VE_TRACE_LEVEL >= 4
+#define TraceSample(enabled, event, object, sample) { \
+    if((enabled) || TraceBuffer::IsEnabled()) { TraceBuffer::AppendSample(event, object, sample); } \
+}
+#else
+#define TraceSample(enabled, event, object, sample)
+#endif
 
 //
 // Error handling